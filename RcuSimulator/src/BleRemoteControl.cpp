@@ -1,64 +1,81 @@
 #include "BleRemoteControl.h"
 #include "utils.h"
+#include "deferredlog.h"
+#include "configstore.h"
+#include "keyrecorder.h"
+#include "heapmonitor.h"
 #include <cstring>  // For memcpy, memset
+#include "esp_timer.h"
+
+BleRemoteControl* BleRemoteControl::instance = nullptr;
 
 BleRemoteControl::BleRemoteControl() 
     : hid(0)
 {
-    // Initialize media key report struct
-    _mediaKeyReport.consumer1 = 0;
-    _mediaKeyReport.consumer2 = 0;
-    _mediaKeyReport.padding = 0;
-    loadConfig();
 }
 
 void BleRemoteControl::loadConfig() {
-  // Load preferences for custom MAC address and device configuration
-  preferences.begin("ble", true); // Read-only mode
-  
-  // Load MAC address configuration
-  if (preferences.isKey("custom_mac")) {
-    useCustomMac = true;
-    macAddressSet = true;
-    preferences.getBytes("custom_mac", customMacAddress, sizeof(customMacAddress));
-  } else {
-    useCustomMac = false;
-    macAddressSet = false;
+  // Custom MAC address and device configuration from the config store cache
+  useCustomMac = configStore.getBytes(CONFIG_BLE_CUSTOM_MAC, customMacAddress, sizeof(customMacAddress)) == sizeof(customMacAddress);
+  macAddressSet = useCustomMac;
+  if (!useCustomMac) {
     memset(customMacAddress, 0, 6);
   }
   
-  vendorId = preferences.getUShort("vendor_id", HID_VENDOR_ID);
-  productId = preferences.getUShort("product_id", HID_PRODUCT_ID);
-  versionId = preferences.getUShort("version_id", HID_VERSION_ID);
-  deviceName = preferences.getString("device_name", BLE_DEVICE_NAME).c_str();
-  deviceManufacturer = preferences.getString("manufacturer_name", BLE_MANUFACTURER_NAME).c_str();
-  countryCode = preferences.getUChar("country_code", HID_COUNTRY_CODE);
-  hidFlags = preferences.getUChar("hid_flags", HID_FLAGS);
-  batteryLevel = preferences.getUChar("initial_battery_level", BLE_INITIAL_BATTERY_LEVEL);
+  vendorId = configStore.getNumber(CONFIG_BLE_VENDOR_ID);
+  productId = configStore.getNumber(CONFIG_BLE_PRODUCT_ID);
+  versionId = configStore.getNumber(CONFIG_BLE_VERSION_ID);
+  deviceName = configStore.getString(CONFIG_BLE_DEVICE_NAME).c_str();
+  deviceManufacturer = configStore.getString(CONFIG_BLE_MANUFACTURER).c_str();
+  countryCode = configStore.getNumber(CONFIG_BLE_COUNTRY_CODE);
+  hidFlags = configStore.getNumber(CONFIG_BLE_HID_FLAGS);
+  batteryLevel = configStore.getNumber(CONFIG_BLE_BATTERY_LEVEL);
+  activeProfile = configStore.getString(CONFIG_BLE_PROFILE).c_str();
+  configVersion++;
+}
 
+// Uploaded descriptor if one is stored and still valid, else the built-in one
+void BleRemoteControl::loadReportDescriptor() {
+  String error;
+  preferences.begin("ble", true);
+  size_t length = preferences.isKey("hid_desc") ? preferences.getBytesLength("hid_desc") : 0;
+  if (length > 0 && length <= sizeof(reportDescriptor)) {
+    preferences.getBytes("hid_desc", reportDescriptor, length);
+    if (HidDescriptorParser::parse(reportDescriptor, length, layout, error)) {
+      reportDescriptorLength = length;
+      customDescriptor = true;
+    } else {
+      Serial.println("Warning: Stored HID descriptor rejected: " + error);
+    }
+  }
   preferences.end();
+
+  if (!customDescriptor) {
+    memcpy(reportDescriptor, _hidReportDescriptor.data(), _hidReportDescriptor.size());
+    reportDescriptorLength = _hidReportDescriptor.size();
+    HidDescriptorParser::parse(reportDescriptor, reportDescriptorLength, layout, error);
+  }
+  descriptorPending = false;
 }
 
 void BleRemoteControl::saveConfig() {
-  // Save preferences for custom MAC address and device configuration
-  preferences.begin("ble", false);
-  
-  // Save MAC address
+  // Only fields that changed are written
   if (useCustomMac) {
-    preferences.putBytes("custom_mac", customMacAddress, sizeof(customMacAddress));
+    configStore.setBytes(CONFIG_BLE_CUSTOM_MAC, customMacAddress, sizeof(customMacAddress));
   } else {
-    preferences.remove("custom_mac");
+    configStore.reset(CONFIG_BLE_CUSTOM_MAC);
   }
 
-  preferences.putUShort("vendor_id", vendorId);
-  preferences.putUShort("product_id", productId);
-  preferences.putUShort("version_id", versionId);
-  preferences.putString("device_name", deviceName.c_str());
-  preferences.putString("manufacturer_name", deviceManufacturer.c_str());
-  preferences.putUChar("country_code", countryCode);
-  preferences.putUChar("hid_flags", hidFlags);
-  preferences.putUChar("initial_battery_level", batteryLevel);
-  preferences.end();
+  configStore.setNumber(CONFIG_BLE_VENDOR_ID, vendorId);
+  configStore.setNumber(CONFIG_BLE_PRODUCT_ID, productId);
+  configStore.setNumber(CONFIG_BLE_VERSION_ID, versionId);
+  configStore.setString(CONFIG_BLE_DEVICE_NAME, deviceName.c_str());
+  configStore.setString(CONFIG_BLE_MANUFACTURER, deviceManufacturer.c_str());
+  configStore.setNumber(CONFIG_BLE_COUNTRY_CODE, countryCode);
+  configStore.setNumber(CONFIG_BLE_HID_FLAGS, hidFlags);
+  configStore.setNumber(CONFIG_BLE_BATTERY_LEVEL, batteryLevel);
+  configStore.setString(CONFIG_BLE_PROFILE, activeProfile.c_str());
+  configStore.commit();
 }
 
 void BleRemoteControl::begin(void)
@@ -79,12 +96,27 @@ void BleRemoteControl::begin(void)
   pServer = BLEDevice::createServer();
   pServer->setCallbacks(this);
 
+  // One report characteristic per report the descriptor declares
+  loadReportDescriptor();
   hid = new BLEHIDDevice(pServer);
-  inputKeyboard = hid->inputReport(KEYBOARD_ID);  // <-- input REPORTID from report map
-  outputKeyboard = hid->outputReport(KEYBOARD_ID);
-  inputMediaKeys = hid->inputReport(MEDIA_KEYS_ID);
+  if (layout.hasKeyboard) {
+    inputKeyboard = hid->inputReport(layout.keyboardId);
+  }
+  if (layout.hasOutput) {
+    outputKeyboard = hid->outputReport(layout.outputId);
+    outputKeyboard->setCallbacks(this);
+  }
+  if (layout.hasConsumer) {
+    inputMediaKeys = hid->inputReport(layout.consumerId);
+  }
 
-  outputKeyboard->setCallbacks(this);
+  // Congestion events for the report TX queues
+  instance = this;
+  if (txMutex == nullptr) {
+    txMutex = xSemaphoreCreateMutex();
+  }
+  BLEDevice::setCustomGattsHandler(handleGattsEvent);
+  BLEDevice::setCustomGapHandler(handleGapEvent);
 
 //  if(!deviceManufacturer.empty()) {
     hid->manufacturer()->setValue(deviceManufacturer);
@@ -96,9 +128,17 @@ void BleRemoteControl::begin(void)
   BLESecurity* pSecurity = new BLESecurity();
   pSecurity->setAuthenticationMode(ESP_LE_AUTH_REQ_SC_MITM_BOND);
 
-  hid->reportMap((uint8_t*)_hidReportDescriptor, sizeof(_hidReportDescriptor));
+  hid->reportMap(reportDescriptor, reportDescriptorLength);
   hid->startServices();
 
+  // CCCD handles to track the subscription of each host separately
+  if (inputKeyboard != nullptr) {
+    keyboardCccdHandle = inputKeyboard->getDescriptorByUUID(BLEUUID((uint16_t)0x2902))->getHandle();
+  }
+  if (inputMediaKeys != nullptr) {
+    mediaCccdHandle = inputMediaKeys->getDescriptorByUUID(BLEUUID((uint16_t)0x2902))->getHandle();
+  }
+
   onStarted(pServer);
 
   
@@ -147,35 +187,65 @@ bool BleRemoteControl::removeBonding() {
 	return false;
   }
 
-  bool BleRemoteControl::disconnect() {
-    if (this->connected && pServer != nullptr) {
-      // The disconnect method returns void, so check if connected
-      if (pServer->getConnectedCount() > 0) {
-        pServer->disconnect(0); // 0 for all connections
-        return true;
-      }
-    }
+bool BleRemoteControl::disconnect(uint8_t target) {
+  if (!this->connected || pServer == nullptr || txMutex == nullptr) {
     return false;
   }
+  uint16_t connIds[BLE_MAX_CONNECTIONS];
+  size_t count = 0;
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  for (HostConnection& conn : connections) {
+    if (conn.active && (target == BLE_TARGET_ALL || conn.connId == target)) {
+      connIds[count++] = conn.connId;
+    }
+  }
+  xSemaphoreGive(txMutex);
+  // onDisconnect() runs later on the Bluedroid task
+  for (size_t i = 0; i < count; i++) {
+    pServer->disconnect(connIds[i]);
+  }
+  return count > 0;
+}
+
+void BleRemoteControl::onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+	size_t activeCount = 0;
 
-void BleRemoteControl::onDisconnect(BLEServer* pServer) {
-	this->connected = false;
+	// Reports for the old link are meaningless for the next host
+	if (xSemaphoreTake(txMutex, portMAX_DELAY) == pdTRUE) {
+	  HostConnection* conn = findConnection(param->disconnect.conn_id);
+	  if (conn != nullptr) {
+	    conn->keyTxQueue.clear();
+	    conn->mediaTxQueue.clear();
+	    conn->active = false;
+	  }
+	  for (HostConnection& other : connections) {
+	    if (other.active) {
+	      activeCount++;
+	    }
+	  }
+	  xSemaphoreGive(txMutex);
+	}
+	this->connected = activeCount > 0;
 	
 	// Log disconnection
-	ESP_LOGI(LOG_TAG, "Device disconnected");
+	ESP_LOGI(LOG_TAG, "Device disconnected, conn_id %d", param->disconnect.conn_id);
   
-	BLE2902* desc = (BLE2902*)this->inputKeyboard->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-	desc->setNotifications(false);
-	desc = (BLE2902*)this->inputMediaKeys->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-	desc->setNotifications(false);
+	if (activeCount == 0) {
+	  setNotifications(false);
+	}
   
 	advertising->start();
+
+	if (connectCallback) {
+	  connectCallback(false, param->disconnect.conn_id);
+	}
   }
 
 void BleRemoteControl::setBatteryLevel(uint8_t level) {
   this->batteryLevel = level;
   if (hid != 0)
     this->hid->setBatteryLevel(this->batteryLevel);
+  DLOG(BLE_BATTERY_LEVEL, level);
 }
 
 /**
@@ -188,280 +258,655 @@ void BleRemoteControl::setDefaultDelay(uint32_t ms) {
 }
 
 
-bool BleRemoteControl::sendKey(String k, uint32_t delay_ms)
+bool BleRemoteControl::sendPress(KeyId k, uint8_t target)
 {
-    if (!sendPress(k)) {
+    if (!k.isValid()) {
         return false;
     }
-    delay(delay_ms);
-    return sendRelease(k);
+
+    if (k.isMedia()) {
+        return sendMediaReport(k.code, 0, target);
+    }
+
+    // Press key
+    return press((uint8_t)k.code, target) > 0;
 }
 
-bool BleRemoteControl::sendPress(String k)
+bool BleRemoteControl::sendMediaPress(uint16_t first, uint16_t second, uint8_t target)
 {
-    // Check if the key is a media key
-    if (isMediaKey(k)) {
-        uint16_t mediaKeyCode = getMediaKeyCode(k);
-        if (mediaKeyCode != 0) {
-			sendMediaReport(mediaKeyCode);
-            return true;
-        }
+  return sendMediaReport(first, second, target);
+}
+
+bool BleRemoteControl::sendMediaRelease(uint8_t target)
+{
+  return sendMediaReport(0, 0, target);
+}
+
+
+bool BleRemoteControl::sendRelease(KeyId k, uint8_t target)
+{
+    if (!k.isValid()) {
         return false;
     }
 
-    // Determine key and press
-    uint8_t keyCode = 0;
+    if (k.isMedia()) {
+		return sendMediaReport(0, 0, target);
+    }
 
-    if (k.length() == 1) {
-        // Single character
-        keyCode = k.charAt(0);
-    } else {
-        // Special key via mapping
-        keyCode = getKeyCode(k);
-        if (keyCode == 0) {
-            return false;
-        }
+    // Release key
+    return release((uint8_t)k.code, target) > 0;
+}
+
+bool BleRemoteControl::sendKeyReport(const KeyReport& report, uint8_t target)
+{
+	bool accepted = updateTargets(target, [this, &report](HostConnection& conn) {
+		return pushKeyReport(conn, report);
+	}) > 0;
+	if (accepted && recorder != nullptr) {
+		recorder->recordReport(reinterpret_cast<const uint8_t*>(&report));
+	}
+	return accepted;
+}
+
+void BleRemoteControl::releaseAll(uint8_t target)
+{
+	updateTargets(target, [this](HostConnection& conn) {
+		KeyReport keys = {};
+		MediaKeyReport media = {};
+		bool keysAccepted = pushKeyReport(conn, keys);
+		bool mediaAccepted = pushMediaReport(conn, media);
+		return keysAccepted && mediaAccepted;
+	});
+	if (recorder != nullptr) {
+		recorder->recordReleaseAll();
+	}
+}
+
+HostConnection* BleRemoteControl::findConnection(uint16_t connId)
+{
+  for (HostConnection& conn : connections) {
+    if (conn.active && conn.connId == connId) {
+      return &conn;
     }
-    
-    // Press key
-    press(keyCode);
-    return true;
+  }
+  return nullptr;
+}
+
+// Applies update() to every connection selected by target under the TX mutex
+// and sends the queued reports afterwards. Returns the number of hosts that
+// accepted their report.
+template <typename Update>
+size_t BleRemoteControl::updateTargets(uint8_t target, Update update)
+{
+  if (!this->isConnected() || txMutex == nullptr)
+  {
+    return 0;
+  }
+  size_t accepted = 0;
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  for (HostConnection& conn : connections) {
+    if (conn.active && (target == BLE_TARGET_ALL || conn.connId == target) && update(conn)) {
+      accepted++;
+    }
+  }
+  xSemaphoreGive(txMutex);
+  drainTxQueues(portMAX_DELAY);
+  return accepted;
+}
+
+// Shared BLE2902 values, the per-host subscription is tracked from the CCCD writes
+void BleRemoteControl::setNotifications(bool enabled)
+{
+  BLECharacteristic* inputs[] = {inputKeyboard, inputMediaKeys};
+  for (BLECharacteristic* input : inputs) {
+    if (input != nullptr) {
+      ((BLE2902*)input->getDescriptorByUUID(BLEUUID((uint16_t)0x2902)))->setNotifications(enabled);
+    }
+  }
 }
 
-bool BleRemoteControl::sendMediaKeyHex(String k, uint8_t position, uint32_t delay_ms)
+// A release only takes keys or modifiers out of the report the host has, it
+// must never be refused by the TX queue.
+static bool isKeyRelease(const KeyReport& next, const KeyReport& current)
 {
-  uint16_t result = 0;
-  if(!parseHexValue16(k, result)) {
+  if ((next.modifiers & ~current.modifiers) != 0) {
     return false;
-  } else {
-    if(position == 1) {
-      sendMediaReport(result);
-    } else if (position == 2)
-    {
-      sendMediaReport(0, result);
-    } else {
+  }
+  for (uint8_t key : next.keys) {
+    if (key != 0 && memchr(current.keys, key, sizeof(current.keys)) == nullptr) {
       return false;
     }
-    delay(delay_ms);
-    sendMediaReport((uint16_t)0);
-    return true;
   }
+  return true;
+}
+
+static bool isMediaRelease(const MediaKeyReport& next, const MediaKeyReport& current)
+{
+  const uint16_t usages[] = {next.consumer1, next.consumer2};
+  for (uint16_t usage : usages) {
+    if (usage != 0 && usage != current.consumer1 && usage != current.consumer2) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The host's report state only changes if the TX queue accepted the report.
+// With the built-in descriptor the report structs are the wire format (checked
+// by static_assert), an uploaded one needs packing to its layout.
+bool BleRemoteControl::pushKeyReport(HostConnection& conn, const KeyReport& report)
+{
+  DLOG(BLE_KEY_REPORT, report.modifiers, report.reserved, report.keys[0], report.keys[1],
+       report.keys[2], report.keys[3], report.keys[4], report.keys[5]);
+  if (!layout.hasKeyboard) {
+    return false;
+  }
+  uint8_t packed[HID_REPORT_MAX_LENGTH] = {};
+  if (customDescriptor) {
+    layout.packKeyboard(report.modifiers, report.keys, packed);
+  } else {
+    memcpy(packed, &report, sizeof(KeyReport));
+  }
+  if (conn.keyTxQueue.push(packed, isKeyRelease(report, conn.keyReport)) == KeyReportQueue::REJECTED) {
+    return false;
+  }
+  conn.keyReport = report;
+  lastReportQueuedAt = esp_timer_get_time();
+  return true;
 }
 
-bool BleRemoteControl::sendMediaKey(uint16_t first, uint16_t second, uint32_t delay_ms)
+bool BleRemoteControl::pushMediaReport(HostConnection& conn, const MediaKeyReport& report)
 {
-  sendMediaReport(first, second);
-  delay(delay_ms);
-  sendMediaReport(0,0);
+  if (!layout.hasConsumer) {
+    return false;
+  }
+  uint8_t packed[HID_REPORT_MAX_LENGTH] = {};
+  if (customDescriptor) {
+    layout.packConsumer(report.consumer1, report.consumer2, packed);
+  } else {
+    memcpy(packed, &report, sizeof(MediaKeyReport));
+  }
+  DLOG(BLE_MEDIA_REPORT, packed[0], packed[1], packed[2], packed[3], packed[4]);
+  if (conn.mediaTxQueue.push(packed, isMediaRelease(report, conn.mediaReport)) == MediaReportQueue::REJECTED) {
+    return false;
+  }
+  conn.mediaReport = report;
+  lastReportQueuedAt = esp_timer_get_time();
   return true;
 }
 
+bool BleRemoteControl::sendMediaReport(uint16_t key1, uint16_t key2, uint8_t target)
+{
+  bool accepted = updateTargets(target, [this, key1, key2](HostConnection& conn) {
+    MediaKeyReport report = {};
+    report.consumer1 = key1;
+    report.consumer2 = key2;
+    return pushMediaReport(conn, report);
+  }) > 0;
+  if (accepted && recorder != nullptr) {
+    recorder->recordMedia(key1, key2);
+  }
+  return accepted;
+}
 
-bool BleRemoteControl::sendRelease(String k)
+// Sends queued reports until a queue is empty or the link is congested. A caller
+// that cannot get the mutex leaves drainRequested set, the holder drains again.
+void BleRemoteControl::drainTxQueues(TickType_t wait)
 {
-    // Check if the key is a media key
-    if (isMediaKey(k)) {
-		sendMediaReport((uint16_t)0);
-		return true;
+  HeapTagScope heapTag(HEAP_TAG_BLE);
+  drainRequested = true;
+  while (drainRequested) {
+    if (txMutex == nullptr || xSemaphoreTake(txMutex, wait) != pdTRUE) {
+      return;
     }
-    // Determine key and release
-    uint8_t keyCode = 0;
+    drainRequested = false;
+    for (HostConnection& conn : connections) {
+      if (conn.active) {
+        drainTxQueue(conn, conn.keyTxQueue, inputKeyboard, conn.keyboardSubscribed, layout.keyboardLength);
+        drainTxQueue(conn, conn.mediaTxQueue, inputMediaKeys, conn.mediaSubscribed, layout.consumerLength);
+      }
+    }
+    xSemaphoreGive(txMutex);
+  }
+}
 
-    if (k.length() == 1) {
-        // Single character
-        keyCode = k.charAt(0);
-    } else {
-        // Special key via mapping
-        keyCode = getKeyCode(k);
-        if (keyCode == 0) {
-            return false;
-        }
+// BLECharacteristic::notify() would send to every peer, so the report is sent
+// to this connection only with esp_ble_gatts_send_indicate().
+template <typename Queue>
+bool BleRemoteControl::drainTxQueue(HostConnection& conn, Queue& queue, BLECharacteristic* characteristic,
+                                    bool subscribed, size_t length)
+{
+  while (!queue.empty() && !queue.isCongested()) {
+    if (!subscribed) {
+      queue.countNotifyFailure();
+      queue.discard(); // Host did not subscribe, retrying would block the queue
+      continue;
     }
-    
-    // Release key
-    release(keyCode);
-    return true;
+    characteristic->setValue((uint8_t*)queue.front(), length);   // Value returned on reads
+    esp_err_t err = esp_ble_gatts_send_indicate(gattsIf, conn.connId, characteristic->getHandle(),
+                                                length, (uint8_t*)queue.front(), false);
+    if (err == ESP_OK) {
+      lastNotifiedAt = esp_timer_get_time();
+      queue.pop();
+      continue;
+    }
+    queue.countNotifyFailure();
+    DLOG(BLE_NOTIFY_FAILED, err, queue.size());
+    return false; // Keep the report, retried on the next send or notify confirmation
+  }
+  return true;
 }
 
-void BleRemoteControl::releaseAll(void)
+// Timestamps of the last report put into a TX queue and the last successful notify()
+void BleRemoteControl::getTxTimestamps(int64_t& reportQueuedAt, int64_t& notifiedAt)
 {
-	_keyReport.keys[0] = 0;
-	_keyReport.keys[1] = 0;
-	_keyReport.keys[2] = 0;
-	_keyReport.keys[3] = 0;
-	_keyReport.keys[4] = 0;
-	_keyReport.keys[5] = 0;
-	_keyReport.modifiers = 0;
-    _mediaKeyReport.consumer1 = 0;
-    _mediaKeyReport.consumer2 = 0;
-    _mediaKeyReport.padding = 0;
-	sendKeyReport(&_keyReport);
-	sendMediaReport(&_mediaKeyReport);
+  if (txMutex == nullptr) {
+    reportQueuedAt = 0;
+    notifiedAt = 0;
+    return;
+  }
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  reportQueuedAt = lastReportQueuedAt;
+  notifiedAt = lastNotifiedAt;
+  xSemaphoreGive(txMutex);
 }
 
-void BleRemoteControl::sendKeyReport(KeyReport* keys)
+bool BleRemoteControl::isTxQueueFull(uint8_t target)
 {
-  if (this->isConnected())
-  {
-    this->inputKeyboard->setValue((uint8_t*)keys, sizeof(KeyReport));
-    this->inputKeyboard->notify();
-  }	
+  if (txMutex == nullptr) {
+    return false;
+  }
+  bool full = false;
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  for (HostConnection& conn : connections) {
+    if (conn.active && (target == BLE_TARGET_ALL || conn.connId == target) &&
+        (conn.keyTxQueue.full() || conn.mediaTxQueue.full())) {
+      full = true;
+      break;
+    }
+  }
+  xSemaphoreGive(txMutex);
+  return full;
 }
 
-void BleRemoteControl::sendMediaReport(MediaKeyReport* keys)
+static void addQueueStats(ReportQueueStats& total, const ReportQueueStats& stats)
 {
-  if (this->isConnected())
-  {
-    uint8_t* data = (uint8_t*)keys;
-    size_t length = 5;// sizeof(MediaKeyReport);
-    Serial.print(length);
-   	Serial.print(" Sending Media Key Report: ");
-    for (size_t i = 0; i < length; i++) {
-        if (data[i] < 0x10) Serial.print("0");
-        Serial.print(data[i], HEX);
-        Serial.print(" ");
-    }  	
-    Serial.println();
-    this->inputMediaKeys->setValue(data, length);
-    this->inputMediaKeys->notify();
-  }	
-}
-
-void BleRemoteControl::sendMediaReport(uint16_t key)
-{
-  if (this->isConnected())
-  {
-    _mediaKeyReport.consumer1 = key;
-    _mediaKeyReport.consumer2 = 0;
-    _mediaKeyReport.padding = 0;
-    sendMediaReport(&_mediaKeyReport);
+  total.depth += stats.depth;
+  total.queued += stats.queued;
+  total.coalesced += stats.coalesced;
+  total.rejected += stats.rejected;
+  total.notified += stats.notified;
+  total.notifyFailures += stats.notifyFailures;
+  total.congestionEvents += stats.congestionEvents;
+  total.congested = total.congested || stats.congested;
+}
+
+ReportQueueStats BleRemoteControl::getKeyTxStats()
+{
+  ReportQueueStats total = {};
+  if (txMutex == nullptr) {
+    return total;
+  }
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  for (HostConnection& conn : connections) {
+    addQueueStats(total, conn.keyTxQueue.getStats());
   }
+  xSemaphoreGive(txMutex);
+  return total;
 }
 
-void BleRemoteControl::sendMediaReport(uint16_t key1, uint16_t key2)
+ReportQueueStats BleRemoteControl::getMediaTxStats()
 {
-  if (this->isConnected())
-  {
-    _mediaKeyReport.consumer1 = key1;
-    _mediaKeyReport.consumer2 = key2;
-    _mediaKeyReport.padding = 0;
-    sendMediaReport(&_mediaKeyReport);
+  ReportQueueStats total = {};
+  if (txMutex == nullptr) {
+    return total;
+  }
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  for (HostConnection& conn : connections) {
+    addQueueStats(total, conn.mediaTxQueue.getStats());
   }
+  xSemaphoreGive(txMutex);
+  return total;
 }
 
-// press() adds the specified key (printing, non-printing, or modifier)
-// to the persistent key report and sends the report.  Because of the way
-// USB HID works, the host acts like the key remains pressed until we
-// call release(), releaseAll(), or otherwise clear the report and resend.
-size_t BleRemoteControl::press(uint8_t k)
+bool BleRemoteControl::isConnected(uint8_t target)
 {
-	uint8_t i;
-	if (k >= 136) {			// it's a non-printing key (not a modifier)
-		k = k - 136;
-	} else if (k >= 128) {	// it's a modifier key
-		_keyReport.modifiers |= (1<<(k-128));
-		k = 0;
-	} else {				// it's a printing key
-		k = pgm_read_byte(_asciimap + k);
-		if (!k) {
-			return 0;
-		}
-		if (k & 0x80) {						// it's a capital letter or other character reached with shift
-			_keyReport.modifiers |= 0x02;	// the left shift modifier
-			k &= 0x7F;
-		}
-	}
+  if (target == BLE_TARGET_ALL) {
+    return this->connected;
+  }
+  if (txMutex == nullptr) {
+    return false;
+  }
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  bool found = findConnection(target) != nullptr;
+  xSemaphoreGive(txMutex);
+  return found;
+}
 
-	// Add k to the key report only if it's not already present
-	// and if there is an empty slot.
-	if (_keyReport.keys[0] != k && _keyReport.keys[1] != k &&
-		_keyReport.keys[2] != k && _keyReport.keys[3] != k &&
-		_keyReport.keys[4] != k && _keyReport.keys[5] != k) {
+size_t BleRemoteControl::getConnections(HostConnectionInfo* infos, size_t maxCount)
+{
+  if (txMutex == nullptr) {
+    return 0;
+  }
+  size_t count = 0;
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  for (HostConnection& conn : connections) {
+    if (conn.active && count < maxCount) {
+      HostConnectionInfo& info = infos[count++];
+      info.connId = conn.connId;
+      info.address = macAddressToString(conn.address);
+      info.keyboardSubscribed = conn.keyboardSubscribed;
+      info.mediaSubscribed = conn.mediaSubscribed;
+      info.keyTx = conn.keyTxQueue.getStats();
+      info.mediaTx = conn.mediaTxQueue.getStats();
+      info.interval = conn.interval;
+      info.latency = conn.latency;
+      info.timeout = conn.timeout;
+      info.paramUpdates = conn.paramUpdates;
+    }
+  }
+  xSemaphoreGive(txMutex);
+  return count;
+}
 
-		for (i=0; i<6; i++) {
-			if (_keyReport.keys[i] == 0x00) {
-				_keyReport.keys[i] = k;
-				break;
-			}
-		}
-		if (i == 6) {
-			return 0;
-		}
-	}
-	sendKeyReport(&_keyReport);
-	return 1;
+uint32_t BleRemoteControl::getMinHoldUs(uint8_t target)
+{
+  if (txMutex == nullptr) {
+    return 0;
+  }
+  uint16_t interval = 0;
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  for (HostConnection& conn : connections) {
+    if (conn.active && (target == BLE_TARGET_ALL || conn.connId == target) && conn.interval > interval) {
+      interval = conn.interval;
+    }
+  }
+  xSemaphoreGive(txMutex);
+  return interval != 0 ? minHoldForInterval(interval) : 0;
 }
 
-size_t BleRemoteControl::press(const MediaKeyReport k)
+void BleRemoteControl::deferredDrain(void* self, uint32_t unused)
 {
-    // Set the media key report values
-    _mediaKeyReport.consumer1 |= k.consumer1;
-    _mediaKeyReport.consumer2 |= k.consumer2;
-    _mediaKeyReport.padding = 0xff;  // Always 0 for padding
+  static_cast<BleRemoteControl*>(self)->drainTxQueues(pdMS_TO_TICKS(20));
+}
 
-	sendMediaReport(&_mediaKeyReport);
-	return 1;
+// Runs on the Bluedroid task: only update flags here and defer the actual
+// notify calls to the timer service task. The per-host state is shared with
+// the send and drain paths, so it is only touched under the TX mutex, like in
+// onConnect() and onDisconnect().
+void BleRemoteControl::handleGattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t* param)
+{
+  BleRemoteControl* self = instance;
+  if (self == nullptr || self->txMutex == nullptr) {
+    return;
+  }
+  switch (event) {
+    case ESP_GATTS_CONNECT_EVT:
+      self->gattsIf = gatts_if;
+      break;
+    case ESP_GATTS_WRITE_EVT: {
+      // Per-host CCCD, the shared BLE2902 only holds the value of the last writer
+      if (param->write.len != 2) {
+        break;
+      }
+      bool notify = (param->write.value[0] & 0x01) != 0;
+      xSemaphoreTake(self->txMutex, portMAX_DELAY);
+      HostConnection* conn = self->findConnection(param->write.conn_id);
+      if (conn != nullptr) {
+        if (param->write.handle == self->keyboardCccdHandle) {
+          conn->keyboardSubscribed = notify;
+        } else if (param->write.handle == self->mediaCccdHandle) {
+          conn->mediaSubscribed = notify;
+        }
+      }
+      xSemaphoreGive(self->txMutex);
+      break;
+    }
+    case ESP_GATTS_CONGEST_EVT: {
+      xSemaphoreTake(self->txMutex, portMAX_DELAY);
+      HostConnection* conn = self->findConnection(param->congest.conn_id);
+      if (conn != nullptr) {
+        conn->keyTxQueue.setCongested(param->congest.congested);
+        conn->mediaTxQueue.setCongested(param->congest.congested);
+      }
+      xSemaphoreGive(self->txMutex);
+      DLOG(BLE_CONGESTED, param->congest.congested);
+      if (!param->congest.congested) {
+        xTimerPendFunctionCall(deferredDrain, self, 0, 0);
+      }
+      break;
+    }
+    case ESP_GATTS_CONF_EVT: {
+      xSemaphoreTake(self->txMutex, portMAX_DELAY);
+      HostConnection* conn = self->findConnection(param->conf.conn_id);
+      bool pending = conn != nullptr && (!conn->keyTxQueue.empty() || !conn->mediaTxQueue.empty());
+      xSemaphoreGive(self->txMutex);
+      if (pending) {
+        xTimerPendFunctionCall(deferredDrain, self, 0, 0);
+      }
+      break;
+    }
+    default:
+      break;
+  }
 }
 
-// release() takes the specified key out of the persistent key report and
-// sends the report.  This tells the OS the key is no longer pressed and that
-// it shouldn't be repeated any more.
-size_t BleRemoteControl::release(uint8_t k)
+// Runs on the Bluedroid task, records the parameters the central settled on
+void BleRemoteControl::handleGapEvent(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param)
+{
+  BleRemoteControl* self = instance;
+  if (self == nullptr || self->txMutex == nullptr || event != ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) {
+    return;
+  }
+  const auto& update = param->update_conn_params;
+  DLOG(BLE_CONN_PARAMS, update.status, update.conn_int, update.latency, update.timeout);
+  if (update.status != ESP_BT_STATUS_SUCCESS) {
+    return;
+  }
+  xSemaphoreTake(self->txMutex, portMAX_DELAY);
+  for (HostConnection& conn : self->connections) {
+    if (conn.active && memcmp(conn.address, update.bda, sizeof(esp_bd_addr_t)) == 0) {
+      conn.interval = update.conn_int;
+      conn.latency = update.latency;
+      conn.timeout = update.timeout;
+      conn.paramUpdates++;
+    }
+  }
+  xSemaphoreGive(self->txMutex);
+}
+
+bool BleRemoteControl::isValidConnParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout)
 {
-	uint8_t i;
+  if (minInterval < BLE_CONN_INTERVAL_MIN || maxInterval > BLE_CONN_INTERVAL_MAX || minInterval > maxInterval) {
+    return false;
+  }
+  if (latency > BLE_CONN_LATENCY_MAX || timeout < BLE_CONN_TIMEOUT_MIN || timeout > BLE_CONN_TIMEOUT_MAX) {
+    return false;
+  }
+  // The supervision timeout must cover more than two effective intervals
+  return (uint32_t)timeout * 10 * 4 > (uint32_t)(1 + latency) * maxInterval * 5 * 2;
+}
+
+esp_err_t BleRemoteControl::requestConnParams(uint8_t target, uint16_t minInterval, uint16_t maxInterval,
+                                              uint16_t latency, uint16_t timeout)
+{
+  if (!isValidConnParams(minInterval, maxInterval, latency, timeout)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (txMutex == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  esp_ble_conn_update_params_t params[BLE_MAX_CONNECTIONS];
+  size_t count = 0;
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  for (HostConnection& conn : connections) {
+    if (conn.active && (target == BLE_TARGET_ALL || conn.connId == target)) {
+      esp_ble_conn_update_params_t& request = params[count++];
+      memcpy(request.bda, conn.address, sizeof(esp_bd_addr_t));
+      request.min_int = minInterval;
+      request.max_int = maxInterval;
+      request.latency = latency;
+      request.timeout = timeout;
+    }
+  }
+  xSemaphoreGive(txMutex);
+  if (count == 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  esp_err_t result = ESP_OK;
+  for (size_t i = 0; i < count; i++) {
+    esp_err_t err = esp_ble_gap_update_conn_params(&params[i]);
+    if (err != ESP_OK) {
+      result = err;
+    }
+  }
+  return result;
+}
+
+// Converts a key code into a HID usage plus modifier bits. Codes >= 136 are
+// non-printing keys, 128..135 modifiers and below 128 ASCII characters.
+bool BleRemoteControl::translateKey(uint8_t& k, uint8_t& modifiers)
+{
+	modifiers = 0;
 	if (k >= 136) {			// it's a non-printing key (not a modifier)
 		k = k - 136;
 	} else if (k >= 128) {	// it's a modifier key
-		_keyReport.modifiers &= ~(1<<(k-128));
+		modifiers = (1<<(k-128));
 		k = 0;
 	} else {				// it's a printing key
 		k = pgm_read_byte(_asciimap + k);
 		if (!k) {
-			return 0;
+			return false;
 		}
-		if (k & 0x80) {							// it's a capital letter or other character reached with shift
-			_keyReport.modifiers &= ~(0x02);	// the left shift modifier
+		if (k & 0x80) {						// it's a capital letter or other character reached with shift
+			modifiers = 0x02;				// the left shift modifier
 			k &= 0x7F;
 		}
 	}
+	return true;
+}
 
-	// Test the key report to see if k is present.  Clear it if it exists.
-	// Check all positions in case the key is present more than once (which it shouldn't be)
-	for (i=0; i<6; i++) {
-		if (0 != k && _keyReport.keys[i] == k) {
-			_keyReport.keys[i] = 0x00;
-		}
+// press() adds the specified key (printing, non-printing, or modifier)
+// to the key report of each target host and sends the report.  Because of the way
+// USB HID works, the host acts like the key remains pressed until we
+// call release(), releaseAll(), or otherwise clear the report and resend.
+size_t BleRemoteControl::press(uint8_t k, uint8_t target)
+{
+	uint8_t code = k;
+	uint8_t modifiers;
+	if (!translateKey(k, modifiers)) {
+		return 0;
 	}
 
-	sendKeyReport(&_keyReport);
-	return 1;
+	size_t accepted = updateTargets(target, [this, k, modifiers](HostConnection& conn) {
+		KeyReport report = conn.keyReport;
+		report.modifiers |= modifiers;
+
+		// Add k to the key report only if it's not already present
+		// and if there is an empty slot.
+		if (k != 0 && report.keys[0] != k && report.keys[1] != k &&
+			report.keys[2] != k && report.keys[3] != k &&
+			report.keys[4] != k && report.keys[5] != k) {
+
+			uint8_t i;
+			for (i=0; i<6; i++) {
+				if (report.keys[i] == 0x00) {
+					report.keys[i] = k;
+					break;
+				}
+			}
+			if (i == 6) {
+				return false;
+			}
+		}
+		return pushKeyReport(conn, report);
+	});
+	if (accepted > 0 && recorder != nullptr) {
+		recorder->recordKey(KEY_REC_PRESS, code);
+	}
+	return accepted;
 }
 
-size_t BleRemoteControl::release(const MediaKeyReport k)
+// release() takes the specified key out of the key report of each target host
+// and sends the report.  This tells the OS the key is no longer pressed and that
+// it shouldn't be repeated any more.
+size_t BleRemoteControl::release(uint8_t k, uint8_t target)
 {
-    // Clear the specified media keys
-    _mediaKeyReport.consumer1 &= ~k.consumer1;
-    _mediaKeyReport.consumer2 &= ~k.consumer2;
-    _mediaKeyReport.padding = 0;  // Always 0 for padding
+	uint8_t code = k;
+	uint8_t modifiers;
+	if (!translateKey(k, modifiers)) {
+		return 0;
+	}
+
+	size_t accepted = updateTargets(target, [this, k, modifiers](HostConnection& conn) {
+		KeyReport report = conn.keyReport;
+		report.modifiers &= ~modifiers;
 
-	sendMediaReport(&_mediaKeyReport);
-	return 1;
+		// Test the key report to see if k is present.  Clear it if it exists.
+		// Check all positions in case the key is present more than once (which it shouldn't be)
+		for (uint8_t i=0; i<6; i++) {
+			if (0 != k && report.keys[i] == k) {
+				report.keys[i] = 0x00;
+			}
+		}
+		return pushKeyReport(conn, report);
+	});
+	if (accepted > 0 && recorder != nullptr) {
+		recorder->recordKey(KEY_REC_RELEASE, code);
+	}
+	return accepted;
 }
 
-void BleRemoteControl::onConnect(BLEServer* pServer) {
-  this->connected = true;
+void BleRemoteControl::onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+  size_t activeCount = 0;
+  if (xSemaphoreTake(txMutex, portMAX_DELAY) == pdTRUE) {
+    HostConnection* slot = nullptr;
+    for (HostConnection& conn : connections) {
+      if (!conn.active && slot == nullptr) {
+        slot = &conn;
+      }
+    }
+    if (slot != nullptr) {
+      slot->keyTxQueue.clear();
+      slot->mediaTxQueue.clear();
+      slot->keyReport = {};
+      slot->mediaReport = {};
+      slot->connId = param->connect.conn_id;
+      memcpy(slot->address, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+      // Bonded hosts often do not rewrite the CCCD after reconnecting, so
+      // notifications start enabled like before
+      slot->keyboardSubscribed = true;
+      slot->mediaSubscribed = true;
+      slot->interval = param->connect.conn_params.interval;
+      slot->latency = param->connect.conn_params.latency;
+      slot->timeout = param->connect.conn_params.timeout;
+      slot->paramUpdates = 0;
+      slot->active = true;
+    }
+    for (HostConnection& conn : connections) {
+      if (conn.active) {
+        activeCount++;
+      }
+    }
+    xSemaphoreGive(txMutex);
+  }
+  this->connected = activeCount > 0;
+  this->connectCount++;
 
   // For regular BLE, log connection
-  ESP_LOGI(LOG_TAG, "Device connected");
+  ESP_LOGI(LOG_TAG, "Device connected, conn_id %d", param->connect.conn_id);
 
-  BLE2902* desc = (BLE2902*)this->inputKeyboard->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(true);
-  desc = (BLE2902*)this->inputMediaKeys->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(true);
+  setNotifications(true);
+
+  // The controller stops advertising on connect, keep pairing open for further hosts
+  if (isAdvertisingMode && activeCount < BLE_MAX_CONNECTIONS) {
+    advertising->start();
+  }
 
   // Callback for external listeners
   if (connectCallback) {
-    connectCallback("Connected");
+    connectCallback(true, param->connect.conn_id);
   }
 }
 
@@ -471,50 +916,6 @@ void BleRemoteControl::onWrite(BLECharacteristic* me) {
   ESP_LOGI(LOG_TAG, "special keys: %d", *value);
 }
 
-void BleRemoteControl::delay_ms(uint64_t ms) {
-  uint64_t m = esp_timer_get_time();
-  if(ms){
-    uint64_t e = (m + (ms * 1000));
-    if(m > e){ //overflow
-        while(esp_timer_get_time() > e) { }
-    }
-    while(esp_timer_get_time() < e) {}
-  }
-}
-
-bool BleRemoteControl::isMediaKey(String key) {
-	key.toLowerCase();
-	for (int i = 0; i < NUM_MEDIA_KEY_MAPPINGS; i++) {
-		if (key.equals(mediaKeyMappings[i].name)) {
-		return true;
-		}
-	}  
-	return false;
-}
-
-uint16_t BleRemoteControl::getMediaKeyCode(String key) {
-	key.toLowerCase();
-	
-	for (int i = 0; i < NUM_MEDIA_KEY_MAPPINGS; i++) {
-	  if (key.equals(mediaKeyMappings[i].name)) {
-		return mediaKeyMappings[i].keyCode;
-	  }
-	}	
-	return 0; // Not found
-}
-
-uint8_t BleRemoteControl::getKeyCode(String key) {
-	key.toLowerCase();
-	
-	for (int i = 0; i < NUM_KEY_MAPPINGS; i++) {
-	  if (key.equals(keyMappings[i].name)) {
-		return keyMappings[i].keyCode;
-	  }
-	}
-	
-	return 0; // Not found
-}
-
 // MAC address management implementation
 bool BleRemoteControl::setMacAddress(uint8_t macAddress[6]) {
   if (!isValidMacAddress(macAddress)) {
@@ -525,6 +926,7 @@ bool BleRemoteControl::setMacAddress(uint8_t macAddress[6]) {
   memcpy(customMacAddress, macAddress, 6);
   useCustomMac = true;
   macAddressSet = false; // Will be set in begin()
+  configVersion++;
   saveConfig(); // Save to NVS
   return true;
 }
@@ -637,17 +1039,20 @@ bool BleRemoteControl::setVendorId(uint16_t vendorId) {
     return false;
   }
   this->vendorId = vendorId;
+  configVersion++;
   return true;
 }
 
 bool BleRemoteControl::setProductId(uint16_t productId) {
   this->productId = productId;
+  configVersion++;
   return true;
 }
 
 bool BleRemoteControl::setVersionId(uint16_t versionId) {
   this->versionId = versionId;
-  Serial.printf("Custom Version ID set to: 0x%04X\n", versionId);
+  configVersion++;
+  DLOG(BLE_VERSION_ID, versionId);
   return true;
 }
 
@@ -656,6 +1061,7 @@ bool BleRemoteControl::setDeviceName(const String& deviceName) {
     return false;
   }
   this->deviceName = deviceName.c_str();
+  configVersion++;
   return true;
 }
 
@@ -664,6 +1070,7 @@ void BleRemoteControl::setInitialBatteryLevel(uint8_t batteryLevel) {
     batteryLevel = 100;
   }
   this->initialBatteryLevel = batteryLevel;
+  configVersion++;
 }
 
 void BleRemoteControl::setManufacturerName(const String& manufacturerName) {
@@ -671,6 +1078,7 @@ void BleRemoteControl::setManufacturerName(const String& manufacturerName) {
     return;
   }
   this->deviceManufacturer = manufacturerName.c_str();
+  configVersion++;
 }
 
 void BleRemoteControl::setCountryCode(uint8_t countryCode) {
@@ -678,32 +1086,27 @@ void BleRemoteControl::setCountryCode(uint8_t countryCode) {
     countryCode = 0x00; // Default to 0 if invalid
   }
   this->countryCode = countryCode;
+  configVersion++;
 }
 
 void BleRemoteControl::setHidFlags(uint8_t hidFlags) {
   this->hidFlags = hidFlags;
+  configVersion++;
 }
 
 void BleRemoteControl::resetConfiguration() {
-  preferences.begin("ble", false);
-  preferences.remove("use_custom_mac");
-  preferences.remove("custom_mac");
-  preferences.remove("vendor_id");
-  preferences.remove("product_id");
-  preferences.remove("version_id");
-  preferences.remove("device_name");
-  preferences.remove("battery_level");
-  preferences.remove("custom_mac");
-  preferences.end();
+  const ConfigKey keys[] = {
+    CONFIG_BLE_CUSTOM_MAC, CONFIG_BLE_VENDOR_ID, CONFIG_BLE_PRODUCT_ID, CONFIG_BLE_VERSION_ID,
+    CONFIG_BLE_DEVICE_NAME, CONFIG_BLE_MANUFACTURER, CONFIG_BLE_COUNTRY_CODE, CONFIG_BLE_HID_FLAGS,
+    CONFIG_BLE_BATTERY_LEVEL, CONFIG_BLE_PROFILE
+  };
+  for (ConfigKey key : keys) {
+    configStore.reset(key);
+  }
+  configStore.commit();
   
   // Reset to defaults
-  useCustomMac = false;
-  vendorId = HID_VENDOR_ID;
-  productId = HID_PRODUCT_ID;
-  versionId = HID_VERSION_ID;
-  deviceName = BLE_DEVICE_NAME;
-  batteryLevel = BLE_INITIAL_BATTERY_LEVEL;
-  memset(customMacAddress, 0, 6);
+  loadConfig();
 }
 
 void BleRemoteControl::printConfiguration() {
@@ -720,6 +1123,9 @@ void BleRemoteControl::printConfiguration() {
 
 bool BleRemoteControl::saveConfiguration() {
   saveConfig();
+  if (configStore.isDirty()) {
+    return false;
+  }
   Serial.println("BLE device configuration saved to preferences");
   return true;
 }
@@ -733,4 +1139,200 @@ bool BleRemoteControl::loadConfiguration() {
   Serial.printf("MAC Address: %s%s\n", getCurrentMacAddressString().c_str());
   Serial.println();
   return true;
-}
\ No newline at end of file
+}
+
+// Writes the identity into the GAP name and the DIS/HID characteristics of the
+// running server. Services cannot be removed from a started Bluedroid GATT
+// server, so the values are replaced instead of rebuilding the server.
+void BleRemoteControl::applyIdentity() {
+  if (hid == nullptr) {
+    return;   // begin() applies the identity
+  }
+  esp_ble_gap_set_device_name(deviceName.c_str());
+  hid->manufacturer()->setValue(deviceManufacturer);
+  hid->pnp(0x02, vendorId, productId, versionId);
+  hid->hidInfo(countryCode, hidFlags);
+}
+
+void BleRemoteControl::requestReprovision(bool clearBonds) {
+  if (clearBonds) {
+    switchClearBonds = true;
+  }
+  switchRequested = true;
+}
+
+// Runs the requested identity switch on the main loop; waiting for the hosts
+// to drop is polled here, so neither the web server nor the loop is blocked.
+void BleRemoteControl::loop() {
+  if (switchRequested.exchange(false)) {
+    startSwitch();
+  }
+  if (switchActive && (!this->connected ||
+      esp_timer_get_time() - switchStartedAt >= (int64_t)BLE_PROFILE_DISCONNECT_WAIT_MS * 1000)) {
+    finishSwitch();
+  }
+}
+
+// Hosts only read the identity while connecting, so they are disconnected and
+// advertising restarts with the new name. Bonded hosts reconnect with the GATT
+// database they cached, without clearBonds they may keep the old identity.
+void BleRemoteControl::startSwitch() {
+  switchStartedAt = esp_timer_get_time();
+  bool wasAdvertising = isAdvertisingMode;
+  if (wasAdvertising) {
+    stopAdvertising();
+  }
+  applyIdentity();
+  if (switchClearBonds.exchange(false)) {
+    removeBonding();   // Also drops the service-changed state of every host
+  }
+
+  if (disconnect(BLE_TARGET_ALL)) {
+    // onDisconnect() restarts advertising, now with the new identity
+    switchActive = true;
+    return;
+  }
+  if (wasAdvertising) {
+    startAdvertising();
+  }
+  finishSwitch();
+}
+
+// The time until the device advertises again as the new remote is kept for
+// diagnostics; the state stream reports the finished switch.
+void BleRemoteControl::finishSwitch() {
+  lastSwitchUs = (uint32_t)(esp_timer_get_time() - switchStartedAt);
+  switchActive = false;
+  profileSwitches++;
+}
+
+// Returns the slot of the named profile (and reads it), or -1
+int BleRemoteControl::findProfile(Preferences& store, const char* name, IdentityProfile* profile) {
+  IdentityProfile candidate;
+  char key[4];
+  for (int slot = 0; slot < BLE_MAX_PROFILES; slot++) {
+    snprintf(key, sizeof(key), "p%d", slot);
+    if (store.getBytesLength(key) == sizeof(IdentityProfile) &&
+        store.getBytes(key, &candidate, sizeof(candidate)) == sizeof(candidate) &&
+        strncmp(candidate.name, name, BLE_PROFILE_NAME_LENGTH) == 0) {
+      if (profile != nullptr) {
+        *profile = candidate;
+      }
+      return slot;
+    }
+  }
+  return -1;
+}
+
+bool BleRemoteControl::saveProfile(const String& name) {
+  if (name.length() == 0 || name.length() >= BLE_PROFILE_NAME_LENGTH) {
+    return false;
+  }
+  IdentityProfile profile = {};
+  strlcpy(profile.name, name.c_str(), sizeof(profile.name));
+  profile.vendorId = vendorId;
+  profile.productId = productId;
+  profile.versionId = versionId;
+  profile.countryCode = countryCode;
+  profile.hidFlags = hidFlags;
+  strlcpy(profile.deviceName, deviceName.c_str(), sizeof(profile.deviceName));
+  strlcpy(profile.manufacturer, deviceManufacturer.c_str(), sizeof(profile.manufacturer));
+
+  Preferences store;
+  store.begin("ble_profiles", false);
+  int slot = findProfile(store, profile.name, nullptr);
+  char key[4];
+  for (int i = 0; slot < 0 && i < BLE_MAX_PROFILES; i++) {
+    snprintf(key, sizeof(key), "p%d", i);
+    if (!store.isKey(key)) {
+      slot = i;
+    }
+  }
+  bool saved = false;
+  if (slot >= 0) {
+    snprintf(key, sizeof(key), "p%d", slot);
+    saved = store.putBytes(key, &profile, sizeof(profile)) == sizeof(profile);
+  }
+  store.end();
+  return saved;
+}
+
+bool BleRemoteControl::deleteProfile(const String& name) {
+  Preferences store;
+  store.begin("ble_profiles", false);
+  int slot = findProfile(store, name.c_str(), nullptr);
+  if (slot >= 0) {
+    char key[4];
+    snprintf(key, sizeof(key), "p%d", slot);
+    store.remove(key);
+  }
+  store.end();
+  return slot >= 0;
+}
+
+size_t BleRemoteControl::getProfiles(IdentityProfile* profiles, size_t maxCount) {
+  Preferences store;
+  store.begin("ble_profiles", true);
+  size_t count = 0;
+  char key[4];
+  for (int slot = 0; slot < BLE_MAX_PROFILES && count < maxCount; slot++) {
+    snprintf(key, sizeof(key), "p%d", slot);
+    if (store.getBytesLength(key) == sizeof(IdentityProfile) &&
+        store.getBytes(key, &profiles[count], sizeof(IdentityProfile)) == sizeof(IdentityProfile)) {
+      count++;
+    }
+  }
+  store.end();
+  return count;
+}
+
+bool BleRemoteControl::activateProfile(const String& name, bool clearBonds) {
+  IdentityProfile profile;
+  Preferences store;
+  store.begin("ble_profiles", true);
+  int slot = findProfile(store, name.c_str(), &profile);
+  store.end();
+  if (slot < 0) {
+    return false;
+  }
+
+  vendorId = profile.vendorId;
+  productId = profile.productId;
+  versionId = profile.versionId;
+  countryCode = profile.countryCode;
+  hidFlags = profile.hidFlags;
+  profile.name[sizeof(profile.name) - 1] = '\0';
+  profile.deviceName[sizeof(profile.deviceName) - 1] = '\0';
+  profile.manufacturer[sizeof(profile.manufacturer) - 1] = '\0';
+  deviceName = profile.deviceName;
+  deviceManufacturer = profile.manufacturer;
+  activeProfile = profile.name;
+  configVersion++;
+  requestReprovision(clearBonds);
+
+  saveConfig();   // The active identity survives a restart
+  return true;
+}
+
+bool BleRemoteControl::setReportDescriptor(const uint8_t* data, size_t length, String& error) {
+  HidReportLayout parsed;
+  if (!HidDescriptorParser::parse(data, length, parsed, error)) {
+    return false;
+  }
+  preferences.begin("ble", false);
+  size_t written = preferences.putBytes("hid_desc", data, length);
+  preferences.end();
+  if (written != length) {
+    error = "Failed to store descriptor";
+    return false;
+  }
+  descriptorPending = length != reportDescriptorLength || memcmp(data, reportDescriptor, length) != 0;
+  return true;
+}
+
+void BleRemoteControl::clearReportDescriptor() {
+  preferences.begin("ble", false);
+  preferences.remove("hid_desc");
+  preferences.end();
+  descriptorPending = customDescriptor;
+}
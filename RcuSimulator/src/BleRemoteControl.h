@@ -14,11 +14,17 @@
 #include <BLECharacteristic.h>
 #include <Preferences.h>
 #include "HIDTypes.h"
+#include "hiddescriptor.h"
 #include <driver/adc.h>
 #include "sdkconfig.h"
 #include "esp_bt.h"
 #include "esp_bt_main.h"
 #include "esp_gap_ble_api.h"
+#include "keymap.h"
+#include "reportqueue.h"
+#include <atomic>
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
 
 // Default device parameters
 #define HID_VENDOR_ID 0x012d                            // Vendor ID 
@@ -44,61 +50,65 @@
 #define MEDIA_KEYS_ID 0x02
 
 // HID Report Descriptor matching the analyzed remote control (a4:c1:38:81:21:05)
-static const uint8_t _hidReportDescriptor[] = {
+constexpr HidDescriptorBuilder remoteDescriptor = HidDescriptorBuilder()
   // Keyboard Report (Report ID 1)
-  USAGE_PAGE(1),      0x01,        // Usage Page (Generic Desktop Ctrls)
-  USAGE(1),           0x06,        // Usage (Keyboard)
-  COLLECTION(1),      0x01,        // Collection (Application)
-  REPORT_ID(1),       0x01,        //   Report ID (1)
-  USAGE_PAGE(1),      0x07,        //   Usage Page (Kbrd/Keypad)
-  USAGE_MINIMUM(1),   0xE0,        //   Usage Minimum (0xE0) - Left Control
-  USAGE_MAXIMUM(1),   0xE7,        //   Usage Maximum (0xE7) - Right GUI
-  LOGICAL_MINIMUM(1), 0x00,        //   Logical Minimum (0)
-  LOGICAL_MAXIMUM(1), 0x01,        //   Logical Maximum (1)
-  REPORT_SIZE(1),     0x01,        //   Report Size (1 bit)
-  REPORT_COUNT(1),    0x08,        //   Report Count (8) - 8 modifier keys
-  HIDINPUT(1),        0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  REPORT_COUNT(1),    0x01,        //   Report Count (1) - 1 reserved byte
-  REPORT_SIZE(1),     0x08,        //   Report Size (8 bits)
-  HIDINPUT(1),        0x03,        //   Input (Const,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  REPORT_COUNT(1),    0x05,        //   Report Count (5) - 5 LED bits
-  REPORT_SIZE(1),     0x01,        //   Report Size (1 bit)
-  USAGE_PAGE(1),      0x08,        //   Usage Page (LEDs)
-  USAGE_MINIMUM(1),   0x01,        //   Usage Minimum (Num Lock)
-  USAGE_MAXIMUM(1),   0x05,        //   Usage Maximum (Kana)
-  HIDOUTPUT(1),       0x02,        //   Output (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-  REPORT_COUNT(1),    0x01,        //   Report Count (1) - 1 padding byte
-  REPORT_SIZE(1),     0x03,        //   Report Size (3 bits)
-  HIDOUTPUT(1),       0x03,        //   Output (Const,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-  REPORT_COUNT(1),    0x06,        //   Report Count (6) - 6 key slots
-  REPORT_SIZE(1),     0x08,        //   Report Size (8 bits)
-  LOGICAL_MINIMUM(1), 0x00,        //   Logical Minimum (0)
-  LOGICAL_MAXIMUM(1), 0xFF,        //   Logical Maximum (255)
-  USAGE_PAGE(1),      0x07,        //   Usage Page (Kbrd/Keypad)
-  USAGE_MINIMUM(1),   0x00,        //   Usage Minimum (0x00)
-  USAGE_MAXIMUM(1),   0xFF,        //   Usage Maximum (0xFF)
-  HIDINPUT(1),        0x00,        //   Input (Data,Array,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  END_COLLECTION(0),               // End Collection
-  
+  .usagePage(HID_PAGE_GENERIC_DESKTOP)
+  .usage(0x06)                            // Keyboard
+  .collection(HID_COLLECTION_APPLICATION)
+  .reportId(KEYBOARD_ID)
+  .usagePage(HID_PAGE_KEYBOARD)
+  .usageMinimum(0xE0)                     //   Left Control
+  .usageMaximum(0xE7)                     //   Right GUI
+  .logicalMinimum(0)
+  .logicalMaximum(1)
+  .reportSize(1)
+  .reportCount(8)                         //   8 modifier keys
+  .input(HID_MAIN_VARIABLE)
+  .reportCount(1)                         //   1 reserved byte
+  .reportSize(8)
+  .input(HID_MAIN_CONSTANT | HID_MAIN_VARIABLE)
+  .reportCount(5)                         //   5 LED bits
+  .reportSize(1)
+  .usagePage(HID_PAGE_LEDS)
+  .usageMinimum(0x01)                     //   Num Lock
+  .usageMaximum(0x05)                     //   Kana
+  .output(HID_MAIN_VARIABLE)
+  .reportCount(1)                         //   LED padding
+  .reportSize(3)
+  .output(HID_MAIN_CONSTANT | HID_MAIN_VARIABLE)
+  .reportCount(6)                         //   6 key slots
+  .reportSize(8)
+  .logicalMinimum(0)
+  .logicalMaximum(255)
+  .usagePage(HID_PAGE_KEYBOARD)
+  .usageMinimum(0x00)
+  .usageMaximum(0xFF)
+  .input(0)                               //   Data,Array
+  .endCollection()
+
   // Consumer Control Report (Report ID 2)
-  USAGE_PAGE(1),      0x0C,        // Usage Page (Consumer)
-  USAGE(1),           0x01,        // Usage (Consumer Control)
-  COLLECTION(1),      0x01,        // Collection (Application)
-  REPORT_ID(1),       0x02,        //   Report ID (2)
-  REPORT_SIZE(1),     0x10,        //   Report Size (16 bits)
-  REPORT_COUNT(1),    0x02,        //   Report Count (2) - 2x 16-bit consumer codes
-  LOGICAL_MINIMUM(1), 0x01,        //   Logical Minimum (1)
-  LOGICAL_MAXIMUM(2), 0xFF, 0x03,  //   Logical Maximum (1023)
-  USAGE_MINIMUM(1),   0x01,        //   Usage Minimum (0x01)
-  USAGE_MAXIMUM(2),   0xFF, 0x03,  //   Usage Maximum (0x3FF)
-  HIDINPUT(1),        0x60,        //   Input (Data,Array,Abs,No Wrap,Linear,Preferred State,Null State)
-  REPORT_COUNT(1),    0x01,        //   Report Count (1) - 1 padding byte
-  REPORT_SIZE(1),     0x08,        //   Report Size (8 bits)
-  LOGICAL_MINIMUM(1), 0x00,        //   Logical Minimum (0)
-  LOGICAL_MAXIMUM(1), 0xFF,        //   Logical Maximum (255)
-  HIDINPUT(1),        0x03,        //   Input (Const,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  END_COLLECTION(0),               // End Collection
-};
+  .usagePage(HID_PAGE_CONSUMER)
+  .usage(0x01)                            // Consumer Control
+  .collection(HID_COLLECTION_APPLICATION)
+  .reportId(MEDIA_KEYS_ID)
+  .reportSize(16)
+  .reportCount(2)                         //   2x 16-bit consumer codes
+  .logicalMinimum(1)
+  .logicalMaximum(0x3FF)
+  .usageMinimum(0x01)
+  .usageMaximum(0x3FF)
+  .input(HID_MAIN_PREFERRED | HID_MAIN_NULL_STATE)   //   Data,Array,No Preferred,Null State
+  .reportCount(1)                         //   1 padding byte
+  .reportSize(8)
+  .logicalMinimum(0)
+  .logicalMaximum(255)
+  .input(HID_MAIN_CONSTANT | HID_MAIN_VARIABLE)
+  .endCollection();
+
+static_assert(remoteDescriptor.isValid(), "Built-in report descriptor is malformed");
+
+static constexpr std::array<uint8_t, remoteDescriptor.length()> _hidReportDescriptor =
+    remoteDescriptor.bytes<remoteDescriptor.length()>();
 
 /**
  * @brief Keyboard report map.
@@ -107,90 +117,6 @@ static const uint8_t _hidReportDescriptor[] = {
  * https://www.usb.org/sites/default/files/documents/hid1_11.pdf
  */
 
-//  Keyboard
-#define KEY_LEFT_CTRL     0x80
-#define KEY_LEFT_SHIFT    0x81
-#define KEY_LEFT_ALT      0x82
-#define KEY_LEFT_GUI      0x83
-#define KEY_RIGHT_CTRL    0x84
-#define KEY_RIGHT_SHIFT   0x85
-#define KEY_RIGHT_ALT     0x86
-#define KEY_RIGHT_GUI     0x87
-
-#define KEY_UP_ARROW      0xDA
-#define KEY_DOWN_ARROW    0xD9
-#define KEY_LEFT_ARROW    0xD8
-#define KEY_RIGHT_ARROW   0xD7
-#define KEY_BACKSPACE     0xB2
-#define KEY_TAB           0xB3
-#define KEY_RETURN        0xB0
-#define KEY_ESC           0xB1
-#define KEY_INSERT        0xD1
-#define KEY_DELETE        0xD4
-#define KEY_PAGE_UP       0xD3
-#define KEY_PAGE_DOWN     0xD6
-#define KEY_HOME          0xD2
-#define KEY_END           0xD5
-#define KEY_CAPS_LOCK     0xC1
-#define KEY_F1            0xC2
-#define KEY_F2            0xC3
-#define KEY_F3            0xC4
-#define KEY_F4            0xC5
-#define KEY_F5            0xC6
-#define KEY_F6            0xC7
-#define KEY_F7            0xC8
-#define KEY_F8            0xC9
-#define KEY_F9            0xCA
-#define KEY_F10           0xCB
-#define KEY_F11           0xCC
-#define KEY_F12           0xCD
-#define KEY_F13           0xF0
-#define KEY_F14           0xF1
-#define KEY_F15           0xF2
-#define KEY_F16           0xF3
-#define KEY_F17           0xF4
-#define KEY_F18           0xF5
-#define KEY_F19           0xF6
-#define KEY_F20           0xF7
-#define KEY_F21           0xF8
-#define KEY_F22           0xF9
-#define KEY_F23           0xFA
-#define KEY_F24           0xFB
-#define KEY_PRINT_SCREEN  0xCE
-#define KEY_SCROLL_LOCK   0xCF
-#define KEY_PAUSE         0xD0
-
- 
-// Consumer Control Keys (updated to match analyzed descriptor)
-// Values must be within 1-1023 range as per descriptor
-#define KEY_MEDIA_PROGRAM           0x0007
-#define KEY_MEDIA_PREVIOUS_CHANNEL  0x0201
-#define KEY_MEDIA_MUTE              0x00E2
-#define KEY_MEDIA_VOL_UP            0x00E9
-#define KEY_MEDIA_VOL_DOWN          0x00EA
-#define KEY_MEDIA_PLAY_PAUSE        0x00CD
-#define KEY_MEDIA_NEXT              0x00B5
-#define KEY_MEDIA_PREVIOUS          0x00B6
-#define KEY_MEDIA_STOP              0x00B7
-#define KEY_MEDIA_FAST_FORWARD      0x00B3
-#define KEY_MEDIA_REWIND            0x00B4
-#define KEY_MEDIA_RECORD            0x00B2
-#define KEY_MEDIA_MENU              0x0040
-#define KEY_MEDIA_HOME              0x0223
-#define KEY_MEDIA_BACK              0x0224
-#define KEY_MEDIA_OK                0x0041
-#define KEY_MEDIA_UP                0x0042
-#define KEY_MEDIA_DOWN              0x0043
-#define KEY_MEDIA_LEFT              0x0044
-#define KEY_MEDIA_RIGHT             0x0045
-#define KEY_MEDIA_CHANNEL_UP        0x009C
-#define KEY_MEDIA_CHANNEL_DOWN      0x009D
-#define KEY_MEDIA_POWER             0x0030
-#define KEY_MEDIA_TV                0x001C
-#define KEY_MEDIA_ASSISTANT         0x0221
-#define KEY_MEDIA_APP_NETFLIX       0x000A
-#define KEY_MEDIA_APP_WAIPUTHEK     0x00D2
-
 //  Low level key report: up to 6 keys and shift, ctrl etc at once
 typedef struct
 {
@@ -200,97 +126,87 @@ typedef struct
 } KeyReport;
 
 //  Media key report: Updated to match analyzed descriptor (5 bytes total)
-typedef struct
+typedef struct __attribute__((packed))
 {
   uint16_t consumer1;  // First 16-bit consumer code
   uint16_t consumer2;  // Second 16-bit consumer code  
   uint8_t padding;     // Padding byte (constant)
 } MediaKeyReport;
 
-// Structure for key mapping
-struct KeyMapping {
-  const char* name;
-  uint8_t keyCode;
-};
+// The structs are sent as they are with the built-in descriptor
+static_assert(sizeof(KeyReport) * 8 == remoteDescriptor.inputBits(KEYBOARD_ID), "KeyReport does not match the descriptor");
+static_assert(offsetof(KeyReport, keys) * 8 == remoteDescriptor.inputOffset(KEYBOARD_ID, 2), "KeyReport keys offset does not match the descriptor");
+static_assert(sizeof(MediaKeyReport) * 8 == remoteDescriptor.inputBits(MEDIA_KEYS_ID), "MediaKeyReport does not match the descriptor");
+static_assert(remoteDescriptor.inputBits(KEYBOARD_ID) <= HID_REPORT_MAX_LENGTH * 8 &&
+              remoteDescriptor.inputBits(MEDIA_KEYS_ID) <= HID_REPORT_MAX_LENGTH * 8, "Report longer than a TX queue slot");
+
+#define REPORT_QUEUE_CAPACITY 16
+
+// Queued reports are already packed to the layout of the active descriptor
+typedef ReportQueue<HID_REPORT_MAX_LENGTH, REPORT_QUEUE_CAPACITY> KeyReportQueue;
+typedef ReportQueue<HID_REPORT_MAX_LENGTH, REPORT_QUEUE_CAPACITY> MediaReportQueue;
 
-// Structure for media key mapping
-struct MediaKeyMapping {
-  const char* name;
-  uint16_t keyCode;  // Using uint16_t for media keys
+#define BLE_MAX_CONNECTIONS 3      // Hosts served in parallel, CONFIG_BT_ACL_CONNECTIONS must be at least this
+#define BLE_TARGET_ALL 0xFF        // Target value for "send to every connected host"
+
+class KeyRecorder;
+
+// State of one connected host, keyed by the GATT conn_id
+struct HostConnection {
+  bool active = false;
+  uint16_t connId = 0;
+  esp_bd_addr_t address = {};
+  bool keyboardSubscribed = false;   // CCCD of this host, not the shared BLE2902 value
+  bool mediaSubscribed = false;
+  KeyReport keyReport = {};          // Keys currently held on this host
+  MediaKeyReport mediaReport = {};
+  KeyReportQueue keyTxQueue;
+  MediaReportQueue mediaTxQueue;
+  uint16_t interval = 0;             // Negotiated connection interval in 1.25 ms units
+  uint16_t latency = 0;              // Peripheral latency in connection events
+  uint16_t timeout = 0;              // Supervision timeout in 10 ms units
+  uint32_t paramUpdates = 0;         // Completed connection parameter updates
 };
 
-// Mapping from string names to regular keycodes
-const KeyMapping keyMappings[] = {
-  {"up", KEY_UP_ARROW},
-  {"down", KEY_DOWN_ARROW},
-  {"left", KEY_LEFT_ARROW},
-  {"right", KEY_RIGHT_ARROW},
-  {"enter", KEY_RETURN},
-  {"return", KEY_RETURN},
-  {"esc", KEY_ESC},
-  {"escape", KEY_ESC},
-  {"backspace", KEY_BACKSPACE},
-  {"tab", KEY_TAB},
-  {"space", ' '},
-  {"ctrl", KEY_LEFT_CTRL},
-  {"alt", KEY_LEFT_ALT},
-  {"shift", KEY_LEFT_SHIFT},
-  {"win", KEY_LEFT_GUI},
-  {"gui", KEY_LEFT_GUI},
-  {"insert", KEY_INSERT},
-  {"delete", KEY_DELETE},
-  {"del", KEY_DELETE},
-  {"home", KEY_HOME},
-  {"end", KEY_END},
-  {"pageup", KEY_PAGE_UP},
-  {"pagedown", KEY_PAGE_DOWN},
-  {"capslock", KEY_CAPS_LOCK},
-  {"f1", KEY_F1},
-  {"f2", KEY_F2},
-  {"f3", KEY_F3},
-  {"f4", KEY_F4},
-  {"f5", KEY_F5},
-  {"f6", KEY_F6},
-  {"f7", KEY_F7},
-  {"f8", KEY_F8},
-  {"f9", KEY_F9},
-  {"f10", KEY_F10},
-  {"f11", KEY_F11},
-  {"f12", KEY_F12},
-  {"printscreen", KEY_PRINT_SCREEN},
-  {"scrolllock", KEY_SCROLL_LOCK},
-  {"pause", KEY_PAUSE}
+// Limits of the Bluetooth Core Specification for connection parameters
+#define BLE_CONN_INTERVAL_MIN 6        // 7.5 ms
+#define BLE_CONN_INTERVAL_MAX 3200     // 4 s
+#define BLE_CONN_LATENCY_MAX 499
+#define BLE_CONN_TIMEOUT_MIN 10        // 100 ms
+#define BLE_CONN_TIMEOUT_MAX 3200      // 32 s
+
+// Added to one connection interval for the adaptive hold time: covers the
+// controller picking up the report and the sleep clock drift of both sides
+#define BLE_HOLD_MARGIN_US 1500
+
+#define BLE_MAX_PROFILES 8
+#define BLE_PROFILE_NAME_LENGTH 16            // Including the terminator
+#define BLE_PROFILE_DISCONNECT_WAIT_MS 1000   // Max. wait for the hosts to drop before re-advertising
+
+// Identity of one remote model, stored as blob "p<slot>" in the "ble_profiles" namespace
+struct IdentityProfile {
+  char name[BLE_PROFILE_NAME_LENGTH];
+  uint16_t vendorId;
+  uint16_t productId;
+  uint16_t versionId;
+  uint8_t countryCode;
+  uint8_t hidFlags;
+  char deviceName[65];
+  char manufacturer[65];
 };
 
-// Mapping from string names to media keycodes (updated for analyzed descriptor)
-const MediaKeyMapping mediaKeyMappings[] = {
-  {"program", KEY_MEDIA_PROGRAM},
-  {"chprev", KEY_MEDIA_PREVIOUS_CHANNEL},
-  {"power", KEY_MEDIA_POWER},
-  {"tv", KEY_MEDIA_TV},
-  {"menu", KEY_MEDIA_MENU},
-  {"ok", KEY_MEDIA_OK},
-  {"mkup", KEY_MEDIA_UP},
-  {"mkdown", KEY_MEDIA_DOWN},
-  {"mkleft", KEY_MEDIA_LEFT},
-  {"mkright", KEY_MEDIA_RIGHT},
-  {"chup", KEY_MEDIA_CHANNEL_UP},
-  {"chdown", KEY_MEDIA_CHANNEL_DOWN},
-  {"rewind", KEY_MEDIA_REWIND},
-  {"record", KEY_MEDIA_RECORD},
-  {"ff", KEY_MEDIA_FAST_FORWARD},
-  {"next", KEY_MEDIA_NEXT},
-  {"previous", KEY_MEDIA_PREVIOUS},
-  {"playpause", KEY_MEDIA_PLAY_PAUSE},
-  {"stop", KEY_MEDIA_STOP},
-  {"assistant", KEY_MEDIA_ASSISTANT},
-  {"back", KEY_MEDIA_BACK},
-  {"home", KEY_MEDIA_HOME},
-  {"volup", KEY_MEDIA_VOL_UP},
-  {"voldown", KEY_MEDIA_VOL_DOWN},
-  {"mute", KEY_MEDIA_MUTE},
-  {"netflix", KEY_MEDIA_APP_NETFLIX},
-  {"waiputhek", KEY_MEDIA_APP_WAIPUTHEK}
+// Copy of a connection's state for diagnostics
+struct HostConnectionInfo {
+  uint16_t connId;
+  String address;
+  bool keyboardSubscribed;
+  bool mediaSubscribed;
+  ReportQueueStats keyTx;
+  ReportQueueStats mediaTx;
+  uint16_t interval;
+  uint16_t latency;
+  uint16_t timeout;
+  uint32_t paramUpdates;
 };
 
 #define SHIFT 0x80
@@ -427,25 +343,33 @@ const uint8_t _asciimap[128] =
 	0				// DEL
 } PROGMEM;
 
-const int NUM_KEY_MAPPINGS = sizeof(keyMappings) / sizeof(KeyMapping);
-const int NUM_MEDIA_KEY_MAPPINGS = sizeof(mediaKeyMappings) / sizeof(MediaKeyMapping);
-
 
 class BleRemoteControl : public BLEServerCallbacks, public BLECharacteristicCallbacks
 {
 private:
   BLEHIDDevice* hid;
-  BLECharacteristic* inputKeyboard;
-  BLECharacteristic* outputKeyboard;
-  BLECharacteristic* inputMediaKeys;
+  BLECharacteristic* inputKeyboard = nullptr;    // nullptr if the descriptor has no such report
+  BLECharacteristic* outputKeyboard = nullptr;
+  BLECharacteristic* inputMediaKeys = nullptr;
   BLEAdvertising*    advertising;
-  KeyReport      _keyReport;
-  MediaKeyReport _mediaKeyReport;
-  bool connected = false;
+  bool connected = false;            // At least one host connected
+  uint32_t connectCount = 0;
   bool isAdvertisingMode = false;
   uint32_t _delay_ms = 7;
   BLEServer* pServer = nullptr;
   Preferences preferences;
+
+  // Connected hosts, each with its own report state and TX queues. The
+  // array is guarded by txMutex; queues drain whenever a link is not congested.
+  HostConnection connections[BLE_MAX_CONNECTIONS];
+  SemaphoreHandle_t txMutex = nullptr;
+  std::atomic<bool> drainRequested{false};
+  esp_gatt_if_t gattsIf = ESP_GATT_IF_NONE;
+  uint16_t keyboardCccdHandle = 0;
+  uint16_t mediaCccdHandle = 0;
+  int64_t lastReportQueuedAt = 0;   // esp_timer timestamps for latency tracing
+  int64_t lastNotifiedAt = 0;
+  static BleRemoteControl* instance;
   
   // Device configuration storage
   uint16_t vendorId = HID_VENDOR_ID;
@@ -457,29 +381,55 @@ private:
   std::string deviceManufacturer = BLE_MANUFACTURER_NAME;
   uint8_t initialBatteryLevel = BLE_INITIAL_BATTERY_LEVEL;
   uint8_t batteryLevel = BLE_INITIAL_BATTERY_LEVEL;
+  std::string activeProfile;        // Name of the last activated identity profile
+  std::atomic<uint32_t> configVersion{0};   // Incremented by every change of the values above
+  uint32_t lastSwitchUs = 0;
+  std::atomic<uint32_t> profileSwitches{0};
+  // Identity switch requested by the web server or CLI, run by loop()
+  std::atomic<bool> switchRequested{false};
+  std::atomic<bool> switchClearBonds{false};
+  std::atomic<bool> switchActive{false};   // Waiting for the hosts to drop
+  int64_t switchStartedAt = 0;
+
+  // Report descriptor the GATT server was started with and its derived layout.
+  // An uploaded descriptor is stored as "hid_desc" and used from the next start.
+  uint8_t reportDescriptor[HID_DESCRIPTOR_MAX_LENGTH];
+  size_t reportDescriptorLength = 0;
+  bool customDescriptor = false;
+  bool descriptorPending = false;   // Stored descriptor differs from the active one
+  HidReportLayout layout = {};
+
+  KeyRecorder* recorder = nullptr;  // Gets every report that was queued for a host
   
   // MAC address management
   uint8_t customMacAddress[6];
   bool useCustomMac = false;
   bool macAddressSet = false;
   
-  // Callback function for connection events
-  typedef std::function<void(String)> ConnectionCallback;
+  // Callback function for connection events, called on the BLE task
+  typedef std::function<void(bool connected, uint16_t connId)> ConnectionCallback;
   ConnectionCallback connectCallback = nullptr;
 
-  bool isMediaKey(String key);
-  uint16_t getMediaKeyCode(String key);
-  uint8_t getKeyCode(String key);
-  size_t press(uint8_t k);
-  size_t press(const MediaKeyReport k);
-  size_t release(uint8_t k);
-  size_t release(const MediaKeyReport k);
-  void sendKeyReport(KeyReport* keys);
-  void sendMediaReport(MediaKeyReport* keys);
-  void sendMediaReport(uint16_t key);
-  void sendMediaReport(uint16_t key1, uint16_t key2);
-  size_t press(String key);  size_t release(String key);
-  void delay_ms(uint64_t ms);
+  size_t press(uint8_t k, uint8_t target);
+  size_t release(uint8_t k, uint8_t target);
+  void setNotifications(bool enabled);
+  bool pushKeyReport(HostConnection& conn, const KeyReport& report);
+  bool pushMediaReport(HostConnection& conn, const MediaKeyReport& report);
+  bool sendMediaReport(uint16_t key1, uint16_t key2, uint8_t target);
+  template <typename Update> size_t updateTargets(uint8_t target, Update update);
+  HostConnection* findConnection(uint16_t connId);
+  static bool translateKey(uint8_t& k, uint8_t& modifiers);
+  void drainTxQueues(TickType_t wait);
+  template <typename Queue> bool drainTxQueue(HostConnection& conn, Queue& queue, BLECharacteristic* characteristic,
+                                              bool subscribed, size_t length);
+  static void deferredDrain(void* self, uint32_t unused);
+  static void handleGattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t* param);
+  static void handleGapEvent(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+  void applyIdentity();
+  void startSwitch();
+  void finishSwitch();
+  int findProfile(Preferences& store, const char* name, IdentityProfile* profile);
+  void loadReportDescriptor();
   void loadConfig(); // Load device configuration from preferences
   void saveConfig(); // Save device configuration to preferences
   
@@ -497,15 +447,39 @@ public:
   bool isAdvertising(void) { return this->isAdvertisingMode; } // Method to check if advertising
   bool removeBonding();   // Method to remove all pairings and bondings
 
-  bool disconnect();      // Method to actively disconnect the connection
-  bool isConnected(void) { return this->connected; } // Method to check if connected
+  bool disconnect(uint8_t target = BLE_TARGET_ALL);  // Actively disconnect one host or all of them
+  bool isConnected(void) { return this->connected; } // Method to check if any host is connected
+  bool isConnected(uint8_t target);                  // Host with this conn_id connected (or any for BLE_TARGET_ALL)
+  size_t getConnections(HostConnectionInfo* infos, size_t maxCount);
+
+  // Asks the central of each target connection for new parameters (1.25 ms /
+  // 10 ms units). The negotiated values arrive later through the GAP event.
+  esp_err_t requestConnParams(uint8_t target, uint16_t minInterval, uint16_t maxInterval,
+                              uint16_t latency, uint16_t timeout);
+  static bool isValidConnParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout);
 
-  bool sendKey(String k, uint32_t delay_ms = 0);
-  bool sendMediaKeyHex(String k, uint8_t position, uint32_t delay_ms);
-  bool sendMediaKey(uint16_t first, uint16_t second, uint32_t delay_ms);
-  bool sendPress(String key);
-  bool sendRelease(String key);
-  void releaseAll(void);
+  // Shortest hold that puts the release into a later connection event than the
+  // press, for the slowest of the target connections (0 if none is connected)
+  uint32_t getMinHoldUs(uint8_t target = BLE_TARGET_ALL);
+  static uint32_t minHoldForInterval(uint16_t interval) { return (uint32_t)interval * 1250 + BLE_HOLD_MARGIN_US; }
+
+  // Report TX queue state, statistics are summed over all connections
+  bool isTxQueueFull(uint8_t target = BLE_TARGET_ALL);
+  ReportQueueStats getKeyTxStats();
+  ReportQueueStats getMediaTxStats();
+  void getTxTimestamps(int64_t& reportQueuedAt, int64_t& notifiedAt);
+
+  // All send methods take a conn_id as target, or BLE_TARGET_ALL to broadcast.
+  // They return true if at least one host accepted the report. Timed taps
+  // (press, hold, release) are the key scheduler's job, it is the only writer.
+  bool sendMediaPress(uint16_t first, uint16_t second = 0, uint8_t target = BLE_TARGET_ALL);
+  bool sendMediaRelease(uint8_t target = BLE_TARGET_ALL);
+  bool sendPress(KeyId key, uint8_t target = BLE_TARGET_ALL);
+  bool sendPress(const String& key) { return sendPress(resolveKeyName(key.c_str(), key.length())); }
+  bool sendRelease(KeyId key, uint8_t target = BLE_TARGET_ALL);
+  bool sendRelease(const String& key) { return sendRelease(resolveKeyName(key.c_str(), key.length())); }
+  bool sendKeyReport(const KeyReport& report, uint8_t target = BLE_TARGET_ALL);   // Replaces the held keys
+  void releaseAll(uint8_t target = BLE_TARGET_ALL);
 
 
   // MAC address management methods
@@ -537,7 +511,40 @@ public:
   String getManufacturerName() const { return deviceManufacturer.c_str(); }
   uint8_t getInitialBatteryLevel(void) { return this->initialBatteryLevel; }
   uint8_t getBatteryLevel(void) { return this->batteryLevel; }
+  uint32_t getConnectCount(void) const { return this->connectCount; }
   
+  // Identity profiles: named sets of VID/PID/version, names, country code and
+  // HID flags. Activating one re-provisions the running HID server in place.
+  bool saveProfile(const String& name);        // Stores the current identity under name
+  bool deleteProfile(const String& name);
+  size_t getProfiles(IdentityProfile* profiles, size_t maxCount);
+  // The switch itself runs later on the main loop, see requestReprovision().
+  bool activateProfile(const String& name, bool clearBonds = false);
+  // Applies the current identity from loop() and returns at once. clearBonds
+  // removes all bonds first, so hosts rediscover the services on reconnect.
+  void requestReprovision(bool clearBonds = false);
+  void loop();
+  bool isSwitching() const { return switchRequested.load() || switchActive.load(); }
+  String getActiveProfile() const { return activeProfile.c_str(); }
+  uint32_t getConfigVersion() const { return configVersion.load(); }
+  uint32_t getLastSwitchUs() const { return lastSwitchUs; }
+  uint32_t getProfileSwitches() const { return profileSwitches.load(); }
+
+  // HID report descriptor: an uploaded descriptor is validated, stored and
+  // takes effect on the next restart, the report characteristics are only
+  // created when the GATT server starts.
+  bool setReportDescriptor(const uint8_t* data, size_t length, String& error);
+  void clearReportDescriptor();                // Back to the built-in descriptor after restart
+  const uint8_t* getReportDescriptor(size_t& length) const { length = reportDescriptorLength; return reportDescriptor; }
+  const HidReportLayout& getReportLayout() const { return layout; }
+  bool isCustomDescriptor() const { return customDescriptor; }
+  bool isDescriptorPending() const { return descriptorPending; }
+
+  void setConnectionCallback(ConnectionCallback callback) { connectCallback = callback; }
+
+  // Session recording, nullptr disables it
+  void setRecorder(KeyRecorder* keyRecorder) { recorder = keyRecorder; }
+
   // Configuration management
   bool saveConfiguration();
   bool loadConfiguration();
@@ -553,8 +560,8 @@ public:
 
 protected:
   virtual void onStarted(BLEServer *pServer) { };
-  virtual void onConnect(BLEServer* pServer);
-  virtual void onDisconnect(BLEServer* pServer);
+  virtual void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param);
+  virtual void onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param);
   virtual void onWrite(BLECharacteristic* me);
 };
 
@@ -0,0 +1,262 @@
+#include "configstore.h"
+#include "BleRemoteControl.h"   // Default device parameters
+#include "heapmonitor.h"        // Default heap alarm thresholds
+
+static const ConfigField configFields[] = {
+#define CONFIG_FIELD_ENTRY(id, space, key, type, number, text) {space, key, CONFIG_TYPE_##type, (uint32_t)(number), text},
+  CONFIG_FIELDS(CONFIG_FIELD_ENTRY)
+#undef CONFIG_FIELD_ENTRY
+};
+
+bool ConfigStore::begin() {
+  static_assert(sizeof(configFields) / sizeof(configFields[0]) == CONFIG_KEY_COUNT, "Field table out of sync");
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == nullptr) {
+      return false;
+    }
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  // Fields are grouped by namespace, open each one once
+  Preferences prefs;
+  const char* openSpace = nullptr;
+  for (uint8_t i = 0; i < CONFIG_KEY_COUNT; i++) {
+    if (openSpace == nullptr || strcmp(openSpace, configFields[i].space) != 0) {
+      if (openSpace != nullptr) {
+        prefs.end();
+      }
+      openSpace = configFields[i].space;
+      prefs.begin(openSpace, true);
+    }
+    load(prefs, (ConfigKey)i);
+  }
+  if (openSpace != nullptr) {
+    prefs.end();
+  }
+  dirty = 0;
+  removals = 0;
+
+  prefs.begin(CONFIG_SCHEMA_NAMESPACE, true);
+  schemaVersion = prefs.getUShort("schema", 0);
+  prefs.end();
+  if (schemaVersion < CONFIG_SCHEMA_VERSION) {
+    migrate(schemaVersion);
+  }
+  loaded = true;
+
+  xSemaphoreGive(mutex);
+  return true;
+}
+
+void ConfigStore::load(Preferences& prefs, ConfigKey key) {
+  const ConfigField& field = configFields[key];
+  ConfigValue& value = values[key];
+  setDefault(key);
+  value.stored = prefs.isKey(field.key);
+  if (!value.stored) {
+    return;
+  }
+  switch (field.type) {
+    case CONFIG_TYPE_U8:
+      value.number = prefs.getUChar(field.key, field.defaultNumber);
+      break;
+    case CONFIG_TYPE_U16:
+      value.number = prefs.getUShort(field.key, field.defaultNumber);
+      break;
+    case CONFIG_TYPE_U32:
+      value.number = prefs.getUInt(field.key, field.defaultNumber);
+      break;
+    case CONFIG_TYPE_BOOL:
+      value.number = prefs.getBool(field.key, field.defaultNumber != 0) ? 1 : 0;
+      break;
+    case CONFIG_TYPE_STRING:
+      value.text = prefs.getString(field.key, field.defaultText);
+      break;
+    case CONFIG_TYPE_BYTES:
+      value.length = prefs.getBytes(field.key, value.bytes, sizeof(value.bytes));
+      break;
+  }
+}
+
+void ConfigStore::setDefault(ConfigKey key) {
+  const ConfigField& field = configFields[key];
+  ConfigValue& value = values[key];
+  value.number = field.defaultNumber;
+  value.text = field.defaultText != nullptr ? field.defaultText : "";
+  value.length = 0;
+}
+
+// Steps from older schema versions, each one runs in order
+void ConfigStore::migrate(uint16_t from) {
+  Preferences prefs;
+  if (from < 1) {
+    // Keys the old resetConfiguration() removed but nothing ever read
+    prefs.begin("ble", false);
+    prefs.remove("battery_level");
+    prefs.remove("use_custom_mac");
+    prefs.end();
+  }
+
+  prefs.begin(CONFIG_SCHEMA_NAMESPACE, false);
+  prefs.putUShort("schema", CONFIG_SCHEMA_VERSION);
+  prefs.end();
+  Serial.printf("Config schema migrated from %u to %u\n", from, CONFIG_SCHEMA_VERSION);
+  schemaVersion = CONFIG_SCHEMA_VERSION;
+}
+
+uint32_t ConfigStore::getNumber(ConfigKey key) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint32_t number = values[key].number;
+  xSemaphoreGive(mutex);
+  return number;
+}
+
+String ConfigStore::getString(ConfigKey key) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  String text = values[key].text;
+  xSemaphoreGive(mutex);
+  return text;
+}
+
+size_t ConfigStore::getBytes(ConfigKey key, uint8_t* out, size_t maxLength) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  size_t length = values[key].length <= maxLength ? values[key].length : 0;
+  memcpy(out, values[key].bytes, length);
+  xSemaphoreGive(mutex);
+  return length;
+}
+
+bool ConfigStore::isStored(ConfigKey key) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool stored = values[key].stored;
+  xSemaphoreGive(mutex);
+  return stored;
+}
+
+void ConfigStore::setNumber(ConfigKey key, uint32_t value) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (values[key].number != value || !values[key].stored) {
+    values[key].number = value;
+    dirty |= 1UL << key;
+    removals &= ~(1UL << key);
+  }
+  xSemaphoreGive(mutex);
+}
+
+void ConfigStore::setString(ConfigKey key, const String& value) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (values[key].text != value || !values[key].stored) {
+    values[key].text = value;
+    dirty |= 1UL << key;
+    removals &= ~(1UL << key);
+  }
+  xSemaphoreGive(mutex);
+}
+
+void ConfigStore::setBytes(ConfigKey key, const uint8_t* data, size_t length) {
+  if (length > CONFIG_BYTES_MAX) {
+    return;
+  }
+  if (length == 0) {
+    reset(key);
+    return;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  ConfigValue& value = values[key];
+  if (value.length != length || memcmp(value.bytes, data, length) != 0 || !value.stored) {
+    memcpy(value.bytes, data, length);
+    value.length = length;
+    dirty |= 1UL << key;
+    removals &= ~(1UL << key);
+  }
+  xSemaphoreGive(mutex);
+}
+
+void ConfigStore::reset(ConfigKey key) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  setDefault(key);
+  if (values[key].stored) {
+    dirty |= 1UL << key;
+    removals |= 1UL << key;
+  } else {
+    dirty &= ~(1UL << key);
+  }
+  xSemaphoreGive(mutex);
+}
+
+bool ConfigStore::commit() {
+  if (!loaded) {
+    return false;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool ok = commitLocked();
+  xSemaphoreGive(mutex);
+  return ok;
+}
+
+bool ConfigStore::commitLocked() {
+  if (dirty == 0) {
+    return true;
+  }
+  bool ok = true;
+  Preferences prefs;
+  uint32_t pending = dirty;
+  while (pending != 0) {
+    // All dirty fields of the namespace of the first pending field
+    const char* space = configFields[__builtin_ctz(pending)].space;
+    prefs.begin(space, false);
+    for (uint8_t i = 0; i < CONFIG_KEY_COUNT; i++) {
+      if ((pending & (1UL << i)) == 0 || strcmp(configFields[i].space, space) != 0) {
+        continue;
+      }
+      pending &= ~(1UL << i);
+      if (write(prefs, (ConfigKey)i)) {
+        dirty &= ~(1UL << i);
+        removals &= ~(1UL << i);
+        writes++;
+      } else {
+        ok = false;   // Stays dirty, retried on the next commit
+      }
+    }
+    prefs.end();
+  }
+  commits++;
+  return ok;
+}
+
+bool ConfigStore::write(Preferences& prefs, ConfigKey key) {
+  const ConfigField& field = configFields[key];
+  ConfigValue& value = values[key];
+  if (removals & (1UL << key)) {
+    bool removed = prefs.remove(field.key);
+    value.stored = !removed;
+    return removed;
+  }
+  size_t written = 0;
+  switch (field.type) {
+    case CONFIG_TYPE_U8:
+      written = prefs.putUChar(field.key, value.number);
+      break;
+    case CONFIG_TYPE_U16:
+      written = prefs.putUShort(field.key, value.number);
+      break;
+    case CONFIG_TYPE_U32:
+      written = prefs.putUInt(field.key, value.number);
+      break;
+    case CONFIG_TYPE_BOOL:
+      written = prefs.putBool(field.key, value.number != 0);
+      break;
+    case CONFIG_TYPE_STRING:
+      // An empty string is stored as empty, not as missing key
+      written = prefs.putString(field.key, value.text) > 0 || value.text.isEmpty() ? 1 : 0;
+      break;
+    case CONFIG_TYPE_BYTES:
+      written = prefs.putBytes(field.key, value.bytes, value.length);
+      break;
+  }
+  if (written > 0) {
+    value.stored = true;
+  }
+  return written > 0;
+}
@@ -0,0 +1,124 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define CONFIG_SCHEMA_VERSION 1
+#define CONFIG_SCHEMA_NAMESPACE "rcu-config"
+#define CONFIG_BYTES_MAX 8             // Largest BYTES field (custom MAC)
+
+// X(id, namespace, key, type, number default, text default)
+// Namespaces and keys are the ones earlier firmware wrote, so existing
+// settings are picked up. The defaults are only expanded in configstore.cpp.
+#define CONFIG_FIELDS(X)                                                                          \
+  X(BLE_CUSTOM_MAC,      "ble",        "custom_mac",            BYTES,  0, nullptr)               \
+  X(BLE_VENDOR_ID,       "ble",        "vendor_id",             U16,    HID_VENDOR_ID, nullptr)   \
+  X(BLE_PRODUCT_ID,      "ble",        "product_id",            U16,    HID_PRODUCT_ID, nullptr)  \
+  X(BLE_VERSION_ID,      "ble",        "version_id",            U16,    HID_VERSION_ID, nullptr)  \
+  X(BLE_DEVICE_NAME,     "ble",        "device_name",           STRING, 0, BLE_DEVICE_NAME)       \
+  X(BLE_MANUFACTURER,    "ble",        "manufacturer_name",     STRING, 0, BLE_MANUFACTURER_NAME) \
+  X(BLE_COUNTRY_CODE,    "ble",        "country_code",          U8,     HID_COUNTRY_CODE, nullptr) \
+  X(BLE_HID_FLAGS,       "ble",        "hid_flags",             U8,     HID_FLAGS, nullptr)       \
+  X(BLE_BATTERY_LEVEL,   "ble",        "initial_battery_level", U8,     BLE_INITIAL_BATTERY_LEVEL, nullptr) \
+  X(BLE_PROFILE,         "ble",        "profile",               STRING, 0, "")                    \
+  X(WEB_AUTH_TOKEN,      "webserver",  "auth_token",            STRING, 0, "")                    \
+  X(WIFI_SSID,           "wificonfig", "ssid",                  STRING, 0, "")                    \
+  X(WIFI_PASSWORD,       "wificonfig", "password",              STRING, 0, "")                    \
+  X(WIFI_STATIC_IP,      "wificonfig", "static_ip",             STRING, 0, "0.0.0.0")             \
+  X(WIFI_GATEWAY,        "wificonfig", "gateway",               STRING, 0, "0.0.0.0")             \
+  X(WIFI_SUBNET,         "wificonfig", "subnet",                STRING, 0, "255.255.255.0")       \
+  X(WIFI_USE_STATIC,     "wificonfig", "use_static",            BOOL,   false, nullptr)           \
+  X(SYS_BOOT_COUNT,      "rcu-config", "bootCount",             U32,    0, nullptr)           \
+  X(SYS_HEAP_ALARM_FREE, "rcu-config", "heap_alarm_free",       U32,    HEAP_ALARM_FREE_BYTES, nullptr) \
+  X(SYS_HEAP_ALARM_BLOCK,"rcu-config", "heap_alarm_blk",        U32,    HEAP_ALARM_BLOCK_BYTES, nullptr)
+
+enum ConfigKey : uint8_t {
+#define CONFIG_KEY_ENUM(id, space, key, type, number, text) CONFIG_##id,
+  CONFIG_FIELDS(CONFIG_KEY_ENUM)
+#undef CONFIG_KEY_ENUM
+  CONFIG_KEY_COUNT
+};
+
+enum ConfigType : uint8_t {
+  CONFIG_TYPE_U8,
+  CONFIG_TYPE_U16,
+  CONFIG_TYPE_U32,
+  CONFIG_TYPE_BOOL,
+  CONFIG_TYPE_STRING,
+  CONFIG_TYPE_BYTES
+};
+
+struct ConfigField {
+  const char* space;
+  const char* key;
+  ConfigType type;
+  uint32_t defaultNumber;
+  const char* defaultText;
+};
+
+// Cached value of one field
+struct ConfigValue {
+  uint32_t number = 0;
+  String text;
+  uint8_t bytes[CONFIG_BYTES_MAX] = {};
+  uint8_t length = 0;                // BYTES only, 0 = not set
+  bool stored = false;               // Key exists in NVS
+};
+
+/**
+ * @brief Typed configuration store on top of NVS with a read cache.
+ *
+ * begin() reads every field once and migrates older schema versions. Setters
+ * only change the cache and mark a field dirty if its value really changed;
+ * commit() then writes just the dirty fields, opening each namespace once.
+ * Resetting a field removes its key, so the default applies again.
+ * All methods are safe to call from any task.
+ */
+class ConfigStore {
+public:
+  bool begin();
+
+  uint32_t getNumber(ConfigKey key);
+  bool getBool(ConfigKey key) { return getNumber(key) != 0; }
+  String getString(ConfigKey key);
+  size_t getBytes(ConfigKey key, uint8_t* out, size_t maxLength);   // 0 = not set
+  bool isStored(ConfigKey key);
+
+  void setNumber(ConfigKey key, uint32_t value);
+  void setBool(ConfigKey key, bool value) { setNumber(key, value ? 1 : 0); }
+  void setString(ConfigKey key, const String& value);
+  void setBytes(ConfigKey key, const uint8_t* data, size_t length);  // length 0 clears the field
+  void reset(ConfigKey key);         // Default value, key removed on commit
+
+  bool commit();                     // Writes the dirty fields, false if a write failed
+  bool isDirty() const { return dirty != 0; }
+
+  uint16_t getSchemaVersion() const { return schemaVersion; }
+  uint32_t getCommits() const { return commits; }
+  uint32_t getWrites() const { return writes; }      // Keys written or removed since boot
+
+private:
+  static_assert(CONFIG_KEY_COUNT <= 32, "Dirty mask holds 32 fields");
+
+  ConfigValue values[CONFIG_KEY_COUNT];
+  uint32_t dirty = 0;
+  uint32_t removals = 0;             // Dirty fields to remove instead of write
+  uint16_t schemaVersion = 0;
+  uint32_t commits = 0;
+  uint32_t writes = 0;
+  bool loaded = false;
+  SemaphoreHandle_t mutex = nullptr;
+
+  void load(Preferences& prefs, ConfigKey key);
+  bool write(Preferences& prefs, ConfigKey key);
+  void setDefault(ConfigKey key);
+  void migrate(uint16_t from);
+  bool commitLocked();
+};
+
+extern ConfigStore configStore;
+
+#endif // CONFIG_STORE_H
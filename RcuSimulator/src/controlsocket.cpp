@@ -0,0 +1,238 @@
+#include "controlsocket.h"
+#include "globals.h"
+#include "deferredlog.h"
+#include "heapmonitor.h"
+
+ControlSocket::ControlSocket()
+    : socket(CONTROL_SOCKET_PATH)
+{
+}
+
+void ControlSocket::begin(AsyncWebServer& server) {
+  // Only the upgrade request carries the token, frames are not checked again
+  socket.handleHandshake([](AsyncWebServerRequest *request) {
+    return validateToken(request);
+  });
+  socket.onEvent([this](AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type,
+                        void* arg, uint8_t* data, size_t len) {
+    HeapTagScope heapTag(HEAP_TAG_WEB);
+    onEvent(client, type, arg, data, len);
+  });
+  server.addHandler(&socket);
+}
+
+void ControlSocket::loop() {
+  socket.cleanupClients(CONTROL_SOCKET_MAX_CLIENTS);
+}
+
+ControlClient* ControlSocket::findClient(uint32_t id) {
+  for (ControlClient& state : clients) {
+    if (state.id == id) {
+      return &state;
+    }
+  }
+  return nullptr;
+}
+
+void ControlSocket::onEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+  switch (type) {
+    case WS_EVT_CONNECT: {
+      ControlClient* state = findClient(0);
+      if (state == nullptr) {
+        client->close(1013, "Too many clients");
+        return;
+      }
+      *state = {};
+      state->id = client->id();
+      state->target = BLE_TARGET_ALL;
+      clientCount++;
+      DLOG(WEB_WS_CONNECTED, client->id(), clientCount.load());
+
+      HostConnectionInfo hosts[BLE_MAX_CONNECTIONS];
+      char hello[32];
+      snprintf(hello, sizeof(hello), "hello %u", (unsigned)bleRemoteControl.getConnections(hosts, BLE_MAX_CONNECTIONS));
+      client->text(hello);
+      break;
+    }
+
+    case WS_EVT_DISCONNECT: {
+      ControlClient* state = findClient(client->id());
+      if (state != nullptr) {
+        state->id = 0;
+        clientCount--;
+        DLOG(WEB_WS_CLOSED, client->id(), state->sequence);
+      }
+      break;
+    }
+
+    case WS_EVT_DATA: {
+      ControlClient* state = findClient(client->id());
+      if (state != nullptr) {
+        onData(client, *state, (const AwsFrameInfo*)arg, data, len);
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+// Frames may arrive in several TCP segments and messages in several frames,
+// the parts are collected until the final frame is complete
+void ControlSocket::onData(AsyncWebSocketClient* client, ControlClient& state, const AwsFrameInfo* info,
+                           const uint8_t* data, size_t len) {
+  if (info->index == 0 && info->num == 0) {
+    state.length = 0;
+    state.overflow = false;
+  }
+  if (info->message_opcode != WS_TEXT) {
+    state.overflow = true;
+  } else if (!state.overflow) {
+    if (state.length + len > CONTROL_SOCKET_MAX_MESSAGE) {
+      state.overflow = true;
+    } else {
+      memcpy(state.message + state.length, data, len);
+      state.length += len;
+    }
+  }
+
+  if (!info->final || info->index + len != info->len) {
+    return;
+  }
+  if (state.overflow) {
+    client->text("err 0 message must be text of at most " + String(CONTROL_SOCKET_MAX_MESSAGE) + " bytes");
+    state.length = 0;
+    state.overflow = false;
+    return;
+  }
+  state.message[state.length] = '\0';
+  handleMessage(client, state);
+  state.length = 0;
+}
+
+// The answers are collected in one reply, a reply that would get too long is
+// sent early and the rest follows in the next one
+void ControlSocket::handleMessage(AsyncWebSocketClient* client, ControlClient& state) {
+  size_t replyLength = 0;
+  char* save = nullptr;
+  for (char* line = strtok_r(state.message, "\n;", &save); line != nullptr; line = strtok_r(nullptr, "\n;", &save)) {
+    while (isspace((unsigned char)*line)) {
+      line++;
+    }
+    if (*line == '\0') {
+      continue;
+    }
+    char answer[CONTROL_SOCKET_MAX_ANSWER];
+    size_t answerLength = execute(state, line, answer, sizeof(answer));
+    if (replyLength + answerLength > sizeof(reply)) {
+      client->text(reply, replyLength - 1);   // Without the last newline
+      replyLength = 0;
+    }
+    memcpy(reply + replyLength, answer, answerLength);
+    replyLength += answerLength;
+  }
+  if (replyLength > 0) {
+    client->text(reply, replyLength - 1);
+  }
+}
+
+static bool parseHold(const char* text, uint32_t& holdMs) {
+  if (text == nullptr) {
+    holdMs = 100;
+    return true;
+  }
+  if (strcmp(text, "auto") == 0) {
+    holdMs = KEY_HOLD_AUTO;
+    return true;
+  }
+  char* end;
+  unsigned long value = strtoul(text, &end, 10);
+  if (*end != '\0' || value > KEY_HOLD_MAX_MS) {
+    return false;
+  }
+  holdMs = value;
+  return true;
+}
+
+// Runs one command, the answer line ends with a newline. Returns its length.
+size_t ControlSocket::execute(ControlClient& state, char* line, char* answer, size_t maxLength) {
+  uint32_t sequence = ++state.sequence;
+  commands++;
+
+  char* save = nullptr;
+  const char* command = strtok_r(line, " \t\r", &save);
+  const char* argument = strtok_r(nullptr, " \t\r", &save);
+  const char* hold = strtok_r(nullptr, " \t\r", &save);
+
+  const char* error = nullptr;
+  uint32_t requestId = 0;
+  uint32_t holdMs = 0;
+  KeyId key;
+  uint16_t usage = 0;
+
+  char name = strlen(command) == 1 ? command[0] : '\0';
+  if (name == 't') {
+    long connId = argument != nullptr ? strtol(argument, nullptr, 10) : -1;
+    if (argument != nullptr && strcmp(argument, "all") == 0) {
+      state.target = BLE_TARGET_ALL;
+    } else if (argument == nullptr || connId < 0 || connId >= BLE_TARGET_ALL ||
+               (connId == 0 && strcmp(argument, "0") != 0)) {
+      error = "invalid target";
+    } else {
+      state.target = (uint8_t)connId;
+    }
+  } else if (name == 'k' || name == 'p' || name == 'r') {
+    key = argument != nullptr ? resolveKeyName(argument, strlen(argument)) : KeyId();
+    if (!key.isValid()) {
+      error = "unknown key";
+    } else if (name == 'k' && !parseHold(hold, holdMs)) {
+      error = "invalid hold time";
+    }
+  } else if (name == 'x') {
+    char* end = nullptr;
+    unsigned long value = argument != nullptr ? strtoul(argument, &end, 16) : 0;
+    if (argument == nullptr || *end != '\0' || value == 0 || value > 0xFFFF) {
+      error = "invalid usage";
+    } else if (!parseHold(hold, holdMs)) {
+      error = "invalid hold time";
+    }
+    usage = (uint16_t)value;
+  } else if (name != 'a') {
+    error = "unknown command";
+  }
+
+  uint8_t target = state.target;
+  if (error == nullptr && name != 't') {
+    if (!bleRemoteControl.isConnected(target)) {
+      error = "not connected";
+    } else if ((name == 'k' || name == 'p' || name == 'x') && bleRemoteControl.isTxQueueFull(target)) {
+      error = "busy";   // Releases always have room in the TX queue
+    } else {
+      switch (name) {
+        case 'k': requestId = keyScheduler.tap(key, holdMs, target); break;
+        case 'p': requestId = keyScheduler.press(key, target); break;
+        case 'r': requestId = keyScheduler.release(key, target); break;
+        case 'x': requestId = keyScheduler.tapMedia(usage, 0, holdMs, target); break;
+        case 'a': requestId = keyScheduler.releaseAll(target); break;
+      }
+      if (requestId == 0) {
+        error = "queue full";
+      }
+    }
+  }
+
+  int written = error != nullptr ? snprintf(answer, maxLength, "err %u %s\n", (unsigned)sequence, error)
+                                 : snprintf(answer, maxLength, "ok %u %u\n", (unsigned)sequence, (unsigned)requestId);
+  return written > 0 && (size_t)written < maxLength ? written : 0;
+}
+
+// Called from the BLE callbacks, every client gets the event
+void ControlSocket::notifyConnection(bool connected, uint16_t connId) {
+  if (clientCount.load() == 0) {
+    return;
+  }
+  char event[40];
+  snprintf(event, sizeof(event), "event %s %u", connected ? "connect" : "disconnect", (unsigned)connId);
+  socket.textAll(event);
+}
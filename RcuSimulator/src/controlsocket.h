@@ -0,0 +1,72 @@
+#ifndef CONTROL_SOCKET_H
+#define CONTROL_SOCKET_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <ESPAsyncWebServer.h>
+#include "BleRemoteControl.h"
+
+#define CONTROL_SOCKET_PATH "/ws"
+#define CONTROL_SOCKET_MAX_CLIENTS 4
+#define CONTROL_SOCKET_MAX_MESSAGE 1024    // Bytes of commands per message
+#define CONTROL_SOCKET_MAX_REPLY 1024      // Longer replies are split into several messages
+#define CONTROL_SOCKET_MAX_ANSWER 48       // One answer line
+
+// Connection state of one WebSocket client
+struct ControlClient {
+  uint32_t id;                             // AsyncWebSocketClient id, 0 = free slot
+  uint8_t target;                          // Host the commands go to, changed with "t"
+  uint32_t sequence;                       // Number of the last command, replies refer to it
+  size_t length;                           // Bytes of the message received so far
+  bool overflow;
+  char message[CONTROL_SOCKET_MAX_MESSAGE + 1];
+};
+
+/**
+ * @brief Persistent WebSocket channel for key commands.
+ *
+ * The token is checked once in the upgrade request (/ws?token=...), after that
+ * a command costs a few bytes instead of an HTTP request. A text message holds
+ * any number of commands separated by newlines or ';':
+ *
+ *   k <key> [ms|auto]   tap          p <key>   press
+ *   x <hex> [ms|auto]   raw tap      r <key>   release
+ *   a                   release all  t <connId|all>   target
+ *
+ * Every message is answered with one message of one line per command,
+ * "ok <seq> <requestId>" or "err <seq> <reason>", where seq counts the
+ * commands of the connection from 1; long replies are split. Host connects
+ * and disconnects are pushed as "event connect <connId>" and
+ * "event disconnect <connId>".
+ *
+ * Messages are handled on the AsyncTCP task and only enqueue to the key
+ * scheduler, so pipelined commands keep their timing.
+ */
+class ControlSocket {
+public:
+  ControlSocket();
+
+  void begin(AsyncWebServer& server);
+  void loop();                             // Frees the resources of closed clients
+  void notifyConnection(bool connected, uint16_t connId);
+
+  size_t getClientCount() const { return clientCount.load(); }
+  uint32_t getCommands() const { return commands.load(); }
+
+private:
+  AsyncWebSocket socket;
+  ControlClient clients[CONTROL_SOCKET_MAX_CLIENTS] = {};
+  std::atomic<size_t> clientCount{0};
+  std::atomic<uint32_t> commands{0};
+  char reply[CONTROL_SOCKET_MAX_REPLY];    // Only used on the AsyncTCP task
+
+  void onEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+  void onData(AsyncWebSocketClient* client, ControlClient& state, const AwsFrameInfo* info, const uint8_t* data, size_t len);
+  void handleMessage(AsyncWebSocketClient* client, ControlClient& state);
+  size_t execute(ControlClient& state, char* line, char* answer, size_t maxLength);
+  ControlClient* findClient(uint32_t id);
+};
+
+extern ControlSocket controlSocket;
+
+#endif // CONTROL_SOCKET_H
@@ -0,0 +1,147 @@
+#include "deferredlog.h"
+
+DeferredLog::DeferredLog()
+    : head(0), dropped(0)
+{
+  static_assert((DEFERRED_LOG_CAPACITY & (DEFERRED_LOG_CAPACITY - 1)) == 0, "Capacity must be a power of two");
+  static_assert(sizeof(logFormats) / sizeof(logFormats[0]) == LOG_FORMAT_COUNT, "Format table out of sync");
+  for (uint32_t i = 0; i < DEFERRED_LOG_CAPACITY; i++) {
+    ring[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
+    levels[i].store(LOG_LEVEL_INFO, std::memory_order_relaxed);
+  }
+}
+
+bool DeferredLog::begin() {
+  if (task != nullptr) {
+    return true;
+  }
+  if (xTaskCreate(&DeferredLog::taskEntry, "dlog", DEFERRED_LOG_STACK_SIZE,
+                  this, DEFERRED_LOG_PRIORITY, &task) != pdPASS) {
+    Serial.println("Deferred log: failed to create task");
+    task = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void DeferredLog::setLevel(LogModule module, LogLevel level) {
+  if (module < LOG_MODULE_COUNT) {
+    levels[module].store(level, std::memory_order_relaxed);
+  }
+}
+
+LogLevel DeferredLog::getLevel(LogModule module) const {
+  return module < LOG_MODULE_COUNT ? (LogLevel)levels[module].load(std::memory_order_relaxed) : LOG_LEVEL_NONE;
+}
+
+// Bounded MPSC queue: a producer claims a slot by advancing head, fills it and
+// publishes it by setting the slot sequence to position + 1.
+void DeferredLog::push(LogFormatId id, const uint32_t* args, uint8_t argc) {
+  uint32_t pos = head.load(std::memory_order_relaxed);
+  LogSlot* slot;
+  for (;;) {
+    slot = &ring[pos & (DEFERRED_LOG_CAPACITY - 1)];
+    int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      dropped.fetch_add(1, std::memory_order_relaxed); // Ring full
+      return;
+    } else {
+      pos = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->entry.timestampMs = (uint32_t)(esp_timer_get_time() / 1000);
+  slot->entry.formatId = id;
+  slot->entry.argc = argc;
+  for (uint8_t i = 0; i < argc; i++) {
+    slot->entry.args[i] = args[i];
+  }
+  slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool DeferredLog::pop(LogEntry& entry) {
+  LogSlot& slot = ring[tail & (DEFERRED_LOG_CAPACITY - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+    return false;
+  }
+  entry = slot.entry;
+  slot.sequence.store(tail + DEFERRED_LOG_CAPACITY, std::memory_order_release);
+  tail++;
+  return true;
+}
+
+void DeferredLog::print(const LogEntry& entry) {
+  if (entry.formatId >= LOG_FORMAT_COUNT) {
+    return;
+  }
+  const LogFormat& format = logFormats[entry.formatId];
+  uint32_t a[DEFERRED_LOG_MAX_ARGS] = {};
+  for (uint8_t i = 0; i < entry.argc && i < DEFERRED_LOG_MAX_ARGS; i++) {
+    a[i] = entry.args[i];
+  }
+
+  char line[DEFERRED_LOG_LINE_LENGTH];
+  // Unused trailing arguments are ignored by snprintf
+  snprintf(line, sizeof(line), format.format,
+           (unsigned)a[0], (unsigned)a[1], (unsigned)a[2], (unsigned)a[3],
+           (unsigned)a[4], (unsigned)a[5], (unsigned)a[6], (unsigned)a[7]);
+  Serial.printf("[%6u.%03u] %s: %s\n", (unsigned)(entry.timestampMs / 1000), (unsigned)(entry.timestampMs % 1000),
+                logModuleNames[format.module], line);
+}
+
+void DeferredLog::taskEntry(void* arg) {
+  static_cast<DeferredLog*>(arg)->run();
+}
+
+void DeferredLog::run() {
+  LogEntry entry;
+  for (;;) {
+    while (pop(entry)) {
+      print(entry);
+    }
+    uint32_t total = dropped.load(std::memory_order_relaxed);
+    if (total != reportedDropped) {
+      uint32_t lost = total - reportedDropped;
+      reportedDropped = total;
+      DLOG(SYS_LOG_DROPPED, lost);
+    }
+    vTaskDelay(pdMS_TO_TICKS(DEFERRED_LOG_POLL_MS));
+  }
+}
+
+bool DeferredLog::parseModule(const String& name, LogModule& module) {
+  for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
+    if (name.equalsIgnoreCase(logModuleNames[i])) {
+      module = (LogModule)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DeferredLog::parseLevel(const String& name, LogLevel& level) {
+  for (uint8_t i = LOG_LEVEL_NONE; i <= LOG_LEVEL_DEBUG; i++) {
+    if (name.equalsIgnoreCase(levelName((LogLevel)i))) {
+      level = (LogLevel)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* DeferredLog::levelName(LogLevel level) {
+  switch (level) {
+    case LOG_LEVEL_NONE:  return "none";
+    case LOG_LEVEL_ERROR: return "error";
+    case LOG_LEVEL_WARN:  return "warn";
+    case LOG_LEVEL_INFO:  return "info";
+    case LOG_LEVEL_DEBUG: return "debug";
+  }
+  return "unknown";
+}
@@ -0,0 +1,172 @@
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#define DEFERRED_LOG_CAPACITY 64      // Records, must be a power of two
+#define DEFERRED_LOG_LINE_LENGTH 128
+#define DEFERRED_LOG_MAX_ARGS 8
+#define DEFERRED_LOG_STACK_SIZE 3072
+#define DEFERRED_LOG_PRIORITY 1       // Just above idle, formatting never competes with BLE or HTTP
+#define DEFERRED_LOG_POLL_MS 20
+
+// X(id, name)
+#define LOG_MODULES(X) \
+  X(BLE,  "ble")       \
+  X(KEYS, "keys")      \
+  X(WEB,  "web")       \
+  X(SYS,  "sys")
+
+enum LogModule : uint8_t {
+#define LOG_MODULE_ENUM(id, name) LOG_MODULE_##id,
+  LOG_MODULES(LOG_MODULE_ENUM)
+#undef LOG_MODULE_ENUM
+  LOG_MODULE_COUNT
+};
+
+enum LogLevel : uint8_t {
+  LOG_LEVEL_NONE = 0,
+  LOG_LEVEL_ERROR,
+  LOG_LEVEL_WARN,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_DEBUG
+};
+
+// X(id, module, level, format)
+// Arguments are stored as raw uint32_t values, so formats may only use integer
+// conversions. The format strings stay in flash and are never copied.
+#define LOG_FORMATS(X)                                                                         \
+  X(SYS_LOG_DROPPED,   SYS,  WARN,  "%u log records dropped")                                  \
+  X(SYS_HEAP_ALARM,    SYS,  WARN,  "Heap low: %u bytes free, largest block %u bytes")          \
+  X(SYS_HEAP_RECOVERED, SYS, INFO,  "Heap recovered: %u bytes free, largest block %u bytes")    \
+  X(BLE_KEY_REPORT,    BLE,  DEBUG, "Key report: %02X %02X %02X %02X %02X %02X %02X %02X")     \
+  X(BLE_MEDIA_REPORT,  BLE,  DEBUG, "Media report: %02X %02X %02X %02X %02X")                  \
+  X(BLE_NOTIFY_FAILED, BLE,  WARN,  "Notify failed with status %u, %u reports pending")        \
+  X(BLE_CONGESTED,     BLE,  INFO,  "Controller congested: %u")                                \
+  X(BLE_CONN_PARAMS,   BLE,  INFO,  "Conn params update status %u: interval %u, latency %u, timeout %u") \
+  X(BLE_BATTERY_LEVEL, BLE,  INFO,  "Battery level set to %u%%")                               \
+  X(BLE_VERSION_ID,    BLE,  INFO,  "Custom Version ID set to: 0x%04X")                        \
+  X(KEYS_EXECUTED,     KEYS, DEBUG, "Request %u executed (type %u) in %u us")                  \
+  X(KEYS_TYPE_ABORTED, KEYS, WARN,  "Request %u: host unreachable, typing stopped after %u of %u characters") \
+  X(WEB_PAIR_STARTED,  WEB,  INFO,  "BLE advertising started for pairing...")                  \
+  X(WEB_PAIR_FAILED,   WEB,  WARN,  "Failed to start BLE advertising for pairing")             \
+  X(WEB_KEY_QUEUED,    WEB,  DEBUG, "Request %u queued: key kind %u code 0x%02X hold %u ms") \
+  X(WEB_WS_CONNECTED,  WEB,  INFO,  "WebSocket client %u connected, %u clients")              \
+  X(WEB_WS_CLOSED,     WEB,  INFO,  "WebSocket client %u closed after %u commands")
+
+enum LogFormatId : uint16_t {
+#define LOG_FORMAT_ENUM(id, module, level, format) LOG_##id,
+  LOG_FORMATS(LOG_FORMAT_ENUM)
+#undef LOG_FORMAT_ENUM
+  LOG_FORMAT_COUNT
+};
+
+struct LogFormat {
+  LogModule module;
+  LogLevel level;
+  const char* format;
+};
+
+inline constexpr LogFormat logFormats[] = {
+#define LOG_FORMAT_ENTRY(id, module, level, format) {LOG_MODULE_##module, LOG_LEVEL_##level, format},
+  LOG_FORMATS(LOG_FORMAT_ENTRY)
+#undef LOG_FORMAT_ENTRY
+};
+
+inline constexpr const char* logModuleNames[] = {
+#define LOG_MODULE_NAME(id, name) name,
+  LOG_MODULES(LOG_MODULE_NAME)
+#undef LOG_MODULE_NAME
+};
+
+// Number of conversions in a format string, "%%" does not count
+constexpr size_t logArgCount(const char* format) {
+  size_t count = 0;
+  for (size_t i = 0; format[i] != '\0'; i++) {
+    if (format[i] == '%') {
+      if (format[i + 1] == '%') {
+        i++;
+      } else {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+struct LogEntry {
+  uint32_t timestampMs;
+  uint16_t formatId;
+  uint8_t argc;
+  uint32_t args[DEFERRED_LOG_MAX_ARGS];
+};
+
+// Ring slot, the sequence number tells producer and consumer who owns it
+struct LogSlot {
+  std::atomic<uint32_t> sequence;
+  LogEntry entry;
+};
+
+/**
+ * @brief Deferred logger for the report hot path.
+ *
+ * Call sites only store the format ID and the raw arguments in a lock-free
+ * multi-producer ring buffer (safe from any task, never blocks). A low
+ * priority task formats the records and writes them to Serial. When the
+ * ring is full new records are dropped and counted.
+ */
+class DeferredLog {
+public:
+  DeferredLog();
+
+  bool begin();
+
+  template <LogFormatId Id, typename... Args>
+  void log(Args... args) {
+    static_assert(sizeof...(Args) == logArgCount(logFormats[Id].format), "Argument count does not match log format");
+    static_assert(sizeof...(Args) <= DEFERRED_LOG_MAX_ARGS, "Too many log arguments");
+    if (!isEnabled(Id)) {
+      return;
+    }
+    const uint32_t raw[] = {0, static_cast<uint32_t>(args)...};
+    push(Id, raw + 1, sizeof...(Args));
+  }
+
+  bool isEnabled(LogFormatId id) const {
+    return logFormats[id].level <= levels[logFormats[id].module].load(std::memory_order_relaxed);
+  }
+
+  void setLevel(LogModule module, LogLevel level);
+  LogLevel getLevel(LogModule module) const;
+  uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+  static bool parseModule(const String& name, LogModule& module);
+  static bool parseLevel(const String& name, LogLevel& level);
+  static const char* levelName(LogLevel level);
+
+private:
+  LogSlot ring[DEFERRED_LOG_CAPACITY];
+  std::atomic<uint32_t> head;
+  uint32_t tail = 0;                  // Only touched by the logging task
+  std::atomic<uint32_t> dropped;
+  uint32_t reportedDropped = 0;
+  std::atomic<uint8_t> levels[LOG_MODULE_COUNT];
+  TaskHandle_t task = nullptr;
+
+  void push(LogFormatId id, const uint32_t* args, uint8_t argc);
+  bool pop(LogEntry& entry);
+  void print(const LogEntry& entry);
+  void run();
+
+  static void taskEntry(void* arg);
+};
+
+extern DeferredLog deferredLog;
+
+#define DLOG(id, ...) deferredLog.log<LOG_##id>(__VA_ARGS__)
+
+#endif // DEFERRED_LOG_H
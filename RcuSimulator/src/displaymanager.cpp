@@ -1,4 +1,5 @@
 #include "displaymanager.h"
+#include "heapmonitor.h"
 
 DisplayManager::DisplayManager(){
     lines.resize(maxLines);
@@ -42,6 +43,7 @@ void DisplayManager::clearLineArea(uint8_t lineNumber) {
 void DisplayManager::render() {
 #ifdef USE_DISPLAY    
     if (!displayInitialized) return;
+    HeapTagScope heapTag(HEAP_TAG_DISPLAY);
     display.clearDisplay();
 
     // Headline
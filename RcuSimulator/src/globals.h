@@ -6,6 +6,10 @@
 #include "webserver.h"
 #include "wifimanager.h"
 #include "BleRemoteControl.h"
+#include "keyscheduler.h"
+#include "controlsocket.h"
+#include "udpcontrol.h"
+#include "statestream.h"
 
 #define USE_DISPLAY // Define this to enable display functionality
 
@@ -32,7 +36,10 @@
 extern bool isConfigMode;
 extern WiFiManager wifiManager;
 extern BleRemoteControl bleRemoteControl;
-extern Preferences preferences;
+extern KeyScheduler keyScheduler;
+extern ControlSocket controlSocket;
+extern UdpControl udpControl;
+extern StateStream stateStream;
 
 extern unsigned long startTime;
 extern unsigned long bootCount;
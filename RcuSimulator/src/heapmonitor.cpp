@@ -0,0 +1,185 @@
+#include "heapmonitor.h"
+#include "deferredlog.h"
+#include "configstore.h"
+#include "esp_heap_caps.h"
+
+// Same heap as ESP.getFreeHeap(), the board has no PSRAM
+#define HEAP_MONITOR_CAPS MALLOC_CAP_INTERNAL
+
+static __thread HeapTag currentTag = HEAP_TAG_OTHER;
+static HeapTagStats tagStats[HEAP_TAG_COUNT];
+static portMUX_TYPE tagStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+HeapTagScope::HeapTagScope(HeapTag tag) : previous(currentTag) {
+  currentTag = tag;
+}
+
+HeapTagScope::~HeapTagScope() {
+  currentTag = previous;
+}
+
+#ifdef HEAP_ACCOUNTING
+
+// The thread-local tag only exists once tasks run, earlier allocations are "other"
+static inline HeapTag IRAM_ATTR allocationTag() {
+  return xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED ? HEAP_TAG_OTHER : currentTag;
+}
+
+// Sizes are the usable size of the block, not the requested one
+static void IRAM_ATTR countAllocation(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  size_t size = heap_caps_get_allocated_size(ptr);
+  HeapTagStats& stats = tagStats[allocationTag()];
+  portENTER_CRITICAL(&tagStatsMux);
+  stats.allocations++;
+  stats.allocatedBytes += size;
+  portEXIT_CRITICAL(&tagStatsMux);
+}
+
+static void IRAM_ATTR countFree(size_t size) {
+  HeapTagStats& stats = tagStats[allocationTag()];
+  portENTER_CRITICAL(&tagStatsMux);
+  stats.frees++;
+  stats.freedBytes += size;
+  portEXIT_CRITICAL(&tagStatsMux);
+}
+
+// Linked in place of the malloc family with -Wl,--wrap=<name>
+extern "C" {
+void* __real_malloc(size_t size);
+void __real_free(void* ptr);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* IRAM_ATTR __wrap_malloc(size_t size) {
+  void* ptr = __real_malloc(size);
+  countAllocation(ptr);
+  return ptr;
+}
+
+void IRAM_ATTR __wrap_free(void* ptr) {
+  if (ptr != nullptr) {
+    countFree(heap_caps_get_allocated_size(ptr));
+  }
+  __real_free(ptr);
+}
+
+void* IRAM_ATTR __wrap_calloc(size_t count, size_t size) {
+  void* ptr = __real_calloc(count, size);
+  countAllocation(ptr);
+  return ptr;
+}
+
+// Counted as a free of the old block and an allocation of the new one
+void* IRAM_ATTR __wrap_realloc(void* ptr, size_t size) {
+  size_t oldSize = ptr != nullptr ? heap_caps_get_allocated_size(ptr) : 0;
+  void* result = __real_realloc(ptr, size);
+  if (ptr != nullptr && (result != nullptr || size == 0)) {
+    countFree(oldSize);
+  }
+  countAllocation(result);
+  return result;
+}
+}
+
+#endif // HEAP_ACCOUNTING
+
+bool HeapMonitor::isAccounting() {
+#ifdef HEAP_ACCOUNTING
+  return true;
+#else
+  return false;
+#endif
+}
+
+const char* HeapMonitor::tagName(HeapTag tag) {
+  switch (tag) {
+    case HEAP_TAG_OTHER:   return "other";
+    case HEAP_TAG_WEB:     return "web";
+    case HEAP_TAG_BLE:     return "ble";
+    case HEAP_TAG_CLI:     return "cli";
+    case HEAP_TAG_DISPLAY: return "display";
+    default:               return "unknown";
+  }
+}
+
+bool HeapMonitor::begin() {
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == nullptr) {
+      return false;
+    }
+  }
+  freeThreshold = configStore.getNumber(CONFIG_SYS_HEAP_ALARM_FREE);
+  blockThreshold = configStore.getNumber(CONFIG_SYS_HEAP_ALARM_BLOCK);
+  takeSnapshot();
+  return true;
+}
+
+void HeapMonitor::loop() {
+  if (millis() - lastSnapshotAt >= HEAP_SNAPSHOT_INTERVAL_MS) {
+    takeSnapshot();
+  }
+}
+
+void HeapMonitor::setThresholds(uint32_t freeBytes, uint32_t blockBytes) {
+  freeThreshold = freeBytes;
+  blockThreshold = blockBytes;
+  configStore.setNumber(CONFIG_SYS_HEAP_ALARM_FREE, freeBytes);
+  configStore.setNumber(CONFIG_SYS_HEAP_ALARM_BLOCK, blockBytes);
+  configStore.commit();
+}
+
+HeapTagStats HeapMonitor::getTagStats(HeapTag tag) const {
+  HeapTagStats stats = {};
+  if (tag < HEAP_TAG_COUNT) {
+    portENTER_CRITICAL(&tagStatsMux);
+    stats = tagStats[tag];
+    portEXIT_CRITICAL(&tagStatsMux);
+  }
+  return stats;
+}
+
+HeapSnapshot HeapMonitor::getSnapshot() const {
+  HeapSnapshot copy = {};
+  if (mutex == nullptr) {
+    return copy;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  copy = snapshot;
+  xSemaphoreGive(mutex);
+  return copy;
+}
+
+// Runs on the loop task only, the alarm state is read there without the mutex
+void HeapMonitor::takeSnapshot() {
+  HeapSnapshot next = {};
+  next.takenAt = millis();
+  next.freeBytes = heap_caps_get_free_size(HEAP_MONITOR_CAPS);
+  next.minFreeBytes = heap_caps_get_minimum_free_size(HEAP_MONITOR_CAPS);
+  next.largestBlock = heap_caps_get_largest_free_block(HEAP_MONITOR_CAPS);
+  if (next.freeBytes > 0) {
+    next.fragmentation = 100 - (uint8_t)((uint64_t)next.largestBlock * 100 / next.freeBytes);
+  }
+  if (lastSnapshotAt != 0) {
+    next.freeDelta = (int32_t)next.freeBytes - (int32_t)snapshot.freeBytes;
+  }
+  for (uint8_t i = 0; i < HEAP_TAG_COUNT; i++) {
+    next.tags[i] = getTagStats((HeapTag)i);
+  }
+
+  next.alarm = next.freeBytes < freeThreshold || next.largestBlock < blockThreshold;
+  if (next.alarm && !snapshot.alarm) {
+    alarmCount++;
+    DLOG(SYS_HEAP_ALARM, next.freeBytes, next.largestBlock);
+  } else if (!next.alarm && snapshot.alarm) {
+    DLOG(SYS_HEAP_RECOVERED, next.freeBytes, next.largestBlock);
+  }
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  snapshot = next;
+  xSemaphoreGive(mutex);
+  lastSnapshotAt = next.takenAt != 0 ? next.takenAt : 1;
+}
@@ -0,0 +1,98 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define HEAP_SNAPSHOT_INTERVAL_MS 10000
+#define HEAP_ALARM_FREE_BYTES 24576        // Default alarm threshold for the free heap
+#define HEAP_ALARM_BLOCK_BYTES 8192        // Default alarm threshold for the largest free block
+
+// Subsystem an allocation is counted for, set per task by HeapTagScope
+enum HeapTag : uint8_t {
+  HEAP_TAG_OTHER,       // No scope active: WiFi, lwIP, BT host, startup
+  HEAP_TAG_WEB,         // HTTP handlers, WebSocket and UDP commands
+  HEAP_TAG_BLE,         // HID report queues and notify()
+  HEAP_TAG_CLI,         // Serial command line
+  HEAP_TAG_DISPLAY,     // OLED rendering
+  HEAP_TAG_COUNT
+};
+
+struct HeapTagStats {
+  uint32_t allocations;
+  uint32_t frees;
+  uint64_t allocatedBytes;
+  uint64_t freedBytes;
+};
+
+struct HeapSnapshot {
+  uint32_t takenAt;          // millis()
+  uint32_t freeBytes;
+  uint32_t minFreeBytes;     // Lowest free heap since boot
+  uint32_t largestBlock;
+  uint8_t fragmentation;     // Percent of the free heap not in the largest block
+  int32_t freeDelta;         // Change of the free heap since the previous snapshot
+  bool alarm;
+  HeapTagStats tags[HEAP_TAG_COUNT];
+};
+
+/**
+ * @brief Sets the heap tag of the calling task for its lifetime.
+ *
+ * Scopes nest, the previous tag is restored on exit. Only the malloc family is
+ * counted (new, String, std containers); heap_caps_malloc() calls of the IDF
+ * stay invisible.
+ */
+class HeapTagScope {
+public:
+  explicit HeapTagScope(HeapTag tag);
+  ~HeapTagScope();
+  HeapTagScope(const HeapTagScope&) = delete;
+  HeapTagScope& operator=(const HeapTagScope&) = delete;
+
+private:
+  HeapTag previous;
+};
+
+/**
+ * @brief Internal heap statistics, per-subsystem allocation counts and an alarm.
+ *
+ * Allocations are counted by the malloc wrappers in heapmonitor.cpp, which only
+ * exist when the firmware is linked with -DHEAP_ACCOUNTING and --wrap (see
+ * platformio.ini); without them the tag counters stay 0. A free is counted for
+ * the tag of the task that frees the block, so the bytes still allocated per
+ * tag are approximate, the sum over all tags is exact.
+ *
+ * loop() takes a snapshot every HEAP_SNAPSHOT_INTERVAL_MS and raises the alarm
+ * when the free heap or the largest free block falls below its threshold.
+ */
+class HeapMonitor {
+public:
+  bool begin();
+  void loop();
+
+  HeapSnapshot getSnapshot() const;
+  HeapTagStats getTagStats(HeapTag tag) const;
+  uint32_t getAlarmCount() const { return alarmCount; }
+  uint32_t getFreeThreshold() const { return freeThreshold; }
+  uint32_t getBlockThreshold() const { return blockThreshold; }
+  void setThresholds(uint32_t freeBytes, uint32_t blockBytes);   // Stored in the config store
+
+  static bool isAccounting();
+  static const char* tagName(HeapTag tag);
+
+private:
+  HeapSnapshot snapshot = {};
+  uint32_t lastSnapshotAt = 0;
+  uint32_t alarmCount = 0;
+  uint32_t freeThreshold = HEAP_ALARM_FREE_BYTES;
+  uint32_t blockThreshold = HEAP_ALARM_BLOCK_BYTES;
+  SemaphoreHandle_t mutex = nullptr;
+
+  void takeSnapshot();
+};
+
+extern HeapMonitor heapMonitor;
+
+#endif // HEAP_MONITOR_H
@@ -0,0 +1,263 @@
+#include "hiddescriptor.h"
+
+// Little-endian bit order as used on the wire
+static void writeBits(uint8_t* out, uint16_t bitOffset, uint8_t bitSize, uint32_t value) {
+  for (uint8_t i = 0; i < bitSize; i++) {
+    uint16_t bit = bitOffset + i;
+    if (value & (1UL << i)) {
+      out[bit / 8] |= 1 << (bit % 8);
+    }
+  }
+}
+
+// The parser only yields fields inside the report, this keeps a corrupt layout from writing past it
+static bool fieldFits(const HidField& field, uint8_t reportLength) {
+  return (uint32_t)field.bitOffset + (uint32_t)field.bitSize * field.count <= (uint32_t)reportLength * 8;
+}
+
+void HidReportLayout::packKeyboard(uint8_t modifierBits, const uint8_t keyCodes[6], uint8_t* out) const {
+  memset(out, 0, keyboardLength);
+  if (!fieldFits(modifiers, keyboardLength) || !fieldFits(keys, keyboardLength)) {
+    return;
+  }
+  for (uint8_t i = 0; i < modifiers.count && i < 8; i++) {
+    writeBits(out, modifiers.bitOffset + i * modifiers.bitSize, modifiers.bitSize, (modifierBits >> i) & 1);
+  }
+  for (uint8_t i = 0; i < keys.count && i < 6; i++) {
+    writeBits(out, keys.bitOffset + i * keys.bitSize, keys.bitSize, keyCodes[i]);
+  }
+}
+
+void HidReportLayout::packConsumer(uint16_t first, uint16_t second, uint8_t* out) const {
+  memset(out, 0, consumerLength);
+  if (!fieldFits(consumer, consumerLength)) {
+    return;
+  }
+  const uint16_t usages[2] = {first, second};
+  for (uint8_t i = 0; i < consumer.count && i < 2; i++) {
+    writeBits(out, consumer.bitOffset + i * consumer.bitSize, consumer.bitSize, usages[i]);
+  }
+}
+
+HidDescriptorParser::ReportBits* HidDescriptorParser::findReport(ReportBits* reports, size_t& count, uint8_t id) {
+  for (size_t i = 0; i < count; i++) {
+    if (reports[i].id == id) {
+      return &reports[i];
+    }
+  }
+  if (count >= HID_MAX_REPORTS) {
+    return nullptr;
+  }
+  reports[count] = {id, 0, 0};
+  return &reports[count++];
+}
+
+bool HidDescriptorParser::parse(const uint8_t* data, size_t length, HidReportLayout& layout, String& error) {
+  layout = {};
+  if (length == 0 || length > HID_DESCRIPTOR_MAX_LENGTH) {
+    error = "Descriptor must be 1-" + String(HID_DESCRIPTOR_MAX_LENGTH) + " bytes";
+    return false;
+  }
+
+  GlobalState global = {};
+  GlobalState stack[HID_GLOBAL_STACK_DEPTH];
+  size_t stackDepth = 0;
+  uint32_t usageMinimum = 0;
+  bool hasUsageMinimum = false;
+  size_t depth = 0;
+  bool usesReportIds = false;
+  bool mainWithoutId = false;
+  uint8_t modifiersId = 0;
+  ReportBits reports[HID_MAX_REPORTS];
+  size_t reportCount = 0;
+
+  size_t pos = 0;
+  while (pos < length) {
+    size_t offset = pos;
+    uint8_t prefix = data[pos];
+    if (prefix == 0xFE) {
+      error = "Long item at offset " + String(offset) + " is not supported";
+      return false;
+    }
+    uint8_t size = prefix & 0x03;
+    if (size == 3) {
+      size = 4;
+    }
+    uint8_t type = (prefix >> 2) & 0x03;
+    uint8_t tag = prefix >> 4;
+    if (pos + 1 + size > length) {
+      error = "Item at offset " + String(offset) + " exceeds the descriptor";
+      return false;
+    }
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < size; i++) {
+      value |= (uint32_t)data[pos + 1 + i] << (8 * i);
+    }
+    pos += 1 + size;
+
+    if (type == HID_ITEM_MAIN) {
+      if (tag == HID_MAIN_COLLECTION) {
+        if (++depth > HID_MAX_COLLECTION_DEPTH) {
+          error = "Collections nested too deep at offset " + String(offset);
+          return false;
+        }
+      } else if (tag == HID_MAIN_END_COLLECTION) {
+        if (depth == 0) {
+          error = "End Collection without Collection at offset " + String(offset);
+          return false;
+        }
+        depth--;
+      } else if (tag == HID_MAIN_INPUT || tag == HID_MAIN_OUTPUT || tag == HID_MAIN_FEATURE) {
+        if (global.reportSize == 0 || global.reportCount == 0) {
+          error = "Report Size or Report Count missing before offset " + String(offset);
+          return false;
+        }
+        mainWithoutId |= !usesReportIds;
+        ReportBits* report = findReport(reports, reportCount, global.reportId);
+        if (report == nullptr) {
+          error = "More than " + String(HID_MAX_REPORTS) + " reports";
+          return false;
+        }
+        uint32_t bits = (uint32_t)global.reportSize * global.reportCount;
+        bool isData = (value & HID_MAIN_CONSTANT) == 0;
+        bool variable = (value & HID_MAIN_VARIABLE) != 0;
+        // A 4 byte usage carries its own usage page
+        uint16_t page = hasUsageMinimum && usageMinimum > 0xFFFF ? usageMinimum >> 16 : global.usagePage;
+        uint16_t usage = usageMinimum & 0xFFFF;
+
+        if (tag == HID_MAIN_INPUT) {
+          HidField field = {(uint16_t)report->inputBits, global.reportSize, global.reportCount};
+          if (isData && page == HID_PAGE_KEYBOARD && variable && global.reportSize == 1 &&
+              hasUsageMinimum && usage == 0xE0 && layout.modifiers.bitSize == 0) {
+            layout.modifiers = field;
+            modifiersId = global.reportId;
+          } else if (isData && page == HID_PAGE_KEYBOARD && !variable && global.reportSize == 8 && !layout.hasKeyboard) {
+            layout.keys = field;
+            layout.hasKeyboard = true;
+            layout.keyboardId = global.reportId;
+          } else if (isData && page == HID_PAGE_CONSUMER && !variable && global.reportSize >= 8 &&
+                     global.reportSize <= 16 && !layout.hasConsumer) {
+            layout.consumer = field;
+            layout.hasConsumer = true;
+            layout.consumerId = global.reportId;
+          }
+          report->inputBits += bits;
+          // Checked here, a later field must not get an offset past the report
+          if (report->inputBits > HID_REPORT_MAX_LENGTH * 8) {
+            error = "Input report " + String(report->id) + " longer than " + String(HID_REPORT_MAX_LENGTH) +
+                    " bytes at offset " + String(offset);
+            return false;
+          }
+        } else if (tag == HID_MAIN_OUTPUT) {
+          if (isData && page == HID_PAGE_LEDS && !layout.hasOutput) {
+            layout.hasOutput = true;
+            layout.outputId = global.reportId;
+          }
+          report->outputBits += bits;
+        }
+      } else {
+        error = "Reserved main item at offset " + String(offset);
+        return false;
+      }
+      // Local items only apply to the next main item
+      usageMinimum = 0;
+      hasUsageMinimum = false;
+
+    } else if (type == HID_ITEM_GLOBAL) {
+      switch (tag) {
+        case HID_GLOBAL_USAGE_PAGE:
+          global.usagePage = value;
+          break;
+        case HID_GLOBAL_REPORT_SIZE:
+          if (value == 0 || value > 32) {
+            error = "Report Size must be 1-32 at offset " + String(offset);
+            return false;
+          }
+          global.reportSize = value;
+          break;
+        case HID_GLOBAL_REPORT_ID:
+          if (value == 0 || value > 255) {
+            error = "Report ID must be 1-255 at offset " + String(offset);
+            return false;
+          }
+          if (mainWithoutId) {
+            error = "Report ID at offset " + String(offset) + " follows items without report ID";
+            return false;
+          }
+          usesReportIds = true;
+          global.reportId = value;
+          break;
+        case HID_GLOBAL_REPORT_COUNT:
+          if (value == 0 || value > 255) {
+            error = "Report Count must be 1-255 at offset " + String(offset);
+            return false;
+          }
+          global.reportCount = value;
+          break;
+        case HID_GLOBAL_PUSH:
+          if (stackDepth >= HID_GLOBAL_STACK_DEPTH) {
+            error = "Push nested too deep at offset " + String(offset);
+            return false;
+          }
+          stack[stackDepth++] = global;
+          break;
+        case HID_GLOBAL_POP:
+          if (stackDepth == 0) {
+            error = "Pop without Push at offset " + String(offset);
+            return false;
+          }
+          global = stack[--stackDepth];
+          break;
+        default:
+          if (tag > HID_GLOBAL_POP) {
+            error = "Reserved global item at offset " + String(offset);
+            return false;
+          }
+          break;   // Logical/physical ranges and units do not affect the layout
+      }
+
+    } else if (type == HID_ITEM_LOCAL) {
+      if (tag == HID_LOCAL_USAGE_MINIMUM) {
+        usageMinimum = size == 4 ? value : value & 0xFFFF;
+        hasUsageMinimum = true;
+      }
+
+    } else {
+      error = "Reserved item type at offset " + String(offset);
+      return false;
+    }
+  }
+
+  if (depth != 0) {
+    error = "Collection not closed";
+    return false;
+  }
+  if (stackDepth != 0) {
+    error = "Push without Pop";
+    return false;
+  }
+  for (size_t i = 0; i < reportCount; i++) {
+    if (reports[i].inputBits % 8 != 0 || reports[i].outputBits % 8 != 0) {
+      error = "Report " + String(reports[i].id) + " is not a whole number of bytes";
+      return false;
+    }
+    if (layout.hasKeyboard && reports[i].id == layout.keyboardId) {
+      layout.keyboardLength = reports[i].inputBits / 8;
+    }
+    if (layout.hasConsumer && reports[i].id == layout.consumerId) {
+      layout.consumerLength = reports[i].inputBits / 8;
+    }
+  }
+  if (!layout.hasKeyboard && !layout.hasConsumer) {
+    error = "No keyboard or consumer usage array in an input report";
+    return false;
+  }
+  if (layout.hasKeyboard && layout.hasConsumer && layout.keyboardId == layout.consumerId) {
+    error = "Keyboard and consumer usages must be in separate reports";
+    return false;
+  }
+  if (!layout.hasKeyboard || modifiersId != layout.keyboardId) {
+    layout.modifiers = {};   // Modifier bits are only written into the keyboard report
+  }
+  return true;
+}
@@ -0,0 +1,264 @@
+#ifndef HID_DESCRIPTOR_H
+#define HID_DESCRIPTOR_H
+
+#include <Arduino.h>
+#include <array>
+
+#define HID_DESCRIPTOR_MAX_LENGTH 512
+#define HID_REPORT_MAX_LENGTH 16       // Bytes of one input report, without the report ID
+#define HID_MAX_REPORTS 8              // Distinct report IDs per descriptor
+#define HID_MAX_COLLECTION_DEPTH 8
+#define HID_GLOBAL_STACK_DEPTH 4       // Push/Pop nesting
+#define HID_MAX_REPORT_FIELDS 8        // Input items per report the builder keeps offsets of
+
+// HID item types and tags (HID 1.11, 6.2.2)
+#define HID_ITEM_MAIN 0
+#define HID_ITEM_GLOBAL 1
+#define HID_ITEM_LOCAL 2
+
+#define HID_MAIN_INPUT 0x8
+#define HID_MAIN_OUTPUT 0x9
+#define HID_MAIN_COLLECTION 0xA
+#define HID_MAIN_FEATURE 0xB
+#define HID_MAIN_END_COLLECTION 0xC
+
+#define HID_GLOBAL_USAGE_PAGE 0x0
+#define HID_GLOBAL_LOGICAL_MINIMUM 0x1
+#define HID_GLOBAL_LOGICAL_MAXIMUM 0x2
+#define HID_GLOBAL_REPORT_SIZE 0x7
+#define HID_GLOBAL_REPORT_ID 0x8
+#define HID_GLOBAL_REPORT_COUNT 0x9
+#define HID_GLOBAL_PUSH 0xA
+#define HID_GLOBAL_POP 0xB
+
+#define HID_LOCAL_USAGE 0x0
+#define HID_LOCAL_USAGE_MINIMUM 0x1
+#define HID_LOCAL_USAGE_MAXIMUM 0x2
+
+#define HID_PAGE_GENERIC_DESKTOP 0x01
+#define HID_PAGE_KEYBOARD 0x07
+#define HID_PAGE_LEDS 0x08
+#define HID_PAGE_CONSUMER 0x0C
+
+#define HID_COLLECTION_APPLICATION 0x01
+
+// Main item flags
+#define HID_MAIN_CONSTANT 0x01
+#define HID_MAIN_VARIABLE 0x02
+#define HID_MAIN_PREFERRED 0x20       // Set = No Preferred State
+#define HID_MAIN_NULL_STATE 0x40
+
+// Location of one field in a report, bitSize 0 = not present
+struct HidField {
+  uint16_t bitOffset;
+  uint8_t bitSize;
+  uint8_t count;
+};
+
+/**
+ * @brief Where the simulator writes keys into the input reports.
+ *
+ * Derived from a report descriptor: the keyboard report is the input report
+ * with a keyboard usage array, optionally with the 8 modifier bits (usages
+ * 0xE0-0xE7), the consumer report the one with a consumer usage array.
+ * Reports without a report ID use ID 0.
+ */
+struct HidReportLayout {
+  bool hasKeyboard;
+  uint8_t keyboardId;
+  uint8_t keyboardLength;   // Bytes
+  HidField modifiers;
+  HidField keys;
+  bool hasOutput;           // Keyboard LED output report
+  uint8_t outputId;
+  bool hasConsumer;
+  uint8_t consumerId;
+  uint8_t consumerLength;
+  HidField consumer;
+
+  // Both write a complete report of keyboardLength / consumerLength bytes
+  void packKeyboard(uint8_t modifierBits, const uint8_t keyCodes[6], uint8_t* out) const;
+  void packConsumer(uint16_t first, uint16_t second, uint8_t* out) const;
+};
+
+/**
+ * @brief Validating parser for HID report descriptors (short items only).
+ *
+ * Checks item boundaries, collection nesting, Push/Pop balance and report
+ * sizes, then derives the report layout. Returns false with a readable
+ * error if the descriptor cannot be used.
+ */
+class HidDescriptorParser {
+public:
+  static bool parse(const uint8_t* data, size_t length, HidReportLayout& layout, String& error);
+
+private:
+  struct GlobalState {
+    uint16_t usagePage;
+    uint8_t reportSize;
+    uint8_t reportId;
+    uint8_t reportCount;
+  };
+
+  struct ReportBits {
+    uint8_t id;
+    uint32_t inputBits;    // 255 items of 32 x 255 bits must not wrap
+    uint32_t outputBits;
+  };
+
+  static ReportBits* findReport(ReportBits* reports, size_t& count, uint8_t id);
+};
+
+/**
+ * @brief Compile-time builder for report descriptors.
+ *
+ * Every call appends one short item, using the smallest width that holds
+ * the value as unsigned number (like the hand-written descriptors did, so
+ * Logical Maximum 255 is one 0xFF byte). While building it sums up the bits
+ * of every report, so the report structs can be checked with static_assert
+ * against inputBits() and inputOffset(). Malformed input makes isValid() false.
+ */
+class HidDescriptorBuilder {
+public:
+  constexpr HidDescriptorBuilder& usagePage(uint16_t page) { return item(HID_ITEM_GLOBAL, HID_GLOBAL_USAGE_PAGE, page); }
+  constexpr HidDescriptorBuilder& logicalMinimum(uint16_t value) { return item(HID_ITEM_GLOBAL, HID_GLOBAL_LOGICAL_MINIMUM, value); }
+  constexpr HidDescriptorBuilder& logicalMaximum(uint16_t value) { return item(HID_ITEM_GLOBAL, HID_GLOBAL_LOGICAL_MAXIMUM, value); }
+  constexpr HidDescriptorBuilder& usage(uint16_t usage) { return item(HID_ITEM_LOCAL, HID_LOCAL_USAGE, usage); }
+  constexpr HidDescriptorBuilder& usageMinimum(uint16_t usage) { return item(HID_ITEM_LOCAL, HID_LOCAL_USAGE_MINIMUM, usage); }
+  constexpr HidDescriptorBuilder& usageMaximum(uint16_t usage) { return item(HID_ITEM_LOCAL, HID_LOCAL_USAGE_MAXIMUM, usage); }
+
+  constexpr HidDescriptorBuilder& reportSize(uint8_t bits) {
+    reportSizeBits = bits;
+    return item(HID_ITEM_GLOBAL, HID_GLOBAL_REPORT_SIZE, bits);
+  }
+
+  constexpr HidDescriptorBuilder& reportCount(uint8_t count) {
+    reportCountValue = count;
+    return item(HID_ITEM_GLOBAL, HID_GLOBAL_REPORT_COUNT, count);
+  }
+
+  constexpr HidDescriptorBuilder& reportId(uint8_t id) {
+    valid &= id != 0;
+    currentReport = report(id);
+    return item(HID_ITEM_GLOBAL, HID_GLOBAL_REPORT_ID, id);
+  }
+
+  constexpr HidDescriptorBuilder& collection(uint8_t type) {
+    depth++;
+    return item(HID_ITEM_MAIN, HID_MAIN_COLLECTION, type);
+  }
+
+  constexpr HidDescriptorBuilder& endCollection() {
+    valid &= depth > 0;
+    depth--;
+    return item(HID_ITEM_MAIN, HID_MAIN_END_COLLECTION, 0, 0);
+  }
+
+  constexpr HidDescriptorBuilder& input(uint8_t flags) {
+    valid &= reportSizeBits > 0 && reportCountValue > 0 && currentReport < HID_MAX_REPORTS;
+    if (valid) {
+      Report& r = reports[currentReport];
+      valid &= r.inputFields < HID_MAX_REPORT_FIELDS;
+      if (valid) {
+        r.fieldOffsets[r.inputFields++] = r.inputBits;
+      }
+      r.inputBits += reportSizeBits * reportCountValue;
+    }
+    return item(HID_ITEM_MAIN, HID_MAIN_INPUT, flags);
+  }
+
+  constexpr HidDescriptorBuilder& output(uint8_t flags) {
+    valid &= reportSizeBits > 0 && reportCountValue > 0 && currentReport < HID_MAX_REPORTS;
+    if (valid) {
+      reports[currentReport].outputBits += reportSizeBits * reportCountValue;
+    }
+    return item(HID_ITEM_MAIN, HID_MAIN_OUTPUT, flags);
+  }
+
+  // Closed collections, no overflow, whole-byte reports
+  constexpr bool isValid() const {
+    bool ok = valid && depth == 0;
+    for (size_t i = 0; i < reportTotal; i++) {
+      ok &= reports[i].inputBits % 8 == 0 && reports[i].outputBits % 8 == 0;
+    }
+    return ok;
+  }
+
+  constexpr size_t length() const { return size; }
+  constexpr uint16_t inputBits(uint8_t id) const { return findConst(id) ? findConst(id)->inputBits : 0; }
+  constexpr uint16_t outputBits(uint8_t id) const { return findConst(id) ? findConst(id)->outputBits : 0; }
+
+  // Bit offset of the n-th Input item of a report
+  constexpr uint16_t inputOffset(uint8_t id, size_t field) const {
+    return findConst(id) && field < findConst(id)->inputFields ? findConst(id)->fieldOffsets[field] : UINT16_MAX;
+  }
+
+  // Descriptor bytes trimmed to N = length()
+  template <size_t N>
+  constexpr std::array<uint8_t, N> bytes() const {
+    std::array<uint8_t, N> out = {};
+    for (size_t i = 0; i < N && i < size; i++) {
+      out[i] = data[i];
+    }
+    return out;
+  }
+
+private:
+  struct Report {
+    uint8_t id = 0;
+    uint16_t inputBits = 0;
+    uint16_t outputBits = 0;
+    uint8_t inputFields = 0;
+    uint16_t fieldOffsets[HID_MAX_REPORT_FIELDS] = {};
+  };
+
+  uint8_t data[HID_DESCRIPTOR_MAX_LENGTH] = {};
+  size_t size = 0;
+  Report reports[HID_MAX_REPORTS] = {};
+  size_t reportTotal = 1;           // Slot 0 collects the items before the first Report ID
+  size_t currentReport = 0;
+  uint8_t reportSizeBits = 0;
+  uint8_t reportCountValue = 0;
+  size_t depth = 0;
+  bool valid = true;
+
+  constexpr HidDescriptorBuilder& item(uint8_t type, uint8_t tag, uint32_t value) {
+    return item(type, tag, value, value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : 4);
+  }
+
+  constexpr HidDescriptorBuilder& item(uint8_t type, uint8_t tag, uint32_t value, uint8_t width) {
+    valid &= size + 1 + width <= HID_DESCRIPTOR_MAX_LENGTH;
+    if (!valid) {
+      return *this;
+    }
+    data[size++] = (tag << 4) | (type << 2) | (width == 4 ? 3 : width);
+    for (uint8_t i = 0; i < width; i++) {
+      data[size++] = (value >> (8 * i)) & 0xFF;
+    }
+    return *this;
+  }
+
+  constexpr size_t report(uint8_t id) {
+    for (size_t i = 1; i < reportTotal; i++) {
+      if (reports[i].id == id) {
+        return i;
+      }
+    }
+    if (reportTotal >= HID_MAX_REPORTS) {
+      return HID_MAX_REPORTS;
+    }
+    reports[reportTotal].id = id;
+    return reportTotal++;
+  }
+
+  constexpr const Report* findConst(uint8_t id) const {
+    for (size_t i = 0; i < reportTotal; i++) {
+      if (reports[i].id == id && (id != 0 || i == 0)) {
+        return &reports[i];
+      }
+    }
+    return nullptr;
+  }
+};
+
+#endif // HID_DESCRIPTOR_H
@@ -0,0 +1,151 @@
+#include "jsonwriter.h"
+#include <math.h>
+
+// Separator and key in front of every value
+void JsonWriter::beginValue(const char* key) {
+  if (depth > 0) {
+    uint32_t bit = 1UL << (depth - 1);
+    if (hasMembers & bit) {
+      out.write(',');
+    }
+    hasMembers |= bit;
+  }
+  if (key != nullptr) {
+    writeString(key);
+    out.write(':');
+  }
+}
+
+JsonWriter& JsonWriter::beginObject(const char* key) {
+  beginValue(key);
+  out.write('{');
+  if (depth < JSON_WRITER_MAX_DEPTH) {
+    depth++;
+    hasMembers &= ~(1UL << (depth - 1));
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+  out.write('}');
+  if (depth > 0) {
+    depth--;
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(const char* key) {
+  beginValue(key);
+  out.write('[');
+  if (depth < JSON_WRITER_MAX_DEPTH) {
+    depth++;
+    hasMembers &= ~(1UL << (depth - 1));
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+  out.write(']');
+  if (depth > 0) {
+    depth--;
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::add(const char* key, const char* value) {
+  beginValue(key);
+  if (value == nullptr) {
+    out.print("null");
+  } else {
+    writeString(value);
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::add(const char* key, bool value) {
+  beginValue(key);
+  out.print(value ? "true" : "false");
+  return *this;
+}
+
+JsonWriter& JsonWriter::add(const char* key, long long value) {
+  beginValue(key);
+  char text[24];
+  snprintf(text, sizeof(text), "%lld", value);
+  out.print(text);
+  return *this;
+}
+
+JsonWriter& JsonWriter::add(const char* key, unsigned long long value) {
+  beginValue(key);
+  char text[24];
+  snprintf(text, sizeof(text), "%llu", value);
+  out.print(text);
+  return *this;
+}
+
+// 7 significant digits, the values are floats (intervals, rates)
+JsonWriter& JsonWriter::add(const char* key, double value) {
+  if (isnan(value) || isinf(value)) {
+    return addNull(key);
+  }
+  beginValue(key);
+  char text[24];
+  snprintf(text, sizeof(text), "%.7g", value);
+  out.print(text);
+  return *this;
+}
+
+JsonWriter& JsonWriter::addNull(const char* key) {
+  beginValue(key);
+  out.print("null");
+  return *this;
+}
+
+JsonWriter& JsonWriter::addHex(const char* key, uint32_t value) {
+  beginValue(key);
+  char text[16];
+  snprintf(text, sizeof(text), "\"0x%lx\"", (unsigned long)value);
+  out.print(text);
+  return *this;
+}
+
+JsonWriter& JsonWriter::addHexBytes(const char* key, const uint8_t* data, size_t length) {
+  static const char digits[] = "0123456789ABCDEF";
+  beginValue(key);
+  out.write('"');
+  for (size_t i = 0; i < length; i++) {
+    out.write(digits[data[i] >> 4]);
+    out.write(digits[data[i] & 0x0F]);
+  }
+  out.write('"');
+  return *this;
+}
+
+// Runs of plain characters are written in one call
+void JsonWriter::writeString(const char* value) {
+  out.write('"');
+  const char* run = value;
+  for (const char* p = value; *p != '\0'; p++) {
+    unsigned char c = (unsigned char)*p;
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    out.write((const uint8_t*)run, p - run);
+    run = p + 1;
+    switch (c) {
+      case '"':  out.print("\\\""); break;
+      case '\\': out.print("\\\\"); break;
+      case '\n': out.print("\\n"); break;
+      case '\r': out.print("\\r"); break;
+      case '\t': out.print("\\t"); break;
+      default: {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out.print(escaped);
+      }
+    }
+  }
+  out.write((const uint8_t*)run, strlen(run));
+  out.write('"');
+}
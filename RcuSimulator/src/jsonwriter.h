@@ -0,0 +1,53 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <Arduino.h>
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+/**
+ * @brief Writes JSON directly to a Print, e.g. an AsyncResponseStream.
+ *
+ * Responses are serialized field by field into the response buffer, there is
+ * no document on the stack and no intermediate String. The key is ignored
+ * (pass nullptr) for values inside an array. Strings are escaped, numbers
+ * that are not finite are written as null.
+ *
+ *   JsonWriter json(*response);
+ *   json.beginObject().add("status", "success").add("requestId", id).endObject();
+ */
+class JsonWriter {
+public:
+  explicit JsonWriter(Print& out) : out(out) {}
+
+  JsonWriter& beginObject(const char* key = nullptr);
+  JsonWriter& endObject();
+  JsonWriter& beginArray(const char* key = nullptr);
+  JsonWriter& endArray();
+
+  JsonWriter& add(const char* key, const char* value);
+  JsonWriter& add(const char* key, const String& value) { return add(key, value.c_str()); }
+  JsonWriter& add(const char* key, bool value);
+  JsonWriter& add(const char* key, int value) { return add(key, (long long)value); }
+  JsonWriter& add(const char* key, unsigned int value) { return add(key, (unsigned long long)value); }
+  JsonWriter& add(const char* key, long value) { return add(key, (long long)value); }
+  JsonWriter& add(const char* key, unsigned long value) { return add(key, (unsigned long long)value); }
+  JsonWriter& add(const char* key, long long value);
+  JsonWriter& add(const char* key, unsigned long long value);
+  JsonWriter& add(const char* key, double value);
+  JsonWriter& addNull(const char* key);
+  // "0x" followed by lowercase hex digits, the format of the config API
+  JsonWriter& addHex(const char* key, uint32_t value);
+  // Bytes as one string of uppercase hex pairs, without a copy of the data
+  JsonWriter& addHexBytes(const char* key, const uint8_t* data, size_t length);
+
+private:
+  Print& out;
+  uint8_t depth = 0;
+  uint32_t hasMembers = 0;   // Bit n: the container at depth n already has a member
+
+  void beginValue(const char* key);
+  void writeString(const char* value);
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,358 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//  Keyboard
+#define KEY_LEFT_CTRL     0x80
+#define KEY_LEFT_SHIFT    0x81
+#define KEY_LEFT_ALT      0x82
+#define KEY_LEFT_GUI      0x83
+#define KEY_RIGHT_CTRL    0x84
+#define KEY_RIGHT_SHIFT   0x85
+#define KEY_RIGHT_ALT     0x86
+#define KEY_RIGHT_GUI     0x87
+
+#define KEY_UP_ARROW      0xDA
+#define KEY_DOWN_ARROW    0xD9
+#define KEY_LEFT_ARROW    0xD8
+#define KEY_RIGHT_ARROW   0xD7
+#define KEY_BACKSPACE     0xB2
+#define KEY_TAB           0xB3
+#define KEY_RETURN        0xB0
+#define KEY_ESC           0xB1
+#define KEY_INSERT        0xD1
+#define KEY_DELETE        0xD4
+#define KEY_PAGE_UP       0xD3
+#define KEY_PAGE_DOWN     0xD6
+#define KEY_HOME          0xD2
+#define KEY_END           0xD5
+#define KEY_CAPS_LOCK     0xC1
+#define KEY_F1            0xC2
+#define KEY_F2            0xC3
+#define KEY_F3            0xC4
+#define KEY_F4            0xC5
+#define KEY_F5            0xC6
+#define KEY_F6            0xC7
+#define KEY_F7            0xC8
+#define KEY_F8            0xC9
+#define KEY_F9            0xCA
+#define KEY_F10           0xCB
+#define KEY_F11           0xCC
+#define KEY_F12           0xCD
+#define KEY_F13           0xF0
+#define KEY_F14           0xF1
+#define KEY_F15           0xF2
+#define KEY_F16           0xF3
+#define KEY_F17           0xF4
+#define KEY_F18           0xF5
+#define KEY_F19           0xF6
+#define KEY_F20           0xF7
+#define KEY_F21           0xF8
+#define KEY_F22           0xF9
+#define KEY_F23           0xFA
+#define KEY_F24           0xFB
+#define KEY_PRINT_SCREEN  0xCE
+#define KEY_SCROLL_LOCK   0xCF
+#define KEY_PAUSE         0xD0
+
+ 
+// Consumer Control Keys (updated to match analyzed descriptor)
+// Values must be within 1-1023 range as per descriptor
+#define KEY_MEDIA_PROGRAM           0x0007
+#define KEY_MEDIA_PREVIOUS_CHANNEL  0x0201
+#define KEY_MEDIA_MUTE              0x00E2
+#define KEY_MEDIA_VOL_UP            0x00E9
+#define KEY_MEDIA_VOL_DOWN          0x00EA
+#define KEY_MEDIA_PLAY_PAUSE        0x00CD
+#define KEY_MEDIA_NEXT              0x00B5
+#define KEY_MEDIA_PREVIOUS          0x00B6
+#define KEY_MEDIA_STOP              0x00B7
+#define KEY_MEDIA_FAST_FORWARD      0x00B3
+#define KEY_MEDIA_REWIND            0x00B4
+#define KEY_MEDIA_RECORD            0x00B2
+#define KEY_MEDIA_MENU              0x0040
+#define KEY_MEDIA_HOME              0x0223
+#define KEY_MEDIA_BACK              0x0224
+#define KEY_MEDIA_OK                0x0041
+#define KEY_MEDIA_UP                0x0042
+#define KEY_MEDIA_DOWN              0x0043
+#define KEY_MEDIA_LEFT              0x0044
+#define KEY_MEDIA_RIGHT             0x0045
+#define KEY_MEDIA_CHANNEL_UP        0x009C
+#define KEY_MEDIA_CHANNEL_DOWN      0x009D
+#define KEY_MEDIA_POWER             0x0030
+#define KEY_MEDIA_TV                0x001C
+#define KEY_MEDIA_ASSISTANT         0x0221
+#define KEY_MEDIA_APP_NETFLIX       0x000A
+#define KEY_MEDIA_APP_WAIPUTHEK     0x00D2
+// Structure for key mapping
+struct KeyMapping {
+  const char* name;
+  uint8_t keyCode;
+};
+
+// Structure for media key mapping
+struct MediaKeyMapping {
+  const char* name;
+  uint16_t keyCode;  // Using uint16_t for media keys
+};
+
+// Mapping from string names to regular keycodes
+inline constexpr KeyMapping keyMappings[] = {
+  {"up", KEY_UP_ARROW},
+  {"down", KEY_DOWN_ARROW},
+  {"left", KEY_LEFT_ARROW},
+  {"right", KEY_RIGHT_ARROW},
+  {"enter", KEY_RETURN},
+  {"return", KEY_RETURN},
+  {"esc", KEY_ESC},
+  {"escape", KEY_ESC},
+  {"backspace", KEY_BACKSPACE},
+  {"tab", KEY_TAB},
+  {"space", ' '},
+  {"ctrl", KEY_LEFT_CTRL},
+  {"alt", KEY_LEFT_ALT},
+  {"shift", KEY_LEFT_SHIFT},
+  {"win", KEY_LEFT_GUI},
+  {"gui", KEY_LEFT_GUI},
+  {"insert", KEY_INSERT},
+  {"delete", KEY_DELETE},
+  {"del", KEY_DELETE},
+  {"home", KEY_HOME},
+  {"end", KEY_END},
+  {"pageup", KEY_PAGE_UP},
+  {"pagedown", KEY_PAGE_DOWN},
+  {"capslock", KEY_CAPS_LOCK},
+  {"f1", KEY_F1},
+  {"f2", KEY_F2},
+  {"f3", KEY_F3},
+  {"f4", KEY_F4},
+  {"f5", KEY_F5},
+  {"f6", KEY_F6},
+  {"f7", KEY_F7},
+  {"f8", KEY_F8},
+  {"f9", KEY_F9},
+  {"f10", KEY_F10},
+  {"f11", KEY_F11},
+  {"f12", KEY_F12},
+  {"printscreen", KEY_PRINT_SCREEN},
+  {"scrolllock", KEY_SCROLL_LOCK},
+  {"pause", KEY_PAUSE}
+};
+
+// Mapping from string names to media keycodes (updated for analyzed descriptor)
+inline constexpr MediaKeyMapping mediaKeyMappings[] = {
+  {"program", KEY_MEDIA_PROGRAM},
+  {"chprev", KEY_MEDIA_PREVIOUS_CHANNEL},
+  {"power", KEY_MEDIA_POWER},
+  {"tv", KEY_MEDIA_TV},
+  {"menu", KEY_MEDIA_MENU},
+  {"ok", KEY_MEDIA_OK},
+  {"mkup", KEY_MEDIA_UP},
+  {"mkdown", KEY_MEDIA_DOWN},
+  {"mkleft", KEY_MEDIA_LEFT},
+  {"mkright", KEY_MEDIA_RIGHT},
+  {"chup", KEY_MEDIA_CHANNEL_UP},
+  {"chdown", KEY_MEDIA_CHANNEL_DOWN},
+  {"rewind", KEY_MEDIA_REWIND},
+  {"record", KEY_MEDIA_RECORD},
+  {"ff", KEY_MEDIA_FAST_FORWARD},
+  {"next", KEY_MEDIA_NEXT},
+  {"previous", KEY_MEDIA_PREVIOUS},
+  {"playpause", KEY_MEDIA_PLAY_PAUSE},
+  {"stop", KEY_MEDIA_STOP},
+  {"assistant", KEY_MEDIA_ASSISTANT},
+  {"back", KEY_MEDIA_BACK},
+  {"home", KEY_MEDIA_HOME},
+  {"volup", KEY_MEDIA_VOL_UP},
+  {"voldown", KEY_MEDIA_VOL_DOWN},
+  {"mute", KEY_MEDIA_MUTE},
+  {"netflix", KEY_MEDIA_APP_NETFLIX},
+  {"waiputhek", KEY_MEDIA_APP_WAIPUTHEK}
+};
+constexpr int NUM_KEY_MAPPINGS = sizeof(keyMappings) / sizeof(KeyMapping);
+constexpr int NUM_MEDIA_KEY_MAPPINGS = sizeof(mediaKeyMappings) / sizeof(MediaKeyMapping);
+
+/**
+ * @brief Resolved key identifier.
+ *
+ * Key names are resolved once at the API boundary; the send path only works
+ * with this two-byte code and never touches the name again.
+ */
+struct KeyId {
+  enum Kind : uint8_t { KIND_NONE = 0, KIND_KEYBOARD, KIND_MEDIA };
+
+  Kind kind;
+  uint16_t code;  // ASCII/special key code for KIND_KEYBOARD, consumer usage for KIND_MEDIA
+
+  constexpr KeyId() : kind(KIND_NONE), code(0) {}
+  constexpr KeyId(Kind kind, uint16_t code) : kind(kind), code(code) {}
+
+  constexpr bool isValid() const { return kind != KIND_NONE; }
+  constexpr bool isMedia() const { return kind == KIND_MEDIA; }
+  constexpr bool operator==(const KeyId& other) const { return kind == other.kind && code == other.code; }
+  constexpr bool operator!=(const KeyId& other) const { return !(*this == other); }
+};
+
+// Compile-time perfect hash over keyMappings[] and mediaKeyMappings[] (hash and displace).
+// A first hash selects a bucket, each bucket stores the seed of a second hash that maps
+// all of its names to distinct slots. The seeds are searched by the compiler.
+namespace keymap_detail {
+
+constexpr size_t TABLE_SIZE = 128;   // Power of two, roughly 2x the number of names
+constexpr size_t BUCKET_COUNT = 32;
+constexpr size_t MAX_NAME_LENGTH = 16;
+
+constexpr char toLower(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// FNV-1a over the lower-cased name
+constexpr uint32_t hashName(const char* name, size_t len, uint32_t seed) {
+  uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+  for (size_t i = 0; i < len; i++) {
+    h ^= static_cast<uint8_t>(toLower(name[i]));
+    h *= 16777619u;
+  }
+  return h;
+}
+
+constexpr size_t nameLength(const char* name) {
+  size_t len = 0;
+  while (name[len] != '\0') len++;
+  return len;
+}
+
+constexpr bool equalsIgnoreCase(const char* tableName, const char* name, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (tableName[i] == '\0' || tableName[i] != toLower(name[i])) return false;
+  }
+  return tableName[len] == '\0';
+}
+
+struct Slot {
+  const char* name;
+  KeyId id;
+};
+
+struct Table {
+  uint8_t seeds[BUCKET_COUNT];
+  Slot slots[TABLE_SIZE];
+  bool valid;
+};
+
+constexpr size_t bucketOf(const char* name, size_t len) {
+  return hashName(name, len, 0) % BUCKET_COUNT;
+}
+
+constexpr size_t slotOf(const char* name, size_t len, uint32_t seed) {
+  return hashName(name, len, seed) & (TABLE_SIZE - 1);
+}
+
+constexpr Table buildTable() {
+  Table table{};
+  Slot entries[NUM_MEDIA_KEY_MAPPINGS + NUM_KEY_MAPPINGS]{};
+  size_t count = 0;
+
+  // Media keys take precedence over keyboard keys with the same name (e.g. "home")
+  for (int i = 0; i < NUM_MEDIA_KEY_MAPPINGS; i++) {
+    entries[count++] = Slot{mediaKeyMappings[i].name, KeyId(KeyId::KIND_MEDIA, mediaKeyMappings[i].keyCode)};
+  }
+  for (int i = 0; i < NUM_KEY_MAPPINGS; i++) {
+    const char* name = keyMappings[i].name;
+    bool duplicate = false;
+    for (size_t j = 0; j < count; j++) {
+      if (equalsIgnoreCase(entries[j].name, name, nameLength(name))) duplicate = true;
+    }
+    if (!duplicate) {
+      entries[count++] = Slot{name, KeyId(KeyId::KIND_KEYBOARD, keyMappings[i].keyCode)};
+    }
+  }
+
+  // Place the fullest buckets first, they are the hardest to fit
+  size_t bucketSize[BUCKET_COUNT]{};
+  size_t order[BUCKET_COUNT]{};
+  for (size_t i = 0; i < count; i++) {
+    bucketSize[bucketOf(entries[i].name, nameLength(entries[i].name))]++;
+  }
+  for (size_t b = 0; b < BUCKET_COUNT; b++) order[b] = b;
+  for (size_t i = 0; i < BUCKET_COUNT; i++) {
+    for (size_t j = i + 1; j < BUCKET_COUNT; j++) {
+      if (bucketSize[order[j]] > bucketSize[order[i]]) {
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+      }
+    }
+  }
+
+  bool occupied[TABLE_SIZE]{};
+  table.valid = true;
+  for (size_t o = 0; o < BUCKET_COUNT && bucketSize[order[o]] > 0; o++) {
+    size_t bucket = order[o];
+    bool placed = false;
+    for (uint32_t seed = 1; seed < 256 && !placed; seed++) {
+      size_t candidate[TABLE_SIZE]{};
+      size_t n = 0;
+      bool fits = true;
+      for (size_t i = 0; i < count && fits; i++) {
+        size_t len = nameLength(entries[i].name);
+        if (bucketOf(entries[i].name, len) != bucket) continue;
+        size_t slot = slotOf(entries[i].name, len, seed);
+        if (occupied[slot]) fits = false;
+        for (size_t k = 0; k < n && fits; k++) {
+          if (candidate[k] == slot) fits = false;
+        }
+        candidate[n++] = slot;
+      }
+      if (!fits) continue;
+      for (size_t i = 0; i < count; i++) {
+        size_t len = nameLength(entries[i].name);
+        if (bucketOf(entries[i].name, len) != bucket) continue;
+        size_t slot = slotOf(entries[i].name, len, seed);
+        occupied[slot] = true;
+        table.slots[slot] = entries[i];
+      }
+      table.seeds[bucket] = static_cast<uint8_t>(seed);
+      placed = true;
+    }
+    if (!placed) table.valid = false;
+  }
+  return table;
+}
+
+inline constexpr Table keyTable = buildTable();
+static_assert(keyTable.valid, "No perfect hash seed found for the key mappings, grow TABLE_SIZE");
+
+} // namespace keymap_detail
+
+/**
+ * @brief Resolves a key name (case-insensitive) or a single character to a KeyId.
+ *
+ * Single characters map to their ASCII code, names are looked up with one
+ * string compare. Returns an invalid KeyId for unknown names.
+ */
+constexpr KeyId resolveKeyName(const char* name, size_t len) {
+  using namespace keymap_detail;
+  if (len == 0) return KeyId();
+  if (len == 1) return KeyId(KeyId::KIND_KEYBOARD, static_cast<uint8_t>(name[0]));
+  if (len > MAX_NAME_LENGTH) return KeyId();
+
+  uint8_t seed = keyTable.seeds[bucketOf(name, len)];
+  if (seed == 0) return KeyId();
+  const Slot& slot = keyTable.slots[slotOf(name, len, seed)];
+  if (slot.name == nullptr || !equalsIgnoreCase(slot.name, name, len)) return KeyId();
+  return slot.id;
+}
+
+constexpr KeyId resolveKeyName(const char* name) {
+  return name == nullptr ? KeyId() : resolveKeyName(name, keymap_detail::nameLength(name));
+}
+
+static_assert(resolveKeyName("OK") == KeyId(KeyId::KIND_MEDIA, KEY_MEDIA_OK), "Key lookup must be case-insensitive");
+static_assert(resolveKeyName("home").isMedia(), "Media keys take precedence over keyboard keys");
+static_assert(!resolveKeyName("nokey").isValid(), "Unknown names must not resolve");
+
+#endif // KEYMAP_H
@@ -0,0 +1,290 @@
+#include "keyrecorder.h"
+#include <LittleFS.h>
+#include "esp_timer.h"
+
+static void writeLe32(uint8_t* out, uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    out[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+static uint32_t readLe32(const uint8_t* data) {
+  return data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static size_t payloadLength(uint8_t type) {
+  switch (type) {
+    case KEY_REC_PRESS:
+    case KEY_REC_RELEASE:
+      return 1;
+    case KEY_REC_MEDIA:
+      return 4;
+    case KEY_REC_REPORT:
+      return 8;
+    case KEY_REC_RELEASE_ALL:
+      return 0;
+    default:
+      return SIZE_MAX;
+  }
+}
+
+bool KeyRecorder::begin() {
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == nullptr) {
+      return false;
+    }
+  }
+  writeHeader();
+  mounted = LittleFS.begin(true);   // Formats the partition on first use
+  if (!mounted) {
+    Serial.println("Key recorder: failed to mount LittleFS, recordings are not persisted");
+    return false;
+  }
+  load();
+  return true;
+}
+
+bool KeyRecorder::start() {
+  if (mutex == nullptr) {
+    return false;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  length = KEY_RECORDER_HEADER_LENGTH;
+  eventCount = 0;
+  durationUs = 0;
+  lastEventAt = esp_timer_get_time();   // The first delta is the time from start to the first key
+  truncated = false;
+  recording = true;
+  xSemaphoreGive(mutex);
+  return true;
+}
+
+void KeyRecorder::loop() {
+  if (mutex == nullptr || !savePending.exchange(false)) {
+    return;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  save();
+  xSemaphoreGive(mutex);
+}
+
+bool KeyRecorder::stop() {
+  if (mutex == nullptr || (!recording && !savePending)) {
+    return false;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  recording = false;
+  savePending = false;
+  writeHeader();
+  bool saved = save();
+  xSemaphoreGive(mutex);
+  return saved;
+}
+
+void KeyRecorder::recordKey(KeyRecordType type, uint8_t code) {
+  append(type, &code, 1);
+}
+
+void KeyRecorder::recordMedia(uint16_t first, uint16_t second) {
+  const uint8_t payload[4] = {
+    (uint8_t)(first & 0xFF), (uint8_t)(first >> 8), (uint8_t)(second & 0xFF), (uint8_t)(second >> 8)
+  };
+  append(KEY_REC_MEDIA, payload, sizeof(payload));
+}
+
+void KeyRecorder::recordReport(const uint8_t report[8]) {
+  append(KEY_REC_REPORT, report, 8);
+}
+
+void KeyRecorder::recordReleaseAll() {
+  append(KEY_REC_RELEASE_ALL, nullptr, 0);
+}
+
+// Called from the sending task right after a report was queued
+void KeyRecorder::append(KeyRecordType type, const uint8_t* payload, size_t payloadLength) {
+  if (!recording) {
+    return;
+  }
+  int64_t now = esp_timer_get_time();
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (!recording) {
+    xSemaphoreGive(mutex);
+    return;
+  }
+  uint32_t delta = (uint32_t)(now - lastEventAt);
+  uint8_t encoded[1 + 5 + 8];
+  size_t pos = 0;
+  encoded[pos++] = type;
+  do {
+    uint8_t byte = delta & 0x7F;
+    delta >>= 7;
+    encoded[pos++] = byte | (delta != 0 ? 0x80 : 0);
+  } while (delta != 0);
+  memcpy(encoded + pos, payload, payloadLength);
+  pos += payloadLength;
+
+  if (length + pos > sizeof(buffer)) {
+    recording = false;   // Keep what fits, a cut-off recording is still replayable
+    truncated = true;
+    writeHeader();
+    savePending = true;   // A flash write here would stall the key timing
+  } else {
+    memcpy(buffer + length, encoded, pos);
+    length += pos;
+    eventCount++;
+    durationUs += now - lastEventAt;
+    lastEventAt = now;
+  }
+  xSemaphoreGive(mutex);
+}
+
+void KeyRecorder::writeHeader() {
+  writeLe32(buffer, KEY_RECORDER_MAGIC);
+  writeLe32(buffer + 4, eventCount);
+}
+
+size_t KeyRecorder::snapshot(uint8_t* out, size_t maxLength) {
+  if (mutex == nullptr) {
+    return 0;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  writeHeader();
+  size_t copied = length <= maxLength ? length : 0;
+  memcpy(out, buffer, copied);
+  xSemaphoreGive(mutex);
+  return copied;
+}
+
+bool KeyRecorder::import(const uint8_t* data, size_t dataLength, String& error) {
+  uint32_t events;
+  uint64_t duration;
+  if (mutex == nullptr || !validate(data, dataLength, events, duration, error)) {
+    return false;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  recording = false;
+  savePending = false;
+  memcpy(buffer, data, dataLength);
+  length = dataLength;
+  eventCount = events;
+  durationUs = duration;
+  truncated = false;
+  bool saved = save();
+  xSemaphoreGive(mutex);
+  if (!saved) {
+    error = "Recording imported but not persisted";
+  }
+  return true;
+}
+
+bool KeyRecorder::next(const uint8_t* data, size_t dataLength, size_t& pos, KeyRecordEvent& event) {
+  if (pos >= dataLength) {
+    return false;
+  }
+  uint8_t type = data[pos++];
+  size_t payload = payloadLength(type);
+  if (payload == SIZE_MAX) {
+    return false;
+  }
+  uint32_t delta = 0;
+  for (uint8_t shift = 0;; shift += 7) {
+    if (pos >= dataLength || shift > 28) {
+      return false;
+    }
+    uint8_t byte = data[pos++];
+    delta |= (uint32_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      break;
+    }
+  }
+  if (pos + payload > dataLength) {
+    return false;
+  }
+  event = {};
+  event.type = (KeyRecordType)type;
+  event.deltaUs = delta;
+  const uint8_t* p = data + pos;
+  switch (type) {
+    case KEY_REC_PRESS:
+    case KEY_REC_RELEASE:
+      event.code = p[0];
+      break;
+    case KEY_REC_MEDIA:
+      event.media[0] = p[0] | (p[1] << 8);
+      event.media[1] = p[2] | (p[3] << 8);
+      break;
+    case KEY_REC_REPORT:
+      memcpy(event.report, p, 8);
+      break;
+  }
+  pos += payload;
+  return true;
+}
+
+bool KeyRecorder::validate(const uint8_t* data, size_t dataLength, uint32_t& events, uint64_t& duration, String& error) {
+  if (dataLength < KEY_RECORDER_HEADER_LENGTH || dataLength > KEY_RECORDER_CAPACITY) {
+    error = "Recording must be " + String(KEY_RECORDER_HEADER_LENGTH) + "-" + String(KEY_RECORDER_CAPACITY) + " bytes";
+    return false;
+  }
+  if (readLe32(data) != KEY_RECORDER_MAGIC) {
+    error = "Not a key recording";
+    return false;
+  }
+  events = 0;
+  duration = 0;
+  size_t pos = KEY_RECORDER_HEADER_LENGTH;
+  KeyRecordEvent event;
+  while (pos < dataLength) {
+    if (!next(data, dataLength, pos, event)) {
+      error = "Malformed event at byte " + String(pos);
+      return false;
+    }
+    events++;
+    duration += event.deltaUs;
+  }
+  if (events != readLe32(data + 4)) {
+    error = "Event count does not match the header";
+    return false;
+  }
+  return true;
+}
+
+bool KeyRecorder::save() {
+  if (!mounted) {
+    return false;
+  }
+  File file = LittleFS.open(KEY_RECORDER_FILE, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+  bool ok = file.write(buffer, length) == length;
+  file.close();
+  return ok;
+}
+
+bool KeyRecorder::load() {
+  File file = LittleFS.open(KEY_RECORDER_FILE, FILE_READ);
+  if (!file) {
+    return false;
+  }
+  size_t fileLength = file.size();
+  bool ok = fileLength <= sizeof(buffer) && file.read(buffer, fileLength) == fileLength;
+  file.close();
+
+  String error;
+  uint32_t events;
+  uint64_t duration;
+  if (!ok || !validate(buffer, fileLength, events, duration, error)) {
+    Serial.println("Key recorder: stored recording ignored: " + error);
+    length = KEY_RECORDER_HEADER_LENGTH;
+    eventCount = 0;
+    durationUs = 0;
+    writeHeader();
+    return false;
+  }
+  length = fileLength;
+  eventCount = events;
+  durationUs = duration;
+  return true;
+}
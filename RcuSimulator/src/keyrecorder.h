@@ -0,0 +1,88 @@
+#ifndef KEY_RECORDER_H
+#define KEY_RECORDER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define KEY_RECORDER_CAPACITY 8192        // Bytes, roughly 2000 key events
+#define KEY_RECORDER_FILE "/recording.bin"
+#define KEY_RECORDER_MAGIC 0x52435231     // "RCR1"
+#define KEY_RECORDER_HEADER_LENGTH 8      // Magic + event count, both little-endian
+
+enum KeyRecordType : uint8_t {
+  KEY_REC_PRESS = 1,          // Keyboard key code as passed to press()
+  KEY_REC_RELEASE,
+  KEY_REC_MEDIA,              // Both consumer usages, 0/0 releases
+  KEY_REC_REPORT,             // Complete keyboard report (typing)
+  KEY_REC_RELEASE_ALL
+};
+
+struct KeyRecordEvent {
+  KeyRecordType type;
+  uint32_t deltaUs;           // Time since the previous event
+  uint8_t code;               // PRESS/RELEASE
+  uint16_t media[2];          // MEDIA
+  uint8_t report[8];          // REPORT, KeyReport layout
+};
+
+/**
+ * @brief Records the key events sent through BleRemoteControl.
+ *
+ * Events are appended to a byte buffer as type, LEB128 time delta in
+ * microseconds and payload (1-9 bytes), so a key press costs 3-5 bytes.
+ * stop() writes the buffer with a small header to a LittleFS file that
+ * export and import use as is; it is loaded again at boot. Recording stops
+ * by itself when the buffer is full; the file is then written by loop() on
+ * the main loop, never from the sending task.
+ */
+class KeyRecorder {
+public:
+  bool begin();
+  void loop();                        // Persists a recording that stopped because the buffer was full
+
+  bool start();
+  bool stop();                        // Also persists the recording
+  bool isRecording() const { return recording; }
+
+  void recordKey(KeyRecordType type, uint8_t code);
+  void recordMedia(uint16_t first, uint16_t second);
+  void recordReport(const uint8_t report[8]);
+  void recordReleaseAll();
+
+  // Copy of the recording in file format, for replay and export. Returns the length.
+  size_t snapshot(uint8_t* out, size_t maxLength);
+  bool import(const uint8_t* data, size_t length, String& error);
+
+  size_t getLength() const { return length; }
+  uint32_t getEventCount() const { return eventCount; }
+  uint64_t getDurationUs() const { return durationUs; }
+  bool isTruncated() const { return truncated; }
+
+  // Decodes the event at pos of a buffer in file format (pos starts at
+  // KEY_RECORDER_HEADER_LENGTH). False at the end or on malformed data.
+  static bool next(const uint8_t* data, size_t length, size_t& pos, KeyRecordEvent& event);
+
+private:
+  uint8_t buffer[KEY_RECORDER_CAPACITY];   // Starts with the header
+  size_t length = KEY_RECORDER_HEADER_LENGTH;
+  uint32_t eventCount = 0;
+  uint64_t durationUs = 0;
+  int64_t lastEventAt = 0;
+  bool recording = false;
+  bool truncated = false;
+  bool mounted = false;
+  std::atomic<bool> savePending{false};
+  SemaphoreHandle_t mutex = nullptr;
+
+  void append(KeyRecordType type, const uint8_t* payload, size_t payloadLength);
+  void writeHeader();
+  bool save();
+  bool load();
+  static bool validate(const uint8_t* data, size_t length, uint32_t& events, uint64_t& durationUs, String& error);
+};
+
+extern KeyRecorder keyRecorder;
+
+#endif // KEY_RECORDER_H
@@ -0,0 +1,513 @@
+#include "keyscheduler.h"
+#include "deferredlog.h"
+
+KeyScheduler::KeyScheduler()
+    : nextId(1), completedId(0), keysSent(0), peakRate(0)
+{
+}
+
+bool KeyScheduler::begin(BleRemoteControl* remote) {
+  if (task != nullptr) {
+    return true;
+  }
+  this->remote = remote;
+
+  queue = xQueueCreate(KEY_SCHEDULER_QUEUE_LENGTH, sizeof(KeyCommand));
+  if (queue == nullptr) {
+    Serial.println("Key scheduler: failed to create queue");
+    return false;
+  }
+
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = &KeyScheduler::timerCallback;
+  timerArgs.arg = this;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "key_hold";
+  if (esp_timer_create(&timerArgs, &timer) != ESP_OK) {
+    Serial.println("Key scheduler: failed to create timer");
+    return false;
+  }
+
+  if (xTaskCreatePinnedToCore(&KeyScheduler::taskEntry, "key_sched", KEY_SCHEDULER_STACK_SIZE,
+                              this, KEY_SCHEDULER_PRIORITY, &task, KEY_SCHEDULER_CORE) != pdPASS) {
+    Serial.println("Key scheduler: failed to create task");
+    task = nullptr;
+    return false;
+  }
+  return true;
+}
+
+uint32_t KeyScheduler::press(KeyId key, uint8_t target, const LatencyTrace* trace) {
+  KeyCommand cmd = {};
+  cmd.type = KEY_CMD_PRESS;
+  cmd.target = target;
+  cmd.key = key;
+  return submit(cmd, trace);
+}
+
+uint32_t KeyScheduler::release(KeyId key, uint8_t target, const LatencyTrace* trace) {
+  KeyCommand cmd = {};
+  cmd.type = KEY_CMD_RELEASE;
+  cmd.target = target;
+  cmd.key = key;
+  return submit(cmd, trace);
+}
+
+uint32_t KeyScheduler::tap(KeyId key, uint32_t holdMs, uint8_t target, const LatencyTrace* trace) {
+  KeyCommand cmd = {};
+  cmd.type = KEY_CMD_TAP;
+  cmd.target = target;
+  cmd.key = key;
+  cmd.holdMs = holdMs;
+  return submit(cmd, trace);
+}
+
+uint32_t KeyScheduler::tapMedia(uint16_t first, uint16_t second, uint32_t holdMs, uint8_t target, const LatencyTrace* trace) {
+  KeyCommand cmd = {};
+  cmd.type = KEY_CMD_MEDIA_TAP;
+  cmd.target = target;
+  cmd.mediaFirst = first;
+  cmd.mediaSecond = second;
+  cmd.holdMs = holdMs;
+  return submit(cmd, trace);
+}
+
+uint32_t KeyScheduler::hold(KeyId key, uint32_t holdMs, const KeyRepeat& repeat, uint8_t target, const LatencyTrace* trace) {
+  if (holdMs > KEY_HOLD_MAX_MS || (repeat.intervalMs > 0 && (repeat.intervalMs < KEY_REPEAT_MIN_INTERVAL_MS ||
+                                                               repeat.delayMs < KEY_REPEAT_MIN_INTERVAL_MS))) {
+    return 0;
+  }
+  KeyCommand cmd = {};
+  cmd.type = KEY_CMD_HOLD;
+  cmd.target = target;
+  cmd.key = key;
+  cmd.holdMs = holdMs;
+  cmd.repeat = repeat;
+  return submit(cmd, trace);
+}
+
+// Repeats that start before the final release
+uint32_t KeyScheduler::countRepeats(uint32_t holdMs, const KeyRepeat& repeat) {
+  if (repeat.intervalMs == 0 || repeat.delayMs >= holdMs) {
+    return 0;
+  }
+  return (holdMs - repeat.delayMs - 1) / repeat.intervalMs + 1;
+}
+
+uint32_t KeyScheduler::releaseAll(uint8_t target) {
+  abortReplay();
+  KeyCommand cmd = {};
+  cmd.type = KEY_CMD_RELEASE_ALL;
+  cmd.target = target;
+  return submit(cmd);
+}
+
+uint32_t KeyScheduler::runSequence(const std::shared_ptr<KeySequence>& sequence) {
+  KeyCommand cmd = {};
+  cmd.type = KEY_CMD_SEQUENCE;
+  cmd.target = sequence->target;
+  cmd.sequence = new std::shared_ptr<KeySequence>(sequence);
+  uint32_t requestId = submit(cmd);
+  if (requestId == 0) {
+    delete cmd.sequence;
+  }
+  return requestId;
+}
+
+uint32_t KeyScheduler::type(const char* text, size_t length, uint32_t holdMs, uint8_t rollover, uint8_t target) {
+  if (length == 0 || length > KEY_TYPE_MAX_LENGTH) {
+    return 0;
+  }
+  KeyCommand cmd = {};
+  cmd.type = KEY_CMD_TYPE;
+  cmd.target = target;
+  cmd.typing = new KeyTypingJob();
+  memcpy(cmd.typing->text, text, length);
+  cmd.typing->length = length;
+  cmd.typing->rollover = rollover;
+  cmd.typing->holdMs = holdMs;
+  uint32_t requestId = submit(cmd);
+  if (requestId == 0) {
+    delete cmd.typing;
+  }
+  return requestId;
+}
+
+uint32_t KeyScheduler::replay(uint16_t scalePercent, uint8_t target) {
+  if (scalePercent < KEY_REPLAY_MIN_SCALE || scalePercent > KEY_REPLAY_MAX_SCALE ||
+      keyRecorder.isRecording() || keyRecorder.getEventCount() == 0) {
+    return 0;
+  }
+  KeyCommand cmd = {};
+  cmd.type = KEY_CMD_REPLAY;
+  cmd.target = target;
+  cmd.replay = new KeyReplayJob();
+  cmd.replay->length = keyRecorder.snapshot(cmd.replay->data, sizeof(cmd.replay->data));
+  cmd.replay->scalePercent = scalePercent;
+  uint32_t requestId = cmd.replay->length > KEY_RECORDER_HEADER_LENGTH ? submit(cmd) : 0;
+  if (requestId == 0) {
+    delete cmd.replay;
+  }
+  return requestId;
+}
+
+// The flag is set before the notification, so waitUntil() either sees it or
+// is woken up by the notification.
+bool KeyScheduler::abortReplay() {
+  if (!replaying.load()) {
+    return false;
+  }
+  replayAborted.store(true);
+  xTaskNotifyGive(task);
+  return true;
+}
+
+uint32_t KeyScheduler::pending() const {
+  return queue != nullptr ? uxQueueMessagesWaiting(queue) : 0;
+}
+
+uint32_t KeyScheduler::submit(KeyCommand& cmd, const LatencyTrace* trace) {
+  if (queue == nullptr) {
+    return 0;
+  }
+  cmd.requestId = nextId.fetch_add(1);
+  if (cmd.requestId == 0) {
+    cmd.requestId = nextId.fetch_add(1); // 0 is reserved for "rejected"
+  }
+  if (cmd.sequence != nullptr) {
+    (*cmd.sequence)->requestId = cmd.requestId;
+  }
+  if (trace != nullptr) {
+    cmd.trace = *trace;
+  }
+  cmd.trace.mark(cmd.trace.submittedAt);
+  if (xQueueSend(queue, &cmd, 0) != pdTRUE) {
+    return 0;
+  }
+  return cmd.requestId;
+}
+
+void KeyScheduler::taskEntry(void* arg) {
+  static_cast<KeyScheduler*>(arg)->run();
+}
+
+void KeyScheduler::timerCallback(void* arg) {
+  KeyScheduler* self = static_cast<KeyScheduler*>(arg);
+  xTaskNotifyGive(self->task);
+}
+
+void KeyScheduler::run() {
+  KeyCommand cmd;
+  for (;;) {
+    if (xQueueReceive(queue, &cmd, portMAX_DELAY) == pdTRUE) {
+      cmd.trace.mark(cmd.trace.dispatchedAt);
+      execute(cmd);
+      completedId.store(cmd.requestId);
+      latencyTracker.record(cmd.trace);
+      DLOG(KEYS_EXECUTED, cmd.requestId, cmd.type, esp_timer_get_time() - cmd.trace.dispatchedAt);
+    }
+  }
+}
+
+// Blocks the scheduler task (never the caller) until the given esp_timer timestamp
+void KeyScheduler::waitUntil(int64_t targetUs) {
+  int64_t remaining = targetUs - esp_timer_get_time();
+  if (remaining <= 0) {
+    return;
+  }
+  ulTaskNotifyTake(pdTRUE, 0); // Drop a stale notification
+  if (replaying.load() && replayAborted.load()) {
+    return;
+  }
+  if (esp_timer_start_once(timer, (uint64_t)remaining) != ESP_OK) {
+    vTaskDelay(pdMS_TO_TICKS(remaining / 1000 + 1));
+    return;
+  }
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+// Copies the TX timestamps of the report just sent into the trace. If the link
+// is congested the report is still queued and the notify stage stays empty.
+void KeyScheduler::traceReport(LatencyTrace& trace, int64_t& notifiedAt) {
+  int64_t sentAfter = esp_timer_get_time();
+  int64_t reportQueuedAt;
+  int64_t lastNotifiedAt;
+  remote->getTxTimestamps(reportQueuedAt, lastNotifiedAt);
+  if (reportQueuedAt >= trace.dispatchedAt && reportQueuedAt <= sentAfter) {
+    if (trace.reportQueuedAt == 0) {
+      trace.reportQueuedAt = reportQueuedAt;
+    }
+    if (lastNotifiedAt >= reportQueuedAt) {
+      notifiedAt = lastNotifiedAt;
+    }
+  }
+}
+
+// One call per press report; a packed typing report presses several keys at
+// the same time, so the rate is the keys of the last reports over their span.
+void KeyScheduler::countPress(int64_t pressedAt, uint8_t keys) {
+  keysSent += keys;
+  int64_t oldest = pressTimes[pressIndex];
+  pressTimes[pressIndex] = pressedAt;
+  pressKeys[pressIndex] = keys;
+  pressIndex = (pressIndex + 1) % KEY_RATE_SAMPLES;
+  if (oldest == 0 || pressedAt <= oldest) {
+    return;
+  }
+  uint32_t windowKeys = 0;
+  for (uint8_t count : pressKeys) {
+    windowKeys += count;
+  }
+  uint32_t rate = (uint32_t)((int64_t)windowKeys * 100000000LL / (pressedAt - oldest));
+  if (rate > peakRate.load()) {
+    peakRate.store(rate);
+  }
+}
+
+// A fixed hold counts from the press; the adaptive hold counts from the moment
+// the press report was handed to the controller, when that is known.
+int64_t KeyScheduler::releaseDueAt(const LatencyTrace& trace, int64_t pressedAt, uint32_t holdMs, uint32_t adaptiveHoldUs) {
+  if (holdMs != KEY_HOLD_AUTO) {
+    return pressedAt + (int64_t)holdMs * 1000;
+  }
+  return (trace.notifiedAt >= pressedAt ? trace.notifiedAt : pressedAt) + adaptiveHoldUs;
+}
+
+void KeyScheduler::execute(KeyCommand& cmd) {
+  LatencyTrace& trace = cmd.trace;
+  switch (cmd.type) {
+    case KEY_CMD_PRESS:
+      if (remote->sendPress(cmd.key, cmd.target)) {
+        countPress(esp_timer_get_time());
+      }
+      traceReport(trace, trace.notifiedAt);
+      break;
+
+    case KEY_CMD_RELEASE:
+      remote->sendRelease(cmd.key, cmd.target);
+      traceReport(trace, trace.notifiedAt);
+      break;
+
+    case KEY_CMD_TAP: {
+      bool adaptive = cmd.holdMs == KEY_HOLD_AUTO;
+      uint32_t adaptiveHoldUs = adaptive ? remote->getMinHoldUs(cmd.target) : 0;
+      if (adaptive) {
+        waitUntil(nextAdaptivePressAt);
+      }
+      int64_t pressedAt = esp_timer_get_time();
+      if (remote->sendPress(cmd.key, cmd.target)) {
+        countPress(pressedAt);
+        traceReport(trace, trace.notifiedAt);
+        trace.releaseDueAt = releaseDueAt(trace, pressedAt, cmd.holdMs, adaptiveHoldUs);
+        waitUntil(trace.releaseDueAt);
+        remote->sendRelease(cmd.key, cmd.target);
+        traceReport(trace, trace.releasedAt);
+        if (adaptive) {
+          nextAdaptivePressAt = esp_timer_get_time() + adaptiveHoldUs;
+        }
+      }
+      break;
+    }
+
+    case KEY_CMD_MEDIA_TAP: {
+      bool adaptive = cmd.holdMs == KEY_HOLD_AUTO;
+      uint32_t adaptiveHoldUs = adaptive ? remote->getMinHoldUs(cmd.target) : 0;
+      if (adaptive) {
+        waitUntil(nextAdaptivePressAt);
+      }
+      int64_t pressedAt = esp_timer_get_time();
+      if (remote->sendMediaPress(cmd.mediaFirst, cmd.mediaSecond, cmd.target)) {
+        countPress(pressedAt);
+      }
+      traceReport(trace, trace.notifiedAt);
+      trace.releaseDueAt = releaseDueAt(trace, pressedAt, cmd.holdMs, adaptiveHoldUs);
+      waitUntil(trace.releaseDueAt);
+      remote->sendMediaRelease(cmd.target);
+      traceReport(trace, trace.releasedAt);
+      if (adaptive) {
+        nextAdaptivePressAt = esp_timer_get_time() + adaptiveHoldUs;
+      }
+      break;
+    }
+
+    case KEY_CMD_RELEASE_ALL:
+      remote->releaseAll(cmd.target);
+      break;
+
+    case KEY_CMD_SEQUENCE:
+      executeSequence(**cmd.sequence);
+      (*cmd.sequence)->done.store(true);
+      delete cmd.sequence;
+      break;
+
+    case KEY_CMD_TYPE:
+      executeTyping(*cmd.typing, cmd.requestId, cmd.target);
+      delete cmd.typing;
+      break;
+
+    case KEY_CMD_HOLD:
+      executeHold(cmd);
+      break;
+
+    case KEY_CMD_REPLAY:
+      executeReplay(*cmd.replay, cmd.target);
+      delete cmd.replay;
+      break;
+  }
+}
+
+// Events are due at their recorded offset from the replay start, scaled, so
+// delays of the scheduler do not add up. Keys still held at the end of the
+// recording are released. abortReplay() wakes the wait for the next event
+// and ends the replay there.
+void KeyScheduler::executeReplay(const KeyReplayJob& job, uint8_t target) {
+  replayAborted.store(false);
+  replaying.store(true);
+  int64_t startedAt = esp_timer_get_time();
+  int64_t offsetUs = 0;
+  size_t pos = KEY_RECORDER_HEADER_LENGTH;
+  KeyRecordEvent event;
+  while (KeyRecorder::next(job.data, job.length, pos, event)) {
+    offsetUs += event.deltaUs;
+    waitUntil(startedAt + offsetUs * job.scalePercent / 100);
+    if (replayAborted.load()) {
+      esp_timer_stop(timer);   // The wait was cut short, the hold timer may still run
+      break;
+    }
+    switch (event.type) {
+      case KEY_REC_PRESS:
+        if (remote->sendPress(KeyId(KeyId::KIND_KEYBOARD, event.code), target)) {
+          countPress(esp_timer_get_time());
+        }
+        break;
+      case KEY_REC_RELEASE:
+        remote->sendRelease(KeyId(KeyId::KIND_KEYBOARD, event.code), target);
+        break;
+      case KEY_REC_MEDIA:
+        remote->sendMediaPress(event.media[0], event.media[1], target);
+        break;
+      case KEY_REC_REPORT: {
+        KeyReport report;
+        memcpy(&report, event.report, sizeof(report));
+        remote->sendKeyReport(report, target);
+        break;
+      }
+      case KEY_REC_RELEASE_ALL:
+        remote->releaseAll(target);
+        break;
+    }
+  }
+  replaying.store(false);
+  remote->releaseAll(target);
+}
+
+// All edges are on an absolute timeline from the first press, so the hold
+// time does not depend on how long each report took. A repeat releases the key
+// one minimum hold before its press (at most half the interval), so host and
+// controller see the release in an earlier connection event.
+void KeyScheduler::executeHold(KeyCommand& cmd) {
+  LatencyTrace& trace = cmd.trace;
+  int64_t pressedAt = esp_timer_get_time();
+  if (!remote->sendPress(cmd.key, cmd.target)) {
+    return;
+  }
+  countPress(pressedAt);
+  traceReport(trace, trace.notifiedAt);
+  trace.releaseDueAt = pressedAt + (int64_t)cmd.holdMs * 1000;
+
+  uint32_t repeats = countRepeats(cmd.holdMs, cmd.repeat);
+  int64_t intervalUs = (int64_t)cmd.repeat.intervalMs * 1000;
+  int64_t releaseGapUs = remote->getMinHoldUs(cmd.target);
+  if (releaseGapUs == 0 || releaseGapUs > intervalUs / 2) {
+    releaseGapUs = intervalUs / 2;
+  }
+  for (uint32_t i = 0; i < repeats; i++) {
+    int64_t repeatAt = pressedAt + (int64_t)cmd.repeat.delayMs * 1000 + i * intervalUs;
+    waitUntil(repeatAt - releaseGapUs);
+    remote->sendRelease(cmd.key, cmd.target);
+    waitUntil(repeatAt);
+    if (remote->sendPress(cmd.key, cmd.target)) {
+      countPress(repeatAt);
+    }
+  }
+
+  waitUntil(trace.releaseDueAt);
+  remote->sendRelease(cmd.key, cmd.target);
+  traceReport(trace, trace.releasedAt);
+}
+
+// Steps are scheduled on an absolute timeline from the sequence start, so a late
+// wake-up on one step does not shift the following ones. Adaptive steps are
+// held for the minimum hold and keep at least that much gap to the next step.
+void KeyScheduler::executeSequence(KeySequence& sequence) {
+  uint32_t adaptiveHoldUs = remote->getMinHoldUs(sequence.target);
+  int64_t next = esp_timer_get_time();
+  sequence.startedAt = next;
+
+  for (uint8_t i = 0; i < sequence.count; i++) {
+    KeySequenceStep& step = sequence.steps[i];
+    waitUntil(next);
+
+    step.pressedAt = esp_timer_get_time();
+    bool sent = step.key.isValid() ? remote->sendPress(step.key, sequence.target)
+                                     : remote->sendMediaPress(step.raw, 0, sequence.target);
+    if (sent) {
+      countPress(step.pressedAt);
+    }
+
+    bool adaptive = step.holdMs == KEY_HOLD_AUTO;
+    next += adaptive ? adaptiveHoldUs : (int64_t)step.holdMs * 1000;
+    waitUntil(next);
+
+    step.releasedAt = esp_timer_get_time();
+    if (step.key.isValid()) {
+      remote->sendRelease(step.key, sequence.target);
+    } else {
+      remote->sendMediaRelease(sequence.target);
+    }
+
+    if (i + 1 < sequence.count) {
+      int64_t gapUs = (int64_t)step.gapMs * 1000;
+      next += adaptive && gapUs < adaptiveHoldUs ? adaptiveHoldUs : gapUs;
+    }
+  }
+}
+
+// Every report waits for the hold time after the previous one reached the
+// controller. A report the TX queue refuses is retried; if the host stays
+// unreachable the rest of the text is dropped and all keys are released.
+void KeyScheduler::executeTyping(const KeyTypingJob& job, uint32_t requestId, uint8_t target) {
+  bool adaptive = job.holdMs == KEY_HOLD_AUTO;
+  int64_t holdUs = adaptive ? remote->getMinHoldUs(target) : (int64_t)job.holdMs * 1000;
+  if (adaptive) {
+    waitUntil(nextAdaptivePressAt);
+  }
+
+  TextPacker packer(job.text, job.length, job.rollover);
+  KeyReport report;
+  uint32_t typed = 0;
+  int64_t next = esp_timer_get_time();
+  while (packer.next(report)) {
+    waitUntil(next);
+    int64_t sentAt = esp_timer_get_time();
+    for (uint8_t attempt = 1; !remote->sendKeyReport(report, target); attempt++) {
+      if (attempt >= KEY_TYPE_MAX_RETRIES || !remote->isConnected(target)) {
+        DLOG(KEYS_TYPE_ABORTED, requestId, typed, job.length);
+        remote->releaseAll(target);
+        return;
+      }
+      waitUntil(esp_timer_get_time() + (holdUs > 0 ? holdUs : 1000));
+      sentAt = esp_timer_get_time();
+    }
+    countPress(sentAt, packer.lastCharacters());
+    typed += packer.lastCharacters();
+
+    int64_t reportQueuedAt;
+    int64_t notifiedAt;
+    remote->getTxTimestamps(reportQueuedAt, notifiedAt);
+    next = (notifiedAt >= sentAt ? notifiedAt : sentAt) + holdUs;
+  }
+  if (adaptive) {
+    nextAdaptivePressAt = next;
+  }
+}
@@ -0,0 +1,180 @@
+#ifndef KEY_SCHEDULER_H
+#define KEY_SCHEDULER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <memory>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "BleRemoteControl.h"
+#include "latencytracker.h"
+#include "textpacker.h"
+#include "keyrecorder.h"
+
+#define KEY_SCHEDULER_QUEUE_LENGTH 32
+#define KEY_SCHEDULER_STACK_SIZE 4096
+#define KEY_SCHEDULER_PRIORITY 12    // Above AsyncTCP so releases are not delayed by HTTP traffic
+#define KEY_SCHEDULER_CORE 1
+#define KEY_SEQUENCE_MAX_STEPS 64
+#define KEY_HOLD_AUTO UINT32_MAX     // holdMs value: shortest hold the connection interval allows
+#define KEY_RATE_SAMPLES 8           // Press reports the achieved key rate is averaged over
+#define KEY_TYPE_MAX_LENGTH 512
+#define KEY_TYPE_MAX_RETRIES 20      // Attempts per report while the BLE TX queue is full
+#define KEY_HOLD_MAX_MS 60000
+#define KEY_REPEAT_MIN_INTERVAL_MS 20
+#define KEY_REPLAY_MIN_SCALE 10      // Percent of the recorded timing
+#define KEY_REPLAY_MAX_SCALE 1000
+
+enum KeyCommandType : uint8_t {
+  KEY_CMD_PRESS,
+  KEY_CMD_RELEASE,
+  KEY_CMD_TAP,          // Press, hold for holdMs, release
+  KEY_CMD_MEDIA_TAP,    // Raw consumer usages, press, hold for holdMs, release
+  KEY_CMD_RELEASE_ALL,
+  KEY_CMD_SEQUENCE,     // Batch of taps on an absolute timeline
+  KEY_CMD_TYPE,         // Text, packed into as few keyboard reports as possible
+  KEY_CMD_HOLD,         // Long press for holdMs, optionally with auto-repeat
+  KEY_CMD_REPLAY        // Recorded session, on the recorded timeline
+};
+
+// Typematic repeat of a held key: after delayMs the key is released and pressed
+// again every intervalMs. A re-sent identical report would be dropped by the TX
+// queue and ignored by the host, so every repeat is a new key event.
+struct KeyRepeat {
+  uint32_t delayMs;
+  uint32_t intervalMs;   // 0 = no repeat, the host's own typematic applies
+};
+
+// One step of a key sequence, either a named key or a raw consumer usage
+struct KeySequenceStep {
+  KeyId key;
+  uint16_t raw;          // Used when key is invalid
+  uint32_t holdMs;       // KEY_HOLD_AUTO for the adaptive hold
+  uint32_t gapMs;        // Pause after the release before the next step
+  int64_t pressedAt;     // Actual esp_timer timestamps, filled in during execution
+  int64_t releasedAt;
+};
+
+struct KeySequence {
+  uint8_t count = 0;
+  KeySequenceStep steps[KEY_SEQUENCE_MAX_STEPS];
+  uint32_t requestId = 0;
+  uint8_t target = BLE_TARGET_ALL;
+  int64_t startedAt = 0;
+  std::atomic<bool> done{false};
+};
+
+struct KeyTypingJob {
+  char text[KEY_TYPE_MAX_LENGTH];
+  size_t length;
+  uint8_t rollover;      // Characters per report, 1 disables packing
+  uint32_t holdMs;       // Time between reports, KEY_HOLD_AUTO for the adaptive hold
+};
+
+struct KeyReplayJob {
+  uint8_t data[KEY_RECORDER_CAPACITY];   // Recording in file format
+  size_t length;
+  uint16_t scalePercent; // 100 = recorded timing, 200 = half speed
+};
+
+struct KeyCommand {
+  uint32_t requestId;
+  KeyCommandType type;
+  uint8_t target;        // conn_id of the host, or BLE_TARGET_ALL
+  KeyId key;
+  uint16_t mediaFirst;
+  uint16_t mediaSecond;
+  uint32_t holdMs;       // KEY_HOLD_AUTO for the adaptive hold
+  KeyRepeat repeat;      // KEY_CMD_HOLD only
+  std::shared_ptr<KeySequence>* sequence;  // Owned by the command, deleted after execution
+  KeyTypingJob* typing;                    // Same
+  KeyReplayJob* replay;                    // Same
+  LatencyTrace trace;
+};
+
+/**
+ * @brief Executes key commands on a dedicated task.
+ *
+ * Request handlers only enqueue a command and return its request ID. The
+ * scheduler task is the single writer of the HID reports; hold times are
+ * timed with a one-shot esp_timer instead of delay().
+ *
+ * With KEY_HOLD_AUTO a tap is held for one connection interval of the target
+ * (plus margin) from the moment the press reached the controller, so the
+ * release goes out in the following connection event. The next adaptive tap
+ * waits the same time after the release.
+ */
+class KeyScheduler {
+public:
+  KeyScheduler();
+
+  bool begin(BleRemoteControl* remote);
+
+  // All submit methods return the request ID, or 0 if the queue is full.
+  // An optional trace carries the web handler timestamps into the latency stats.
+  uint32_t press(KeyId key, uint8_t target = BLE_TARGET_ALL, const LatencyTrace* trace = nullptr);
+  uint32_t release(KeyId key, uint8_t target = BLE_TARGET_ALL, const LatencyTrace* trace = nullptr);
+  uint32_t tap(KeyId key, uint32_t holdMs, uint8_t target = BLE_TARGET_ALL, const LatencyTrace* trace = nullptr);
+  uint32_t tapMedia(uint16_t first, uint16_t second, uint32_t holdMs, uint8_t target = BLE_TARGET_ALL,
+                    const LatencyTrace* trace = nullptr);
+  // Press, hold for holdMs (up to KEY_HOLD_MAX_MS), release. With repeat.intervalMs > 0 the key repeats
+  // while held; interval and delay must be at least KEY_REPEAT_MIN_INTERVAL_MS.
+  uint32_t hold(KeyId key, uint32_t holdMs, const KeyRepeat& repeat, uint8_t target = BLE_TARGET_ALL,
+                const LatencyTrace* trace = nullptr);
+  static uint32_t countRepeats(uint32_t holdMs, const KeyRepeat& repeat);
+  // Also aborts a running replay, so the release is not queued behind it
+  uint32_t releaseAll(uint8_t target = BLE_TARGET_ALL);
+  uint32_t runSequence(const std::shared_ptr<KeySequence>& sequence);
+  // Text must only contain characters TextPacker can type and fit KEY_TYPE_MAX_LENGTH
+  uint32_t type(const char* text, size_t length, uint32_t holdMs, uint8_t rollover = TEXT_PACKER_MAX_ROLLOVER,
+                uint8_t target = BLE_TARGET_ALL);
+
+  // Replays the current recording of keyRecorder; 0 if it is empty, still recording or the scale is out of range
+  uint32_t replay(uint16_t scalePercent = 100, uint8_t target = BLE_TARGET_ALL);
+  // Stops the running replay before its next event and releases its keys; false if none runs
+  bool abortReplay();
+  bool isReplaying() const { return replaying.load(); }
+
+  uint32_t lastCompletedId() const { return completedId.load(); }
+  uint32_t pending() const;
+  uint32_t getKeysSent() const { return keysSent.load(); }
+
+  // Highest key rate seen over KEY_RATE_SAMPLES consecutive press reports
+  float getPeakKeysPerSecond() const { return peakRate.load() / 100.0f; }
+  void resetPeakKeysPerSecond() { peakRate.store(0); }
+
+private:
+  BleRemoteControl* remote = nullptr;
+  QueueHandle_t queue = nullptr;
+  TaskHandle_t task = nullptr;
+  esp_timer_handle_t timer = nullptr;
+  std::atomic<uint32_t> nextId;
+  std::atomic<uint32_t> completedId;
+  std::atomic<uint32_t> keysSent;
+  std::atomic<uint32_t> peakRate;           // Keys per second * 100
+  std::atomic<bool> replaying{false};
+  std::atomic<bool> replayAborted{false};
+  int64_t pressTimes[KEY_RATE_SAMPLES] = {};
+  uint8_t pressKeys[KEY_RATE_SAMPLES] = {};  // Keys pressed by each report
+  uint8_t pressIndex = 0;
+  int64_t nextAdaptivePressAt = 0;
+
+  uint32_t submit(KeyCommand& cmd, const LatencyTrace* trace = nullptr);
+  void run();
+  void execute(KeyCommand& cmd);
+  void traceReport(LatencyTrace& trace, int64_t& notifiedAt);
+  void countPress(int64_t pressedAt, uint8_t keys = 1);
+  int64_t releaseDueAt(const LatencyTrace& trace, int64_t pressedAt, uint32_t holdMs, uint32_t adaptiveHoldUs);
+  void executeSequence(KeySequence& sequence);
+  void executeTyping(const KeyTypingJob& job, uint32_t requestId, uint8_t target);
+  void executeHold(KeyCommand& cmd);
+  void executeReplay(const KeyReplayJob& job, uint8_t target);
+  void waitUntil(int64_t targetUs);
+
+  static void taskEntry(void* arg);
+  static void timerCallback(void* arg);
+};
+
+#endif // KEY_SCHEDULER_H
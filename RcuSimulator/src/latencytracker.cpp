@@ -0,0 +1,129 @@
+#include "latencytracker.h"
+
+size_t LatencyHistogram::bucketIndex(uint32_t us) {
+  if (us < LATENCY_SUB_BUCKETS) {
+    return us;
+  }
+  uint32_t octave = 31 - __builtin_clz(us);   // >= 2
+  if (octave >= LATENCY_MAX_OCTAVE) {
+    return LATENCY_BUCKET_COUNT - 1;
+  }
+  uint32_t sub = (us >> (octave - 2)) & (LATENCY_SUB_BUCKETS - 1);
+  return LATENCY_SUB_BUCKETS * (octave - 1) + sub;
+}
+
+uint32_t LatencyHistogram::bucketUpperBound(size_t index) {
+  if (index < LATENCY_SUB_BUCKETS) {
+    return index;
+  }
+  uint32_t octave = index / LATENCY_SUB_BUCKETS + 1;
+  uint32_t sub = index % LATENCY_SUB_BUCKETS;
+  return ((LATENCY_SUB_BUCKETS + sub + 1) << (octave - 2)) - 1;
+}
+
+void LatencyHistogram::record(uint32_t us) {
+  buckets[bucketIndex(us)]++;
+  count++;
+  if (us > max) {
+    max = us;
+  }
+}
+
+void LatencyHistogram::reset() {
+  memset(buckets, 0, sizeof(buckets));
+  count = 0;
+  max = 0;
+}
+
+uint32_t LatencyHistogram::percentile(uint32_t permille) const {
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t rank = ((uint64_t)count * permille + 999) / 1000;   // 1-based, rounded up
+  uint64_t seen = 0;
+  for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      uint32_t bound = bucketUpperBound(i);
+      return bound < max ? bound : max;
+    }
+  }
+  return max;
+}
+
+LatencyStats LatencyHistogram::getStats() const {
+  LatencyStats stats;
+  stats.count = count;
+  stats.p50 = percentile(500);
+  stats.p95 = percentile(950);
+  stats.p99 = percentile(990);
+  stats.max = max;
+  return stats;
+}
+
+bool LatencyTracker::begin() {
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateMutex();
+  }
+  return mutex != nullptr;
+}
+
+void LatencyTracker::recordStage(LatencyStage stage, int64_t from, int64_t to) {
+  if (from == 0 || to == 0 || to < from) {
+    return;   // Stage not reached, e.g. report still waiting for a congested link
+  }
+  int64_t delta = to - from;
+  histograms[stage].record(delta > UINT32_MAX ? UINT32_MAX : (uint32_t)delta);
+}
+
+void LatencyTracker::record(const LatencyTrace& trace) {
+  if (mutex == nullptr) {
+    return;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  recordStage(LAT_STAGE_AUTH, trace.parsedAt, trace.validatedAt);
+  recordStage(LAT_STAGE_RESOLVE, trace.validatedAt, trace.resolvedAt);
+  recordStage(LAT_STAGE_SUBMIT, trace.resolvedAt, trace.submittedAt);
+  recordStage(LAT_STAGE_DISPATCH, trace.submittedAt, trace.dispatchedAt);
+  recordStage(LAT_STAGE_REPORT, trace.dispatchedAt, trace.reportQueuedAt);
+  recordStage(LAT_STAGE_NOTIFY, trace.reportQueuedAt, trace.notifiedAt);
+  recordStage(LAT_STAGE_RELEASE, trace.releaseDueAt, trace.releasedAt);
+  recordStage(LAT_STAGE_TOTAL, trace.parsedAt, trace.notifiedAt);
+  xSemaphoreGive(mutex);
+}
+
+void LatencyTracker::reset() {
+  if (mutex == nullptr) {
+    return;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  for (size_t i = 0; i < LAT_STAGE_COUNT; i++) {
+    histograms[i].reset();
+  }
+  xSemaphoreGive(mutex);
+}
+
+LatencyStats LatencyTracker::getStats(LatencyStage stage) const {
+  LatencyStats stats = {};
+  if (mutex == nullptr || stage >= LAT_STAGE_COUNT) {
+    return stats;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  stats = histograms[stage].getStats();
+  xSemaphoreGive(mutex);
+  return stats;
+}
+
+const char* LatencyTracker::stageName(LatencyStage stage) {
+  switch (stage) {
+    case LAT_STAGE_AUTH:     return "auth";
+    case LAT_STAGE_RESOLVE:  return "resolve";
+    case LAT_STAGE_SUBMIT:   return "submit";
+    case LAT_STAGE_DISPATCH: return "dispatch";
+    case LAT_STAGE_REPORT:   return "report";
+    case LAT_STAGE_NOTIFY:   return "notify";
+    case LAT_STAGE_RELEASE:  return "release";
+    case LAT_STAGE_TOTAL:    return "total";
+    default:                 return "unknown";
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef LATENCY_TRACKER_H
+#define LATENCY_TRACKER_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#define LATENCY_SUB_BUCKETS 4                  // Per power of two, percentiles are accurate to ~25 %
+#define LATENCY_MAX_OCTAVE 24                  // 2^24 us = ~16.8 s, larger values land in the last bucket
+#define LATENCY_BUCKET_COUNT (LATENCY_SUB_BUCKETS * (LATENCY_MAX_OCTAVE - 1))
+
+// Timestamps (esp_timer_get_time()) of one key command, 0 = stage not reached
+struct LatencyTrace {
+  int64_t parsedAt;        // Web handler entered, request and parameters parsed
+  int64_t validatedAt;     // Token validated
+  int64_t resolvedAt;      // Key name resolved
+  int64_t submittedAt;     // Command placed in the scheduler queue
+  int64_t dispatchedAt;    // Scheduler task started the command
+  int64_t reportQueuedAt;  // HID report placed in the BLE TX queue
+  int64_t notifiedAt;      // notify() returned for that report
+  int64_t releaseDueAt;    // End of the hold time (taps only)
+  int64_t releasedAt;      // notify() returned for the release report
+
+  void mark(int64_t& stage) { stage = esp_timer_get_time(); }
+};
+
+enum LatencyStage : uint8_t {
+  LAT_STAGE_AUTH,       // parsed -> validated
+  LAT_STAGE_RESOLVE,    // validated -> resolved
+  LAT_STAGE_SUBMIT,     // resolved -> submitted
+  LAT_STAGE_DISPATCH,   // submitted -> dispatched
+  LAT_STAGE_REPORT,     // dispatched -> report queued
+  LAT_STAGE_NOTIFY,     // report queued -> notify returned
+  LAT_STAGE_RELEASE,    // hold expired -> release notify returned
+  LAT_STAGE_TOTAL,      // parsed -> notify returned
+  LAT_STAGE_COUNT
+};
+
+struct LatencyStats {
+  uint32_t count;
+  uint32_t p50;
+  uint32_t p95;
+  uint32_t p99;
+  uint32_t max;
+};
+
+/**
+ * @brief Log-linear histogram of microsecond values.
+ *
+ * Values below 4 us get their own bucket, above that every power of two is
+ * split into LATENCY_SUB_BUCKETS buckets. Percentiles report the upper bound
+ * of the bucket, capped at the exact maximum.
+ */
+class LatencyHistogram {
+public:
+  void record(uint32_t us);
+  void reset();
+  LatencyStats getStats() const;
+
+private:
+  uint32_t buckets[LATENCY_BUCKET_COUNT] = {};
+  uint32_t count = 0;
+  uint32_t max = 0;
+
+  static size_t bucketIndex(uint32_t us);
+  static uint32_t bucketUpperBound(size_t index);
+  uint32_t percentile(uint32_t permille) const;
+};
+
+/**
+ * @brief Aggregates the per-stage latencies of completed key commands.
+ *
+ * Traces are recorded by the key scheduler once a command is done; readers
+ * (web server, CLI) take a consistent copy under the mutex.
+ */
+class LatencyTracker {
+public:
+  bool begin();
+  void record(const LatencyTrace& trace);
+  void reset();
+  LatencyStats getStats(LatencyStage stage) const;
+
+  static const char* stageName(LatencyStage stage);
+
+private:
+  LatencyHistogram histograms[LAT_STAGE_COUNT];
+  SemaphoreHandle_t mutex = nullptr;
+
+  void recordStage(LatencyStage stage, int64_t from, int64_t to);
+};
+
+extern LatencyTracker latencyTracker;
+
+#endif // LATENCY_TRACKER_H
@@ -1,11 +1,21 @@
 #include "main.h"
 
 // Global variables
+DeferredLog deferredLog; // First, other globals may log from their constructors
 BleRemoteControl bleRemoteControl;
+KeyScheduler keyScheduler;
+ControlSocket controlSocket;
+UdpControl udpControl;
+StateStream stateStream;
+LatencyTracker latencyTracker;
+HeapMonitor heapMonitor;
+TaskProfiler taskProfiler;
+Metrics metrics;
 bool isConfigMode = false;
 GenericCLI cli;
 WiFiManager wifiManager;
-Preferences preferences;
+ConfigStore configStore;
+KeyRecorder keyRecorder;
 DisplayManager displayManager; 
 bool deviceConnected = false;
 bool oldDeviceConnected = false;
@@ -24,6 +34,7 @@ void tryConnectWifi() {
   if (wifiManager.isConnected()) {
     displayManager.setLinesAndRender("Starting Web Server");
     setupWebServer();
+    udpControl.begin();
     displayManager.setLinesAndRender("IP: " + wifiManager.localIp().toString(), "Webserver running");
   } else {
     displayManager.setLinesAndRender("WiFi not connected", "Check configuration");
@@ -119,6 +130,330 @@ void handleDiagnostics(const CLIArgs& args) {
   }
 }
 
+void handleLogLevel(const CLIArgs& args) {
+  if (args.empty()) {
+    Serial.println("Log levels:");
+    for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
+      Serial.printf("  %-6s %s\n", logModuleNames[i], DeferredLog::levelName(deferredLog.getLevel((LogModule)i)));
+    }
+    Serial.println("  Dropped records: " + String(deferredLog.getDropped()));
+    return;
+  }
+  if (args.size() < 2) {
+    Serial.println("ERROR: Usage: loglevel <module|all> <none|error|warn|info|debug>");
+    return;
+  }
+  String moduleName = args.getPositional(0);
+  LogLevel level;
+  if (!DeferredLog::parseLevel(args.getPositional(1), level)) {
+    Serial.println("ERROR: Invalid log level");
+    return;
+  }
+  if (moduleName.equalsIgnoreCase("all")) {
+    for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
+      deferredLog.setLevel((LogModule)i, level);
+    }
+  } else {
+    LogModule module;
+    if (!DeferredLog::parseModule(moduleName, module)) {
+      Serial.println("ERROR: Unknown log module: " + moduleName);
+      return;
+    }
+    deferredLog.setLevel(module, level);
+  }
+  cli.printSuccess("Log level of " + moduleName + " set to " + DeferredLog::levelName(level));
+}
+
+void handleLatency(const CLIArgs& args) {
+  if (!args.empty() && args.getPositional(0).equalsIgnoreCase("reset")) {
+    latencyTracker.reset();
+    cli.printSuccess("Latency statistics reset");
+    return;
+  }
+  Serial.println("Key command latency (us):");
+  Serial.println("  stage       count      p50      p95      p99      max");
+  for (uint8_t i = 0; i < LAT_STAGE_COUNT; i++) {
+    LatencyStats stats = latencyTracker.getStats((LatencyStage)i);
+    Serial.printf("  %-8s %8u %8u %8u %8u %8u\n", LatencyTracker::stageName((LatencyStage)i),
+                  (unsigned)stats.count, (unsigned)stats.p50, (unsigned)stats.p95, (unsigned)stats.p99, (unsigned)stats.max);
+  }
+}
+
+void handleHeap(const CLIArgs& args) {
+  if (!args.empty() && args.getPositional(0).equalsIgnoreCase("alarm")) {
+    if (args.size() < 3) {
+      Serial.println("ERROR: Usage: heap alarm <free bytes> <block bytes>");
+      return;
+    }
+    long freeBytes = args.getPositional(1).toInt();
+    long blockBytes = args.getPositional(2).toInt();
+    if (freeBytes < 0 || blockBytes < 0) {
+      Serial.println("ERROR: Invalid threshold");
+      return;
+    }
+    heapMonitor.setThresholds(freeBytes, blockBytes);
+    cli.printSuccess("Heap alarm below " + String(freeBytes) + " bytes free or a " + String(blockBytes) + " byte block");
+    return;
+  }
+  HeapSnapshot snapshot = heapMonitor.getSnapshot();
+  Serial.printf("Heap snapshot (%lu s old):\n", (unsigned long)((millis() - snapshot.takenAt) / 1000));
+  Serial.printf("  Free: %u bytes (%+d since previous snapshot), minimum %u bytes\n",
+                (unsigned)snapshot.freeBytes, (int)snapshot.freeDelta, (unsigned)snapshot.minFreeBytes);
+  Serial.printf("  Largest block: %u bytes, fragmentation %u%%\n",
+                (unsigned)snapshot.largestBlock, (unsigned)snapshot.fragmentation);
+  Serial.printf("  Alarm: %s (below %u free or %u block), raised %u times\n", snapshot.alarm ? "ACTIVE" : "off",
+                (unsigned)heapMonitor.getFreeThreshold(), (unsigned)heapMonitor.getBlockThreshold(),
+                (unsigned)heapMonitor.getAlarmCount());
+  if (!HeapMonitor::isAccounting()) {
+    Serial.println("  Allocation accounting not compiled in (HEAP_ACCOUNTING)");
+    return;
+  }
+  Serial.println("  subsystem   allocs     frees   alloc bytes    freed bytes");
+  for (uint8_t i = 0; i < HEAP_TAG_COUNT; i++) {
+    const HeapTagStats& stats = snapshot.tags[i];
+    Serial.printf("  %-8s %9u %9u %13llu %14llu\n", HeapMonitor::tagName((HeapTag)i),
+                  (unsigned)stats.allocations, (unsigned)stats.frees,
+                  (unsigned long long)stats.allocatedBytes, (unsigned long long)stats.freedBytes);
+  }
+}
+
+void handleTasks(const CLIArgs& args) {
+  if (!TaskProfiler::isAvailable()) {
+    Serial.println("ERROR: FreeRTOS run time statistics are not enabled");
+    return;
+  }
+  TaskProfile tasks[TASK_PROFILER_MAX_TASKS];
+  size_t count = taskProfiler.getTasks(tasks, TASK_PROFILER_MAX_TASKS);
+  Serial.printf("Tasks: %u (%u not profiled), CPU in %% of one core over %us / %us / %us\n",
+                (unsigned)count, (unsigned)taskProfiler.getUntracked(), (unsigned)TaskProfiler::windowSeconds(0),
+                (unsigned)TaskProfiler::windowSeconds(1), (unsigned)TaskProfiler::windowSeconds(2));
+  Serial.println("  name             core prio    cpu short   medium     long   stack free");
+  for (size_t i = 0; i < count; i++) {
+    char core[4];
+    snprintf(core, sizeof(core), "%d", tasks[i].core);
+    Serial.printf("  %-16s %4s %4u %12.1f %8.1f %8.1f %12u\n", tasks[i].name, tasks[i].core < 0 ? "any" : core,
+                  (unsigned)tasks[i].priority, tasks[i].cpu[0], tasks[i].cpu[1], tasks[i].cpu[2],
+                  (unsigned)tasks[i].stackHighWater);
+  }
+  for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+    Serial.printf("  Core %u load: %.1f%% / %.1f%% / %.1f%%\n", core, taskProfiler.getCoreLoad(core, 0),
+                  taskProfiler.getCoreLoad(core, 1), taskProfiler.getCoreLoad(core, 2));
+  }
+}
+
+void handleConnections(const CLIArgs& args) {
+  HostConnectionInfo infos[BLE_MAX_CONNECTIONS];
+  size_t count = bleRemoteControl.getConnections(infos, BLE_MAX_CONNECTIONS);
+  Serial.println("BLE connections: " + String(count) + "/" + String(BLE_MAX_CONNECTIONS));
+  for (size_t i = 0; i < count; i++) {
+    uint32_t minHoldUs = BleRemoteControl::minHoldForInterval(infos[i].interval);
+    Serial.printf("  [%u] %s keyboard:%s media:%s interval:%.2fms latency:%u timeout:%ums minhold:%.2fms%s\n",
+                  infos[i].connId, infos[i].address.c_str(),
+                  infos[i].keyboardSubscribed ? "on" : "off", infos[i].mediaSubscribed ? "on" : "off",
+                  infos[i].interval * 1.25f, infos[i].latency, infos[i].timeout * 10, minHoldUs / 1000.0f,
+                  infos[i].keyTx.congested ? " congested" : "");
+  }
+  Serial.printf("Peak key rate: %.1f keys/s\n", keyScheduler.getPeakKeysPerSecond());
+}
+
+void handleConnParams(const CLIArgs& args) {
+  if (args.size() < 2) {
+    handleConnections(args);
+    Serial.println("Usage: connparams <connId|all> <minMs> [maxMs] [latency] [timeoutMs]");
+    return;
+  }
+  uint8_t target = BLE_TARGET_ALL;
+  if (!args.getPositional(0).equalsIgnoreCase("all")) {
+    target = (uint8_t)args.getPositional(0).toInt();
+  }
+  float minMs = args.getPositional(1).toFloat();
+  float maxMs = args.size() > 2 ? args.getPositional(2).toFloat() : minMs;
+  uint16_t latency = args.size() > 3 ? (uint16_t)args.getPositional(3).toInt() : 0;
+  uint16_t timeout = args.size() > 4 ? (uint16_t)(args.getPositional(4).toInt() / 10) : 400;
+
+  esp_err_t err = bleRemoteControl.requestConnParams(target, (uint16_t)lroundf(minMs / 1.25f),
+                                                     (uint16_t)lroundf(maxMs / 1.25f), latency, timeout);
+  if (err == ESP_ERR_INVALID_ARG) {
+    Serial.println("ERROR: Invalid connection parameters");
+  } else if (err != ESP_OK) {
+    Serial.println("ERROR: Connection parameter update failed: " + String(esp_err_to_name(err)));
+  } else {
+    cli.printSuccess("Connection parameter update requested, see 'connections' for the result");
+  }
+}
+
+void handleBleDisconnect(const CLIArgs& args) {
+  uint8_t target = BLE_TARGET_ALL;
+  if (!args.empty() && !args.getPositional(0).equalsIgnoreCase("all")) {
+    target = (uint8_t)args.getPositional(0).toInt();
+  }
+  if (bleRemoteControl.disconnect(target)) {
+    cli.printSuccess("Disconnect requested");
+  } else {
+    Serial.println("ERROR: No matching connection");
+  }
+}
+
+// Words are joined with single spaces, the CLI splits the line at whitespace
+void handleType(const CLIArgs& args) {
+  if (args.empty()) {
+    Serial.println("ERROR: Text required");
+    return;
+  }
+  String text = args.getPositional(0);
+  for (size_t i = 1; i < args.size(); i++) {
+    text += " " + args.getPositional(i);
+  }
+  if (text.length() > KEY_TYPE_MAX_LENGTH) {
+    Serial.println("ERROR: Text longer than " + String(KEY_TYPE_MAX_LENGTH) + " characters");
+    return;
+  }
+  int untypable = TextPacker::findUntypable(text.c_str(), text.length());
+  if (untypable >= 0) {
+    Serial.println("ERROR: Character at position " + String(untypable) + " cannot be typed");
+    return;
+  }
+  if (!bleRemoteControl.isConnected()) {
+    Serial.println("ERROR: Not connected to a host");
+    return;
+  }
+  uint32_t requestId = keyScheduler.type(text.c_str(), text.length(), KEY_HOLD_AUTO);
+  if (requestId == 0) {
+    Serial.println("ERROR: Key queue full");
+    return;
+  }
+  size_t reports = TextPacker::countReports(text.c_str(), text.length());
+  cli.printSuccess("Typing " + String(text.length()) + " characters in " + String(reports) +
+                   " reports (request " + String(requestId) + ")");
+}
+
+void handleHold(const CLIArgs& args) {
+  if (args.size() < 2) {
+    Serial.println("ERROR: Key and duration required");
+    return;
+  }
+  String keyName = args.getPositional(0);
+  KeyId keyId = resolveKeyName(keyName.c_str(), keyName.length());
+  if (!keyId.isValid()) {
+    Serial.println("ERROR: Unknown key: " + keyName);
+    return;
+  }
+  long duration = args.getPositional(1).toInt();
+  KeyRepeat repeat = {};
+  repeat.intervalMs = args.size() > 2 ? args.getPositional(2).toInt() : 0;
+  repeat.delayMs = args.size() > 3 ? args.getPositional(3).toInt() : 500;
+  if (duration <= 0 || duration > KEY_HOLD_MAX_MS) {
+    Serial.println("ERROR: Duration must be 1-" + String(KEY_HOLD_MAX_MS) + " ms");
+    return;
+  }
+  if (!bleRemoteControl.isConnected()) {
+    Serial.println("ERROR: Not connected to a host");
+    return;
+  }
+  uint32_t requestId = keyScheduler.hold(keyId, duration, repeat);
+  if (requestId == 0) {
+    Serial.println("ERROR: Invalid repeat timing or key queue full");
+    return;
+  }
+  cli.printSuccess("Holding " + keyName + " for " + String(duration) + " ms with " +
+                   String(KeyScheduler::countRepeats(duration, repeat)) + " repeats (request " + String(requestId) + ")");
+}
+
+void handleRecord(const CLIArgs& args) {
+  String action = args.empty() ? "status" : args.getPositional(0);
+  if (action == "start") {
+    if (!keyRecorder.start()) {
+      Serial.println("ERROR: Recorder not available");
+      return;
+    }
+    cli.printSuccess("Recording started");
+  } else if (action == "stop") {
+    if (!keyRecorder.isRecording()) {
+      Serial.println("ERROR: Not recording");
+      return;
+    }
+    if (!keyRecorder.stop()) {
+      Serial.println("ERROR: Recording stopped but not saved to flash");
+      return;
+    }
+    cli.printSuccess("Recorded " + String(keyRecorder.getEventCount()) + " events in " +
+                     String((uint32_t)(keyRecorder.getDurationUs() / 1000)) + " ms");
+  } else if (action == "status") {
+    Serial.println("Recording: " + String(keyRecorder.isRecording() ? "active" : "stopped") +
+                   (keyRecorder.isTruncated() ? " (buffer full)" : ""));
+    Serial.println("Events: " + String(keyRecorder.getEventCount()) + ", " + String(keyRecorder.getLength()) +
+                   "/" + String(KEY_RECORDER_CAPACITY) + " bytes, " +
+                   String((uint32_t)(keyRecorder.getDurationUs() / 1000)) + " ms");
+  } else {
+    Serial.println("ERROR: Unknown action: " + action);
+  }
+}
+
+void handleReplay(const CLIArgs& args) {
+  if (!args.empty() && args.getPositional(0) == "stop") {
+    if (!keyScheduler.abortReplay()) {
+      Serial.println("ERROR: No replay running");
+      return;
+    }
+    cli.printSuccess("Replay stopped, all keys released");
+    return;
+  }
+  long scale = args.empty() ? 100 : args.getPositional(0).toInt();
+  if (scale < KEY_REPLAY_MIN_SCALE || scale > KEY_REPLAY_MAX_SCALE) {
+    Serial.println("ERROR: Scale must be " + String(KEY_REPLAY_MIN_SCALE) + "-" + String(KEY_REPLAY_MAX_SCALE) + " percent");
+    return;
+  }
+  if (!bleRemoteControl.isConnected()) {
+    Serial.println("ERROR: Not connected to a host");
+    return;
+  }
+  uint32_t requestId = keyScheduler.replay(scale);
+  if (requestId == 0) {
+    Serial.println("ERROR: No recording, recording in progress or key queue full");
+    return;
+  }
+  cli.printSuccess("Replaying " + String(keyRecorder.getEventCount()) + " events (request " + String(requestId) + ")");
+}
+
+void handleProfile(const CLIArgs& args) {
+  String action = args.empty() ? "list" : args.getPositional(0);
+  String name = args.size() > 1 ? args.getPositional(1) : "";
+  if (action == "list") {
+    IdentityProfile profiles[BLE_MAX_PROFILES];
+    size_t count = bleRemoteControl.getProfiles(profiles, BLE_MAX_PROFILES);
+    Serial.println("Identity profiles: " + String(count) + "/" + String(BLE_MAX_PROFILES) +
+                   ", active: " + bleRemoteControl.getActiveProfile());
+    Serial.printf("Last switch: %u us%s\n", (unsigned)bleRemoteControl.getLastSwitchUs(),
+                  bleRemoteControl.isSwitching() ? ", switch in progress" : "");
+    for (size_t i = 0; i < count; i++) {
+      Serial.printf("  %-15s VID 0x%04X PID 0x%04X ver 0x%04X \"%s\"\n", profiles[i].name, profiles[i].vendorId,
+                    profiles[i].productId, profiles[i].versionId, profiles[i].deviceName);
+    }
+  } else if (name.isEmpty()) {
+    Serial.println("ERROR: Profile name required");
+  } else if (action == "save") {
+    if (bleRemoteControl.saveProfile(name)) {
+      cli.printSuccess("Current identity saved as profile " + name);
+    } else {
+      Serial.println("ERROR: Invalid name or no free profile slot");
+    }
+  } else if (action == "delete") {
+    if (bleRemoteControl.deleteProfile(name)) {
+      cli.printSuccess("Profile " + name + " deleted");
+    } else {
+      Serial.println("ERROR: Profile not found");
+    }
+  } else if (action == "use") {
+    if (bleRemoteControl.activateProfile(name)) {
+      cli.printSuccess("Switching to profile " + name + ", 'profile list' shows the switch time");
+    } else {
+      Serial.println("ERROR: Profile not found");
+    }
+  } else {
+    Serial.println("ERROR: Unknown action, use list, save, delete or use");
+  }
+}
+
 // Command definitions array
 const CLICommandDef customCommands[] = {
   // WiFi Configuration Commands
@@ -131,8 +466,22 @@ const CLICommandDef customCommands[] = {
   {"connect",     "Connect to WiFi",              "connect",             handleConnect,      "WiFi"},
   {"config",      "Show WiFi configuration",      "config",              handleShowConfig,   "WiFi"},
   
+  // BLE Commands
+  {"connections", "List connected BLE hosts",     "connections",         handleConnections,  "BLE"},
+  {"connparams",  "Show/request conn parameters", "connparams [connId|all] [minMs] [maxMs] [latency] [timeoutMs]", handleConnParams, "BLE"},
+  {"disconnect",  "Disconnect BLE host(s)",       "disconnect [connId|all]", handleBleDisconnect, "BLE"},
+  {"type",        "Type text on all hosts",       "type <text>",         handleType,         "BLE"},
+  {"hold",        "Hold a key, optionally repeating", "hold <key> <ms> [intervalMs] [delayMs]", handleHold, "BLE"},
+  {"record",      "Record keys sent to the hosts", "record [start|stop|status]", handleRecord, "BLE"},
+  {"replay",      "Replay the recorded keys",     "replay [scalePercent|stop]", handleReplay,     "BLE"},
+  {"profile",     "Manage identity profiles",     "profile [list|save|delete|use] [name]", handleProfile, "BLE"},
+  
   // System Commands
   {"diag",        "Show diagnostic information",  "diag",                handleDiagnostics,  "System"},
+  {"latency",     "Show key command latency",     "latency [reset]",     handleLatency,      "System"},
+  {"heap",        "Show heap usage or set the alarm", "heap [alarm <free> <block>]", handleHeap, "System"},
+  {"tasks",       "Show CPU and stack per task",  "tasks",               handleTasks,        "System"},
+  {"loglevel",    "Show or set log levels",       "loglevel [module|all] [level]", handleLogLevel, "System"},
   
   // End marker
   {nullptr, nullptr, nullptr, nullptr, nullptr}
@@ -165,7 +514,11 @@ void setupCLI() {
 void setup() {
   Serial.begin(115200);
   esp_log_level_set("wifi", ESP_LOG_ERROR);
+  deferredLog.begin();
   startTime = millis();
+  configStore.begin(); // Before anything reads its configuration
+  heapMonitor.begin();
+  taskProfiler.begin();
   updateBootCounter();
   
   displayManager.begin(); 
@@ -180,8 +533,17 @@ void setup() {
 
 // The main loop routine runs over and over again
 void loop() {
-  cli.update();
+  {
+    HeapTagScope heapTag(HEAP_TAG_CLI);
+    cli.update();
+  }
   wifiManager.loop();
+  bleRemoteControl.loop();
+  keyRecorder.loop();
+  controlSocket.loop();
+  stateStream.loop();
+  heapMonitor.loop();
+  taskProfiler.loop();
   
   if (CLIStandardCommands::isExitRequested()) {
     Serial.println("Exit requested - entering minimal mode");
@@ -195,13 +557,26 @@ void setupBLE() {
   // Initialize BLE functionality, but don't start yet
   bleRemoteControl.begin();
   
+  // Loads the last recording from flash
+  keyRecorder.begin();
+  bleRemoteControl.setRecorder(&keyRecorder);
+  
+  // Host connects and disconnects are pushed to the WebSocket and SSE clients
+  bleRemoteControl.setConnectionCallback([](bool connected, uint16_t connId) {
+    controlSocket.notifyConnection(connected, connId);
+    stateStream.notifyConnection(connected, connId);
+  });
+  
+  // Key commands from the web server are executed on the scheduler task
+  latencyTracker.begin();
+  keyScheduler.begin(&bleRemoteControl);
+  
   // Wait for initialization
   delay(500);
 }
 
 void updateBootCounter() {
-  preferences.begin("rcu-config", false);
-  bootCount = preferences.getUInt("bootCount", 0);
-  bootCount++;
-  preferences.putUInt("bootCount", bootCount);
+  bootCount = configStore.getNumber(CONFIG_SYS_BOOT_COUNT) + 1;
+  configStore.setNumber(CONFIG_SYS_BOOT_COUNT, bootCount);
+  configStore.commit();
 }
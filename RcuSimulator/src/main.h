@@ -10,6 +10,12 @@
 #include "displaymanager.h"
 #include "BleRemoteControl.h"
 #include "utils.h"
+#include "deferredlog.h"
+#include "metrics.h"
+#include "heapmonitor.h"
+#include "taskprofiler.h"
+#include "configstore.h"
+#include "keyrecorder.h"
 #include "generic_cli.h"
 #include "cli_standard_commands.h"
 
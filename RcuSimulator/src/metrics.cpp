@@ -0,0 +1,399 @@
+#include "metrics.h"
+#include "globals.h"
+#include "deferredlog.h"
+#include "configstore.h"
+#include "heapmonitor.h"
+#include "taskprofiler.h"
+#include <memory>
+
+void Metrics::recordHttpRequest(AsyncWebServerRequest* request, uint16_t status, uint32_t durationUs) {
+  // Unknown URLs (scanners, typos) would blow up the label set
+  const char* route = status == 404 ? "unmatched" : request->url().c_str();
+  HttpRouteCounter* counter = findRoute(route, status);
+  if (counter != nullptr) {
+    counter->count++;
+  }
+
+  size_t bucket = 0;
+  while (bucket < METRICS_LATENCY_BUCKETS && durationUs > metricsLatencyBounds[bucket]) {
+    bucket++;
+  }
+  if (bucket < METRICS_LATENCY_BUCKETS) {
+    latencyBuckets[bucket]++;
+  }
+  latencyCount++;
+  latencySumUs += durationUs;
+}
+
+HttpRouteCounter* Metrics::findRoute(const char* route, uint16_t status) {
+  for (size_t i = 0; i < routeCount; i++) {
+    if (routes[i].status == status && strncmp(routes[i].route, route, METRICS_ROUTE_LENGTH - 1) == 0) {
+      return &routes[i];
+    }
+  }
+  if (routeCount < METRICS_MAX_ROUTES - 1) {
+    HttpRouteCounter& counter = routes[routeCount++];
+    strlcpy(counter.route, route, sizeof(counter.route));
+    counter.status = status;
+    return &counter;
+  }
+  // Last slot collects everything that did not fit
+  HttpRouteCounter& other = routes[METRICS_MAX_ROUTES - 1];
+  if (routeCount < METRICS_MAX_ROUTES) {
+    strlcpy(other.route, "other", sizeof(other.route));
+    other.status = 0;
+    routeCount++;
+  }
+  return &other;
+}
+
+// Produces the response line by line; one call of the chunk filler copies as
+// many (partial) lines as fit into the TCP buffer.
+class MetricsWriter {
+public:
+  MetricsWriter();
+  size_t fill(uint8_t* buffer, size_t maxLen);
+
+private:
+  enum Section : uint8_t {
+    SECTION_COUNTERS,
+    SECTION_GAUGES,
+    SECTION_CPU_LOAD,
+    SECTION_CONN_INTERVAL,
+    SECTION_CONN_LATENCY,
+    SECTION_CONN_TIMEOUT,
+    SECTION_CONN_UPDATES,
+    SECTION_HTTP_REQUESTS,
+    SECTION_HTTP_LATENCY,
+    SECTION_HEAP_TAGS,
+    SECTION_DONE
+  };
+
+  uint8_t section = SECTION_COUNTERS;
+  uint16_t item = 0;
+  uint32_t cumulative = 0;
+  char line[METRICS_LINE_LENGTH];
+  size_t lineLen = 0;
+  size_t linePos = 0;
+  HostConnectionInfo hosts[BLE_MAX_CONNECTIONS];   // Snapshot, so all families list the same hosts
+  size_t hostCount = 0;
+
+  bool nextLine();
+  int formatCounter(uint16_t index);
+  int formatGauge(uint16_t index);
+  int formatCpuLoad(uint16_t index);
+  int formatConnection(uint8_t family, uint16_t index);
+  int formatHttpRequests(uint16_t index);
+  int formatHttpLatency(uint16_t index);
+  int formatHeapTags(uint16_t index);
+};
+
+MetricsWriter::MetricsWriter() {
+  hostCount = bleRemoteControl.getConnections(hosts, BLE_MAX_CONNECTIONS);
+}
+
+size_t MetricsWriter::fill(uint8_t* buffer, size_t maxLen) {
+  size_t written = 0;
+  while (written < maxLen) {
+    if (linePos >= lineLen && !nextLine()) {
+      break;
+    }
+    size_t chunk = lineLen - linePos;
+    if (chunk > maxLen - written) {
+      chunk = maxLen - written;
+    }
+    memcpy(buffer + written, line + linePos, chunk);
+    linePos += chunk;
+    written += chunk;
+  }
+  return written;
+}
+
+bool MetricsWriter::nextLine() {
+  while (section < SECTION_DONE) {
+    int len = -1;
+    switch (section) {
+      case SECTION_COUNTERS:      len = formatCounter(item); break;
+      case SECTION_GAUGES:        len = formatGauge(item); break;
+      case SECTION_CPU_LOAD:      len = formatCpuLoad(item); break;
+      case SECTION_CONN_INTERVAL:
+      case SECTION_CONN_LATENCY:
+      case SECTION_CONN_TIMEOUT:
+      case SECTION_CONN_UPDATES:  len = formatConnection(section, item); break;
+      case SECTION_HTTP_REQUESTS: len = formatHttpRequests(item); break;
+      case SECTION_HTTP_LATENCY:  len = formatHttpLatency(item); break;
+      case SECTION_HEAP_TAGS:     len = formatHeapTags(item); break;
+    }
+    if (len < 0) {
+      section++;
+      item = 0;
+      continue;
+    }
+    item++;
+    lineLen = len < (int)sizeof(line) ? len : sizeof(line) - 1;
+    linePos = 0;
+    return true;
+  }
+  return false;
+}
+
+#define METRIC_HEADER(name, type, help) "# HELP " name " " help "\n# TYPE " name " " type "\n"
+
+int MetricsWriter::formatCounter(uint16_t index) {
+  ReportQueueStats key = bleRemoteControl.getKeyTxStats();
+  ReportQueueStats media = bleRemoteControl.getMediaTxStats();
+  switch (index) {
+    case 0:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_keys_sent_total", "counter", "Key presses sent by the key scheduler")
+                      "rcu_keys_sent_total %u\n", (unsigned)keyScheduler.getKeysSent());
+    case 1:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_reports_notified_total", "counter", "HID reports handed to the BLE controller")
+                      "rcu_reports_notified_total{queue=\"keyboard\"} %u\n"
+                      "rcu_reports_notified_total{queue=\"media\"} %u\n",
+                      (unsigned)key.notified, (unsigned)media.notified);
+    case 2:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_notify_failures_total", "counter", "notify() calls that returned an error")
+                      "rcu_notify_failures_total{queue=\"keyboard\"} %u\n"
+                      "rcu_notify_failures_total{queue=\"media\"} %u\n",
+                      (unsigned)key.notifyFailures, (unsigned)media.notifyFailures);
+    case 3:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_reports_coalesced_total", "counter", "Identical HID reports dropped by the TX queue")
+                      "rcu_reports_coalesced_total{queue=\"keyboard\"} %u\n"
+                      "rcu_reports_coalesced_total{queue=\"media\"} %u\n",
+                      (unsigned)key.coalesced, (unsigned)media.coalesced);
+    case 4:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_reports_rejected_total", "counter", "HID reports refused because the TX queue was full")
+                      "rcu_reports_rejected_total{queue=\"keyboard\"} %u\n"
+                      "rcu_reports_rejected_total{queue=\"media\"} %u\n",
+                      (unsigned)key.rejected, (unsigned)media.rejected);
+    case 5:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_ble_congestion_events_total", "counter", "Times the BLE controller reported congestion")
+                      "rcu_ble_congestion_events_total %u\n", (unsigned)key.congestionEvents);
+    case 6:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_ble_connects_total", "counter", "BLE host connections since boot")
+                      "rcu_ble_connects_total %u\n", (unsigned)bleRemoteControl.getConnectCount());
+    case 7:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_log_dropped_total", "counter", "Deferred log records dropped")
+                      "rcu_log_dropped_total %u\n", (unsigned)deferredLog.getDropped());
+    case 8:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_ble_profile_switches_total", "counter", "Identity profile switches since boot")
+                      "rcu_ble_profile_switches_total %u\n", (unsigned)bleRemoteControl.getProfileSwitches());
+    case 9:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_config_writes_total", "counter", "NVS keys written or removed by the config store since boot")
+                      "rcu_config_writes_total %u\n", (unsigned)configStore.getWrites());
+    case 10:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_ws_commands_total", "counter", "Key commands received over the WebSocket channel")
+                      "rcu_ws_commands_total %u\n", (unsigned)controlSocket.getCommands());
+    case 11:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_udp_commands_total", "counter", "Authenticated UDP commands handled")
+                      "rcu_udp_commands_total %u\n", (unsigned)udpControl.getCommands());
+    case 12:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_udp_duplicates_total", "counter", "Retransmitted UDP commands answered from the reply cache")
+                      "rcu_udp_duplicates_total %u\n", (unsigned)udpControl.getDuplicates());
+    case 13:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_udp_dropped_total", "counter", "UDP datagrams dropped for length, version or tag")
+                      "rcu_udp_dropped_total %u\n", (unsigned)udpControl.getDropped());
+    case 14:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_heap_alarms_total", "counter", "Times the free heap or largest block fell below the alarm threshold")
+                      "rcu_heap_alarms_total %u\n", (unsigned)heapMonitor.getAlarmCount());
+    default:
+      return -1;
+  }
+}
+
+int MetricsWriter::formatGauge(uint16_t index) {
+  switch (index) {
+    case 0:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_heap_free_bytes", "gauge", "Free heap")
+                      "rcu_heap_free_bytes %u\n", (unsigned)ESP.getFreeHeap());
+    case 1:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_heap_min_free_bytes", "gauge", "Lowest free heap since boot")
+                      "rcu_heap_min_free_bytes %u\n", (unsigned)ESP.getMinFreeHeap());
+    case 2:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_heap_largest_free_block_bytes", "gauge", "Largest allocatable heap block")
+                      "rcu_heap_largest_free_block_bytes %u\n", (unsigned)ESP.getMaxAllocHeap());
+    case 3:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_wifi_rssi_dbm", "gauge", "WiFi signal strength")
+                      "rcu_wifi_rssi_dbm %d\n", wifiManager.RSSI());
+    case 4:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_battery_level_percent", "gauge", "Reported battery level")
+                      "rcu_battery_level_percent %u\n", (unsigned)bleRemoteControl.getBatteryLevel());
+    case 5:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_ble_connected", "gauge", "1 if a BLE host is connected")
+                      "rcu_ble_connected %d\n", bleRemoteControl.isConnected() ? 1 : 0);
+    case 6:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_key_queue_pending", "gauge", "Key commands waiting for the scheduler")
+                      "rcu_key_queue_pending %u\n", (unsigned)keyScheduler.pending());
+    case 7:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_uptime_seconds", "gauge", "Time since boot")
+                      "rcu_uptime_seconds %lu\n", (unsigned long)((millis() - startTime) / 1000));
+    case 8: {
+      uint32_t rate = (uint32_t)(keyScheduler.getPeakKeysPerSecond() * 100);
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_keys_per_second_peak", "gauge", "Highest key press rate achieved")
+                      "rcu_keys_per_second_peak %u.%02u\n", (unsigned)(rate / 100), (unsigned)(rate % 100));
+    }
+    case 9: {
+      uint32_t us = bleRemoteControl.getLastSwitchUs();
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_ble_profile_switch_seconds", "gauge", "Duration of the last identity switch")
+                      "rcu_ble_profile_switch_seconds %u.%06u\n", (unsigned)(us / 1000000), (unsigned)(us % 1000000));
+    }
+    case 10:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_ws_clients", "gauge", "Connected WebSocket clients")
+                      "rcu_ws_clients %u\n", (unsigned)controlSocket.getClientCount());
+    case 11:
+      return snprintf(line, sizeof(line),
+                      METRIC_HEADER("rcu_heap_fragmentation_percent", "gauge", "Share of the free heap outside the largest block")
+                      "rcu_heap_fragmentation_percent %u\n", (unsigned)heapMonitor.getSnapshot().fragmentation);
+    default:
+      return -1;
+  }
+}
+
+// One sample per core; shortest window, Prometheus averages over its own range
+int MetricsWriter::formatCpuLoad(uint16_t index) {
+  if (index == 0) {
+    return snprintf(line, sizeof(line), METRIC_HEADER("rcu_cpu_load_percent", "gauge", "Core load from the task profiler"));
+  }
+  if (index > portNUM_PROCESSORS) {
+    return -1;
+  }
+  return snprintf(line, sizeof(line), "rcu_cpu_load_percent{core=\"%u\"} %.1f\n",
+                  (unsigned)(index - 1), taskProfiler.getCoreLoad(index - 1, 0));
+}
+
+// One family per section, one sample per connected host
+int MetricsWriter::formatConnection(uint8_t family, uint16_t index) {
+  if (index == 0) {
+    switch (family) {
+      case SECTION_CONN_INTERVAL:
+        return snprintf(line, sizeof(line), METRIC_HEADER("rcu_ble_conn_interval_seconds", "gauge", "Negotiated connection interval"));
+      case SECTION_CONN_LATENCY:
+        return snprintf(line, sizeof(line), METRIC_HEADER("rcu_ble_conn_latency_events", "gauge", "Negotiated peripheral latency"));
+      case SECTION_CONN_TIMEOUT:
+        return snprintf(line, sizeof(line), METRIC_HEADER("rcu_ble_conn_supervision_timeout_seconds", "gauge", "Negotiated supervision timeout"));
+      default:
+        return snprintf(line, sizeof(line), METRIC_HEADER("rcu_ble_conn_param_updates_total", "counter", "Connection parameter updates on this connection"));
+    }
+  }
+  if (index > hostCount) {
+    return -1;
+  }
+  const HostConnectionInfo& host = hosts[index - 1];
+  switch (family) {
+    case SECTION_CONN_INTERVAL: {
+      uint32_t us = host.interval * 1250;
+      return snprintf(line, sizeof(line), "rcu_ble_conn_interval_seconds{conn=\"%u\",address=\"%s\"} %u.%06u\n",
+                      host.connId, host.address.c_str(), (unsigned)(us / 1000000), (unsigned)(us % 1000000));
+    }
+    case SECTION_CONN_LATENCY:
+      return snprintf(line, sizeof(line), "rcu_ble_conn_latency_events{conn=\"%u\",address=\"%s\"} %u\n",
+                      host.connId, host.address.c_str(), host.latency);
+    case SECTION_CONN_TIMEOUT:
+      return snprintf(line, sizeof(line), "rcu_ble_conn_supervision_timeout_seconds{conn=\"%u\",address=\"%s\"} %u.%02u\n",
+                      host.connId, host.address.c_str(), host.timeout / 100, host.timeout % 100);
+    default:
+      return snprintf(line, sizeof(line), "rcu_ble_conn_param_updates_total{conn=\"%u\",address=\"%s\"} %u\n",
+                      host.connId, host.address.c_str(), (unsigned)host.paramUpdates);
+  }
+}
+
+int MetricsWriter::formatHttpRequests(uint16_t index) {
+  if (index == 0) {
+    return snprintf(line, sizeof(line), METRIC_HEADER("rcu_http_requests_total", "counter", "HTTP requests by route and status"));
+  }
+  if (index > metrics.getRouteCount()) {
+    return -1;
+  }
+  const HttpRouteCounter& route = metrics.getRoute(index - 1);
+  return snprintf(line, sizeof(line), "rcu_http_requests_total{route=\"%s\",status=\"%u\"} %u\n",
+                  route.route, (unsigned)route.status, (unsigned)route.count);
+}
+
+int MetricsWriter::formatHttpLatency(uint16_t index) {
+  if (index == 0) {
+    cumulative = 0;
+    return snprintf(line, sizeof(line), METRIC_HEADER("rcu_http_handler_seconds", "histogram", "HTTP handler run time"));
+  }
+  if (index <= METRICS_LATENCY_BUCKETS) {
+    cumulative += metrics.getLatencyBucket(index - 1);
+    uint32_t bound = metricsLatencyBounds[index - 1];
+    return snprintf(line, sizeof(line), "rcu_http_handler_seconds_bucket{le=\"%u.%06u\"} %u\n",
+                    (unsigned)(bound / 1000000), (unsigned)(bound % 1000000), (unsigned)cumulative);
+  }
+  if (index == METRICS_LATENCY_BUCKETS + 1) {
+    uint64_t sumUs = metrics.getLatencySumUs();
+    return snprintf(line, sizeof(line),
+                    "rcu_http_handler_seconds_bucket{le=\"+Inf\"} %u\n"
+                    "rcu_http_handler_seconds_sum %u.%06u\n"
+                    "rcu_http_handler_seconds_count %u\n",
+                    (unsigned)metrics.getLatencyCount(),
+                    (unsigned)(sumUs / 1000000), (unsigned)(sumUs % 1000000),
+                    (unsigned)metrics.getLatencyCount());
+  }
+  return -1;
+}
+
+AsyncWebServerResponse* Metrics::beginResponse(AsyncWebServerRequest* request) {
+  std::shared_ptr<MetricsWriter> writer = std::make_shared<MetricsWriter>();
+  return request->beginChunkedResponse("text/plain; version=0.0.4", [writer](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+    HeapTagScope heapTag(HEAP_TAG_WEB);   // Runs from the TCP callbacks, outside the request middleware
+    return writer->fill(buffer, maxLen);
+  });
+}
+
+// Four counter families with one sample per subsystem, from the allocation hook
+int MetricsWriter::formatHeapTags(uint16_t index) {
+  static const char* const families[] = {
+    METRIC_HEADER("rcu_heap_allocations_total", "counter", "Heap allocations by subsystem"),
+    METRIC_HEADER("rcu_heap_frees_total", "counter", "Heap frees by subsystem"),
+    METRIC_HEADER("rcu_heap_allocated_bytes_total", "counter", "Heap bytes allocated by subsystem"),
+    METRIC_HEADER("rcu_heap_freed_bytes_total", "counter", "Heap bytes freed by subsystem"),
+  };
+  static const char* const names[] = {
+    "rcu_heap_allocations_total", "rcu_heap_frees_total", "rcu_heap_allocated_bytes_total", "rcu_heap_freed_bytes_total"
+  };
+  uint16_t family = index / (HEAP_TAG_COUNT + 1);
+  uint16_t sample = index % (HEAP_TAG_COUNT + 1);
+  if (!HeapMonitor::isAccounting() || family >= sizeof(families) / sizeof(families[0])) {
+    return -1;
+  }
+  if (sample == 0) {
+    return snprintf(line, sizeof(line), "%s", families[family]);
+  }
+  HeapTag tag = (HeapTag)(sample - 1);
+  HeapTagStats stats = heapMonitor.getTagStats(tag);
+  unsigned long long value;
+  switch (family) {
+    case 0:  value = stats.allocations; break;
+    case 1:  value = stats.frees; break;
+    case 2:  value = stats.allocatedBytes; break;
+    default: value = stats.freedBytes; break;
+  }
+  return snprintf(line, sizeof(line), "%s{subsystem=\"%s\"} %llu\n", names[family], HeapMonitor::tagName(tag), value);
+}
@@ -0,0 +1,55 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#define METRICS_MAX_ROUTES 48         // (route, status) pairs, further pairs are counted as route "other"
+#define METRICS_ROUTE_LENGTH 32
+#define METRICS_LINE_LENGTH 320
+
+// Upper bounds of the handler latency histogram in microseconds
+#define METRICS_LATENCY_BUCKETS 11
+const uint32_t metricsLatencyBounds[METRICS_LATENCY_BUCKETS] = {
+  500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+};
+
+struct HttpRouteCounter {
+  char route[METRICS_ROUTE_LENGTH];
+  uint16_t status;
+  uint32_t count;
+};
+
+/**
+ * @brief Counters for the Prometheus /metrics endpoint.
+ *
+ * HTTP counters are only written by the web server middleware, which runs on
+ * the AsyncTCP task like the /metrics handler itself, so they need no lock.
+ * All other values are read from their owners while the response is written.
+ */
+class Metrics {
+public:
+  void recordHttpRequest(AsyncWebServerRequest* request, uint16_t status, uint32_t durationUs);
+
+  // Streams the metrics in Prometheus text format without building the whole body
+  AsyncWebServerResponse* beginResponse(AsyncWebServerRequest* request);
+
+  size_t getRouteCount() const { return routeCount; }
+  const HttpRouteCounter& getRoute(size_t index) const { return routes[index]; }
+  uint32_t getLatencyBucket(size_t index) const { return latencyBuckets[index]; }
+  uint32_t getLatencyCount() const { return latencyCount; }
+  uint64_t getLatencySumUs() const { return latencySumUs; }
+
+private:
+  HttpRouteCounter routes[METRICS_MAX_ROUTES] = {};
+  size_t routeCount = 0;
+  uint32_t latencyBuckets[METRICS_LATENCY_BUCKETS] = {};   // Non-cumulative, summed up on output
+  uint32_t latencyCount = 0;
+  uint64_t latencySumUs = 0;
+
+  HttpRouteCounter* findRoute(const char* route, uint16_t status);
+};
+
+extern Metrics metrics;
+
+#endif // METRICS_H
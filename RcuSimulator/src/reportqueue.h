@@ -0,0 +1,114 @@
+#ifndef REPORT_QUEUE_H
+#define REPORT_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Counters of one report TX queue, exposed through diagnostics
+struct ReportQueueStats {
+  uint32_t depth;             // Reports currently waiting
+  uint32_t queued;            // Reports accepted into the queue
+  uint32_t coalesced;         // Identical reports dropped, releases merged into a full queue
+  uint32_t rejected;          // Press reports refused because the queue was full
+  uint32_t notified;          // Reports handed to the controller
+  uint32_t notifyFailures;    // notify() calls that returned an error
+  uint32_t congestionEvents;  // ESP_GATTS_CONGEST_EVT with congested = true
+  bool congested;
+};
+
+/**
+ * @brief Bounded FIFO of HID input reports for one characteristic.
+ *
+ * The caller tells whether a report is a release, i.e. it only takes keys
+ * out of the previous report (a partial release like {A} after {A,B} is one).
+ * A report identical to the previous one is dropped, except a release when
+ * nothing is pending. Press reports may only use PressLimit slots; the rest
+ * is reserved for releases.
+ *
+ * A release is never refused: presses stop at PressLimit, so in a full queue
+ * the last report is a release too. The new release replaces it; the host
+ * skips an intermediate state in which keys were still held, never a release.
+ */
+template <size_t ReportSize, size_t Capacity, size_t PressLimit = (Capacity - 1) / 2>
+class ReportQueue {
+  static_assert(Capacity >= 2 * PressLimit + 1, "Release reports must have most of the queue");
+  static_assert(PressLimit < Capacity, "The last report of a full queue must be a release");
+
+public:
+  enum PushResult { QUEUED, COALESCED, REJECTED };
+
+  PushResult push(const uint8_t* report, bool release) {
+    const uint8_t* previous = count > 0 ? entries[(head + count - 1) % Capacity] : (hasLast ? last : nullptr);
+    if (previous != nullptr && memcmp(previous, report, ReportSize) == 0 && (count > 0 || !release)) {
+      stats.coalesced++;
+      return COALESCED;
+    }
+    if (!release && count >= PressLimit) {
+      stats.rejected++;
+      return REJECTED;
+    }
+    if (count >= Capacity) {
+      memcpy(entries[(head + count - 1) % Capacity], report, ReportSize);
+      stats.coalesced++;
+      return COALESCED;
+    }
+    memcpy(entries[(head + count) % Capacity], report, ReportSize);
+    count++;
+    stats.queued++;
+    return QUEUED;
+  }
+
+  const uint8_t* front() const { return count > 0 ? entries[head] : nullptr; }
+
+  // Removes the front report after it was successfully notified
+  void pop() {
+    if (count == 0) return;
+    memcpy(last, entries[head], ReportSize);
+    hasLast = true;
+    head = (head + 1) % Capacity;
+    count--;
+    stats.notified++;
+  }
+
+  // Removes the front report without sending it (host did not subscribe)
+  void discard() {
+    if (count == 0) return;
+    head = (head + 1) % Capacity;
+    count--;
+  }
+
+  void clear() {
+    head = 0;
+    count = 0;
+    hasLast = false;
+    stats.congested = false;
+  }
+
+  bool empty() const { return count == 0; }
+  bool full() const { return count >= PressLimit; }   // No room for another press
+  size_t size() const { return count; }
+
+  void setCongested(bool congested) {
+    if (congested && !stats.congested) stats.congestionEvents++;
+    stats.congested = congested;
+  }
+  bool isCongested() const { return stats.congested; }
+  void countNotifyFailure() { stats.notifyFailures++; }
+
+  ReportQueueStats getStats() const {
+    ReportQueueStats result = stats;
+    result.depth = count;
+    return result;
+  }
+
+private:
+  uint8_t entries[Capacity][ReportSize];
+  uint8_t last[ReportSize];
+  bool hasLast = false;
+  size_t head = 0;
+  size_t count = 0;
+  ReportQueueStats stats = {};
+};
+
+#endif // REPORT_QUEUE_H
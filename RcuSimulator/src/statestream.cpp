@@ -0,0 +1,150 @@
+#include "statestream.h"
+#include "globals.h"
+#include "heapmonitor.h"
+
+StateStream::StateStream()
+    : events(STATE_EVENTS_PATH)
+{
+}
+
+void StateStream::begin(AsyncWebServer& server) {
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateMutex();
+  }
+  refresh();
+
+  events.addMiddleware([](AsyncWebServerRequest *request, ArMiddlewareNext next) {
+    if (!validateToken(request)) {
+      sendJsonResponse(request, 401, "Unauthorized: Invalid or missing token");
+      return;
+    }
+    next();
+  });
+  // A new client starts with the complete snapshot
+  events.onConnect([this](AsyncEventSourceClient *client) {
+    HeapTagScope heapTag(HEAP_TAG_WEB);
+    String tag;
+    String config = getConfig(tag);
+    client->send(config.c_str(), "hello", version, STATE_RECONNECT_MS);
+  });
+  server.addHandler(&events);
+}
+
+void StateStream::loop() {
+  if (mutex == nullptr) {
+    return;
+  }
+  refresh();
+
+  if (millis() - lastRssiCheck >= STATE_RSSI_INTERVAL_MS && wifiManager.isConnected()) {
+    lastRssiCheck = millis();
+    int rssi = wifiManager.RSSI();
+    if (abs(rssi - lastRssi) >= STATE_RSSI_THRESHOLD_DB) {
+      lastRssi = rssi;
+      char data[24];
+      snprintf(data, sizeof(data), "{\"rssi\":%d}", rssi);
+      send("rssi", data);
+    }
+  }
+}
+
+// Runs on the main loop and on the AsyncTCP task (config requests)
+void StateStream::refresh() {
+  DeviceState current;
+  current.configVersion = bleRemoteControl.getConfigVersion();
+  current.profileSwitches = bleRemoteControl.getProfileSwitches();
+  current.batteryLevel = bleRemoteControl.getBatteryLevel();
+  current.connected = bleRemoteControl.isConnected();
+  current.advertising = bleRemoteControl.isAdvertising();
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (current == state) {
+    xSemaphoreGive(mutex);
+    return;
+  }
+  DeviceState previous = state;
+  state = current;
+  version++;
+  xSemaphoreGive(mutex);
+
+  char data[64];
+  if (current.advertising != previous.advertising) {
+    snprintf(data, sizeof(data), "{\"advertising\":%s}", current.advertising ? "true" : "false");
+    send("advertising", data);
+  }
+  if (current.batteryLevel != previous.batteryLevel) {
+    snprintf(data, sizeof(data), "{\"level\":%u}", (unsigned)current.batteryLevel);
+    send("battery", data);
+  }
+  if (current.configVersion != previous.configVersion) {
+    snprintf(data, sizeof(data), "{\"etag\":\"%s\"}", etag().c_str());
+    send("config", data);
+  }
+  if (current.profileSwitches != previous.profileSwitches) {
+    String active = bleRemoteControl.getActiveProfile();
+    char profile[96];
+    snprintf(profile, sizeof(profile), "{\"active\":\"%s\",\"switchTimeUs\":%u}",
+             active.c_str(), (unsigned)bleRemoteControl.getLastSwitchUs());
+    send("profile", profile);
+  }
+}
+
+void StateStream::notifyConnection(bool connected, uint16_t connId) {
+  char data[48];
+  snprintf(data, sizeof(data), "{\"connId\":%u,\"connected\":%s}", (unsigned)connId,
+           bleRemoteControl.isConnected() ? "true" : "false");
+  send(connected ? "connect" : "disconnect", data);
+}
+
+// Called from the main loop, the queued event messages still count as web
+void StateStream::send(const char* event, const char* data) {
+  if (events.count() > 0) {
+    HeapTagScope heapTag(HEAP_TAG_WEB);
+    events.send(data, event, version);
+  }
+}
+
+// Boot count first, the version starts again at every boot
+String StateStream::etag() const {
+  return "\"" + String(bootCount) + "-" + String(version) + "\"";
+}
+
+String StateStream::getConfig(String& tag) {
+  if (mutex == nullptr) {
+    tag = "";
+    return buildConfig();
+  }
+  refresh();
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (snapshotVersion != version) {
+    snapshot = buildConfig();
+    snapshotVersion = version;
+  }
+  String config = snapshot;
+  tag = etag();
+  xSemaphoreGive(mutex);
+  return config;
+}
+
+String StateStream::buildConfig() {
+  StaticJsonDocument<512> doc;
+  doc["vendorId"] = "0x" + String(bleRemoteControl.getVendorId(), HEX);
+  doc["productId"] = "0x" + String(bleRemoteControl.getProductId(), HEX);
+  doc["versionId"] = "0x" + String(bleRemoteControl.getVersionId(), HEX);
+  doc["countryCode"] = "0x" + String(bleRemoteControl.getCountryCode(), HEX);
+  doc["hidFlags"] = "0x" + String(bleRemoteControl.getHidFlags(), HEX);
+  doc["deviceName"] = bleRemoteControl.getDeviceName();
+  doc["manufacturerName"] = bleRemoteControl.getManufacturerName();
+  doc["initialBatteryLevel"] = bleRemoteControl.getInitialBatteryLevel();
+  doc["currentBatteryLevel"] = bleRemoteControl.getBatteryLevel();
+  doc["macAddress"] = bleRemoteControl.getCurrentMacAddressString();
+  doc["usingCustomMac"] = bleRemoteControl.isUsingCustomMac();
+  doc["connected"] = bleRemoteControl.isConnected();
+  doc["advertising"] = bleRemoteControl.isAdvertising();
+  doc["activeProfile"] = bleRemoteControl.getActiveProfile();
+  doc["switching"] = bleRemoteControl.isSwitching();
+
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
@@ -0,0 +1,72 @@
+#ifndef STATE_STREAM_H
+#define STATE_STREAM_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define STATE_EVENTS_PATH "/api/events"
+#define STATE_RECONNECT_MS 2000            // Retry time sent to EventSource clients
+#define STATE_RSSI_INTERVAL_MS 2000
+#define STATE_RSSI_THRESHOLD_DB 3          // Smaller RSSI changes are not pushed
+
+// Values the BLE config snapshot depends on, compared on every refresh
+struct DeviceState {
+  uint32_t configVersion;
+  uint32_t profileSwitches;
+  uint8_t batteryLevel;
+  bool connected;
+  bool advertising;
+
+  bool operator==(const DeviceState& other) const {
+    return configVersion == other.configVersion && profileSwitches == other.profileSwitches &&
+           batteryLevel == other.batteryLevel &&
+           connected == other.connected && advertising == other.advertising;
+  }
+  bool operator!=(const DeviceState& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Pushes device state changes as Server-Sent Events.
+ *
+ * loop() compares the current state with the last one and sends an event per
+ * change ("advertising", "battery", "config", "profile", "rssi"); host connects and
+ * disconnects are sent from the BLE callback ("connect", "disconnect"). Every
+ * change of the snapshot increments the state version, which is the SSE event
+ * id and the ETag of GET /api/ble/config. The config JSON is only rebuilt
+ * after a change, a request with a matching If-None-Match gets a 304.
+ */
+class StateStream {
+public:
+  StateStream();
+
+  void begin(AsyncWebServer& server);
+  void loop();
+  void notifyConnection(bool connected, uint16_t connId);
+
+  // Current config JSON and its ETag, checks for changes first
+  String getConfig(String& etag);
+
+  uint32_t getVersion() const { return version; }
+  size_t getClientCount() const { return events.count(); }
+
+private:
+  AsyncEventSource events;
+  SemaphoreHandle_t mutex = nullptr;
+  DeviceState state = {};
+  uint32_t version = 0;
+  uint32_t snapshotVersion = UINT32_MAX;   // Version the cached JSON belongs to
+  String snapshot;
+  int lastRssi = 0;
+  uint32_t lastRssiCheck = 0;
+
+  void refresh();
+  void send(const char* event, const char* data);
+  String etag() const;
+  static String buildConfig();
+};
+
+extern StateStream stateStream;
+
+#endif // STATE_STREAM_H
@@ -0,0 +1,161 @@
+#include "taskprofiler.h"
+
+bool TaskProfiler::isAvailable() {
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool TaskProfiler::begin() {
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateMutex();
+  }
+  return mutex != nullptr;
+}
+
+void TaskProfiler::loop() {
+  if (mutex == nullptr || !isAvailable()) {
+    return;
+  }
+  if (sampleCount == 0 || millis() - lastSampleAt >= TASK_PROFILER_INTERVAL_MS) {
+    lastSampleAt = millis();
+    sample();
+  }
+}
+
+TaskProfiler::TaskSlot* TaskProfiler::findSlot(uint32_t taskNumber) {
+  TaskSlot* freeSlot = nullptr;
+  for (TaskSlot& slot : slots) {
+    if (slot.used && slot.profile.taskNumber == taskNumber) {
+      return &slot;
+    }
+    if (!slot.used && freeSlot == nullptr) {
+      freeSlot = &slot;
+    }
+  }
+  return freeSlot;
+}
+
+// CPU share over the window, limited to the samples since the task appeared
+float TaskProfiler::share(const TaskSlot& slot, uint8_t window) const {
+  uint32_t latest = sampleCount - 1;
+  uint32_t intervals = taskProfilerWindows[window];
+  if (intervals > latest - slot.firstSample) {
+    intervals = latest - slot.firstSample;
+  }
+  if (intervals == 0) {
+    return 0;
+  }
+  uint32_t now = latest % TASK_PROFILER_HISTORY;
+  uint32_t then = (latest - intervals) % TASK_PROFILER_HISTORY;
+  uint32_t total = totalRunTime[now] - totalRunTime[then];   // Wraps like the counters
+  if (total == 0) {
+    return 0;
+  }
+  return (slot.runTime[now] - slot.runTime[then]) * 100.0f / total;
+}
+
+void TaskProfiler::sample() {
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+  uint32_t total = 0;
+  // Suspends the scheduler while the task lists are walked, a few us per task
+  UBaseType_t count = uxTaskGetSystemState(status, TASK_PROFILER_MAX_TASKS, &total);
+  if (count == 0) {
+    untracked = uxTaskGetNumberOfTasks();
+    return;
+  }
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint32_t index = sampleCount % TASK_PROFILER_HISTORY;
+  totalRunTime[index] = total;
+  sampleCount++;
+  untracked = 0;
+
+  bool seen[TASK_PROFILER_MAX_TASKS] = {};
+  for (UBaseType_t i = 0; i < count; i++) {
+    const TaskStatus_t& task = status[i];
+    TaskSlot* slot = findSlot(task.xTaskNumber);
+    if (slot == nullptr) {
+      untracked++;
+      continue;
+    }
+    if (!slot->used) {
+      memset(slot, 0, sizeof(TaskSlot));
+      slot->used = true;
+      slot->firstSample = sampleCount - 1;
+      slot->profile.taskNumber = task.xTaskNumber;
+      strlcpy(slot->profile.name, task.pcTaskName, sizeof(slot->profile.name));
+    }
+    seen[slot - slots] = true;
+    slot->runTime[index] = task.ulRunTimeCounter;
+    slot->profile.priority = task.uxCurrentPriority;
+    slot->profile.stackHighWater = task.usStackHighWaterMark * sizeof(StackType_t);
+#if configTASKLIST_INCLUDE_COREID
+    slot->profile.core = task.xCoreID == tskNO_AFFINITY ? -1 : task.xCoreID;
+#else
+    slot->profile.core = -1;
+#endif
+  }
+
+  // Deleted tasks free their slot, the task number of a new task is never reused
+  for (size_t i = 0; i < TASK_PROFILER_MAX_TASKS; i++) {
+    if (slots[i].used && !seen[i]) {
+      slots[i].used = false;
+    } else if (slots[i].used) {
+      for (uint8_t w = 0; w < TASK_PROFILER_WINDOW_COUNT; w++) {
+        slots[i].profile.cpu[w] = share(slots[i], w);
+      }
+    }
+  }
+
+  // Core load is what the idle task of the core did not get
+  for (UBaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+    TaskHandle_t idle = xTaskGetIdleTaskHandleForCPU(core);
+    for (UBaseType_t i = 0; i < count; i++) {
+      if (status[i].xHandle != idle) {
+        continue;
+      }
+      TaskSlot* slot = findSlot(status[i].xTaskNumber);
+      for (uint8_t w = 0; slot != nullptr && slot->used && w < TASK_PROFILER_WINDOW_COUNT; w++) {
+        float load = 100.0f - slot->profile.cpu[w];
+        coreLoad[core][w] = load < 0 ? 0 : load;
+      }
+    }
+  }
+  xSemaphoreGive(mutex);
+#endif
+}
+
+size_t TaskProfiler::getTasks(TaskProfile* out, size_t maxCount) const {
+  if (mutex == nullptr) {
+    return 0;
+  }
+  size_t count = 0;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  for (const TaskSlot& slot : slots) {
+    if (!slot.used || count >= maxCount) {
+      continue;
+    }
+    // Insertion sort, busiest task first
+    size_t pos = count++;
+    while (pos > 0 && out[pos - 1].cpu[0] < slot.profile.cpu[0]) {
+      out[pos] = out[pos - 1];
+      pos--;
+    }
+    out[pos] = slot.profile;
+  }
+  xSemaphoreGive(mutex);
+  return count;
+}
+
+float TaskProfiler::getCoreLoad(uint8_t core, uint8_t window) const {
+  if (mutex == nullptr || core >= portNUM_PROCESSORS || window >= TASK_PROFILER_WINDOW_COUNT) {
+    return 0;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  float load = coreLoad[core][window];
+  xSemaphoreGive(mutex);
+  return load;
+}
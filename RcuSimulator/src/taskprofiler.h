@@ -0,0 +1,76 @@
+#ifndef TASK_PROFILER_H
+#define TASK_PROFILER_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define TASK_PROFILER_MAX_TASKS 32        // More tasks than this and no sample is taken
+#define TASK_PROFILER_INTERVAL_MS 2000
+#define TASK_PROFILER_HISTORY 31          // Samples kept, covers the longest window
+#define TASK_PROFILER_WINDOW_COUNT 3
+
+// Window lengths in sample intervals: 2 s, 10 s, 60 s
+const uint8_t taskProfilerWindows[TASK_PROFILER_WINDOW_COUNT] = {1, 5, 30};
+
+// One task as seen in the last sample
+struct TaskProfile {
+  char name[configMAX_TASK_NAME_LEN];
+  uint32_t taskNumber;
+  uint8_t priority;
+  int8_t core;                  // -1 = no affinity
+  uint32_t stackHighWater;      // Smallest free stack so far in bytes
+  float cpu[TASK_PROFILER_WINDOW_COUNT];   // Percent of one core, per window
+};
+
+/**
+ * @brief Per-task CPU time and stack high-water marks from uxTaskGetSystemState().
+ *
+ * loop() samples the FreeRTOS run time counters every TASK_PROFILER_INTERVAL_MS
+ * and keeps a short history, so the CPU share of every task is known over
+ * sliding windows of taskProfilerWindows[] intervals. 100 % means the task kept
+ * one core busy for the whole window; the load of a core is 100 % minus the
+ * share of its idle task. Windows of a task that started recently only cover
+ * its lifetime. Readers (web server, CLI) get a copy under the mutex.
+ */
+class TaskProfiler {
+public:
+  bool begin();
+  void loop();
+
+  size_t getTasks(TaskProfile* out, size_t maxCount) const;   // Sorted by CPU share of the shortest window
+  float getCoreLoad(uint8_t core, uint8_t window) const;
+  uint32_t getSamples() const { return sampleCount; }
+  uint32_t getUntracked() const { return untracked; }          // Tasks not profiled, table full
+
+  static bool isAvailable();
+  static uint32_t windowSeconds(uint8_t window) {
+    return taskProfilerWindows[window] * TASK_PROFILER_INTERVAL_MS / 1000;
+  }
+
+private:
+  struct TaskSlot {
+    TaskProfile profile;
+    bool used;
+    uint32_t firstSample;                      // Sample in which the task was first seen
+    uint32_t runTime[TASK_PROFILER_HISTORY];
+  };
+
+  TaskSlot slots[TASK_PROFILER_MAX_TASKS] = {};
+  uint32_t totalRunTime[TASK_PROFILER_HISTORY] = {};
+  float coreLoad[portNUM_PROCESSORS][TASK_PROFILER_WINDOW_COUNT] = {};
+  uint32_t sampleCount = 0;
+  uint32_t untracked = 0;
+  uint32_t lastSampleAt = 0;
+  SemaphoreHandle_t mutex = nullptr;
+  TaskStatus_t status[TASK_PROFILER_MAX_TASKS];   // Buffer of the last sample, not on the loop stack
+
+  void sample();
+  TaskSlot* findSlot(uint32_t taskNumber);
+  float share(const TaskSlot& slot, uint8_t window) const;
+};
+
+extern TaskProfiler taskProfiler;
+
+#endif // TASK_PROFILER_H
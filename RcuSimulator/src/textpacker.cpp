@@ -0,0 +1,104 @@
+#include "textpacker.h"
+
+TextPacker::TextPacker(const char* text, size_t length, uint8_t rollover)
+    : text(text), length(length),
+      rollover(rollover == 0 || rollover > TEXT_PACKER_MAX_ROLLOVER ? TEXT_PACKER_MAX_ROLLOVER : rollover)
+{
+}
+
+bool TextPacker::usageFor(char c, uint8_t& usage, uint8_t& modifiers) {
+  if ((uint8_t)c >= sizeof(_asciimap)) {
+    return false;
+  }
+  usage = pgm_read_byte(_asciimap + (uint8_t)c);
+  modifiers = (usage & SHIFT) ? 0x02 : 0;   // Left shift, as in translateKey()
+  usage &= ~SHIFT;
+  return usage != 0;
+}
+
+bool TextPacker::isEmpty(const KeyReport& report) {
+  for (uint8_t i = 0; i < 6; i++) {
+    if (report.keys[i] != 0) {
+      return false;
+    }
+  }
+  return report.modifiers == 0;
+}
+
+int TextPacker::findUntypable(const char* text, size_t length) {
+  uint8_t usage;
+  uint8_t modifiers;
+  for (size_t i = 0; i < length; i++) {
+    if (!usageFor(text[i], usage, modifiers)) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+size_t TextPacker::countReports(const char* text, size_t length, uint8_t rollover) {
+  TextPacker packer(text, length, rollover);
+  KeyReport report;
+  size_t count = 0;
+  while (packer.next(report)) {
+    count++;
+  }
+  return count;
+}
+
+bool TextPacker::next(KeyReport& report) {
+  characters = 0;
+  report = {};
+
+  uint8_t usage;
+  uint8_t modifiers;
+  while (pos < length && !usageFor(text[pos], usage, modifiers)) {
+    pos++;   // Callers reject such text up front, skip it if they did not
+  }
+  if (pos >= length) {
+    if (isEmpty(current)) {
+      return false;
+    }
+    current = {};
+    return true;   // Final release
+  }
+
+  // Collect the next group of characters with the same shift state
+  KeyReport group = {};
+  group.modifiers = modifiers;
+  size_t end = pos;
+  uint8_t count = 0;
+  while (end < length && count < rollover) {
+    uint8_t nextModifiers;
+    if (!usageFor(text[end], usage, nextModifiers) || nextModifiers != group.modifiers) {
+      break;
+    }
+    bool repeated = false;
+    for (uint8_t i = 0; i < count; i++) {
+      repeated |= group.keys[i] == usage;
+    }
+    if (repeated) {
+      break;
+    }
+    group.keys[count++] = usage;
+    end++;
+  }
+
+  // The host only sees a press if the key was up in the previous report
+  bool conflict = !isEmpty(current) && current.modifiers != group.modifiers;
+  for (uint8_t i = 0; i < count && !conflict; i++) {
+    for (uint8_t j = 0; j < 6; j++) {
+      conflict |= current.keys[j] == group.keys[i];
+    }
+  }
+  if (conflict) {
+    current = {};
+    return true;   // Release first, the group follows with the next call
+  }
+
+  current = group;
+  report = group;
+  characters = count;
+  pos = end;
+  return true;
+}
@@ -0,0 +1,47 @@
+#ifndef TEXT_PACKER_H
+#define TEXT_PACKER_H
+
+#include <Arduino.h>
+#include "BleRemoteControl.h"
+
+#define TEXT_PACKER_MAX_ROLLOVER 6   // Key slots in a KeyReport
+
+/**
+ * @brief Turns ASCII text into the shortest series of keyboard reports.
+ *
+ * Consecutive characters share one report (in typing order, one slot each)
+ * while they need the same shift state, are distinct and fit into the
+ * rollover limit. A report that follows directly replaces the previous one
+ * when it shares no key and no shift state change; otherwise an all-released
+ * report goes in between so the host sees every press. The last report
+ * releases all keys.
+ */
+class TextPacker {
+public:
+  TextPacker(const char* text, size_t length, uint8_t rollover = TEXT_PACKER_MAX_ROLLOVER);
+
+  // Next report to send, false once the text is done
+  bool next(KeyReport& report);
+
+  // Characters typed by the report last returned from next()
+  uint8_t lastCharacters() const { return characters; }
+
+  // Index of the first character without a HID usage, or -1 if all can be typed
+  static int findUntypable(const char* text, size_t length);
+
+  // Number of reports next() will return for this text
+  static size_t countReports(const char* text, size_t length, uint8_t rollover = TEXT_PACKER_MAX_ROLLOVER);
+
+private:
+  const char* text;
+  size_t length;
+  uint8_t rollover;
+  size_t pos = 0;
+  KeyReport current = {};   // Keys the host currently sees pressed
+  uint8_t characters = 0;
+
+  static bool usageFor(char c, uint8_t& usage, uint8_t& modifiers);
+  static bool isEmpty(const KeyReport& report);
+};
+
+#endif // TEXT_PACKER_H
@@ -0,0 +1,207 @@
+#include "udpcontrol.h"
+#include "globals.h"
+#include "heapmonitor.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "mbedtls/md.h"
+
+bool UdpControl::begin(uint16_t port) {
+  if (listening) {
+    return true;
+  }
+  if (!udp.listen(port)) {
+    Serial.println("UDP control: failed to listen on port " + String(port));
+    return false;
+  }
+  udp.onPacket([this](AsyncUDPPacket& packet) {
+    HeapTagScope heapTag(HEAP_TAG_WEB);
+    onPacket(packet);
+  });
+  listening = true;
+  Serial.println("UDP control listening on port " + String(port));
+  return true;
+}
+
+void UdpControl::sign(const uint8_t* data, size_t length, uint8_t tag[UDP_CONTROL_TAG_LENGTH]) {
+  uint8_t digest[32];
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const uint8_t*)authToken.c_str(), authToken.length(),
+                  data, length, digest);
+  memcpy(tag, digest, UDP_CONTROL_TAG_LENGTH);
+}
+
+bool UdpControl::verify(const UdpRequest& request) {
+  uint8_t tag[UDP_CONTROL_TAG_LENGTH];
+  sign((const uint8_t*)&request, offsetof(UdpRequest, tag), tag);
+  uint8_t diff = 0;   // Constant time, the tag must not leak byte by byte
+  for (uint8_t i = 0; i < UDP_CONTROL_TAG_LENGTH; i++) {
+    diff |= tag[i] ^ request.tag[i];
+  }
+  return diff == 0;
+}
+
+UdpSession* UdpControl::findSession(uint32_t id) {
+  if (id == 0) {
+    return nullptr;
+  }
+  for (UdpSession& session : sessions) {
+    if (session.id == id) {
+      return &session;
+    }
+  }
+  return nullptr;
+}
+
+// The session of a repeated nonce as it is (a retransmit after a lost ACK),
+// else a free slot or the session that was quiet the longest if it is idle.
+// nullptr if all sessions are in use.
+UdpSession* UdpControl::openSession(uint32_t nonce, uint32_t sequence) {
+  UdpSession* oldest = nullptr;
+  for (UdpSession& session : sessions) {
+    if (session.id != 0 && session.nonce == nonce) {
+      return &session;
+    }
+  }
+  for (UdpSession& session : sessions) {
+    if (session.id == 0) {
+      oldest = &session;
+      break;
+    }
+    if (oldest == nullptr || session.lastSeenMs - oldest->lastSeenMs > 0x80000000UL) {
+      oldest = &session;
+    }
+  }
+  if (oldest->id != 0 && millis() - oldest->lastSeenMs < UDP_CONTROL_SESSION_IDLE_MS) {
+    return nullptr;
+  }
+  uint32_t id;
+  do {
+    id = esp_random();
+  } while (id == 0 || findSession(id) != nullptr);
+
+  *oldest = {};        // Cached replies of the previous session must not be resent
+  oldest->id = id;
+  oldest->nonce = nonce;
+  oldest->lastSeenMs = millis();
+  oldest->highest = sequence;
+  oldest->seen = 1;
+  return oldest;
+}
+
+void UdpControl::onPacket(AsyncUDPPacket& packet) {
+  int64_t receivedAt = esp_timer_get_time();
+  if (packet.length() != sizeof(UdpRequest)) {
+    dropped++;
+    return;
+  }
+  UdpRequest request;
+  memcpy(&request, packet.data(), sizeof(request));
+  if (request.version != UDP_CONTROL_VERSION || !verify(request)) {
+    dropped++;
+    return;
+  }
+
+  bool sync = request.opcode == UDP_OP_SYNC;
+  UdpSession* session = sync ? openSession(request.session, request.sequence) : findSession(request.session);
+  bool run = session != nullptr;
+  UdpStatus status = run ? UDP_STATUS_OK : (sync ? UDP_STATUS_NO_ROOM : UDP_STATUS_NO_SESSION);
+  UdpReply* cached = nullptr;
+
+  // Sliding window as in IPsec anti-replay: newer sequences move it, older
+  // ones inside it are either retransmits or late arrivals
+  if (session != nullptr && !sync) {
+    session->lastSeenMs = millis();
+    cached = &session->replies[request.sequence % UDP_CONTROL_WINDOW];
+    int32_t distance = (int32_t)(request.sequence - session->highest);
+    if (distance > 0) {
+      session->seen = distance < UDP_CONTROL_WINDOW ? (session->seen << distance) | 1 : 1;
+      session->highest = request.sequence;
+    } else if (distance <= -UDP_CONTROL_WINDOW) {   // Also INT32_MIN, which cannot be negated
+      run = false;
+      status = UDP_STATUS_STALE;
+    } else if (session->seen & (1UL << -distance)) {
+      if (cached->sequence == request.sequence && cached->version != 0) {
+        duplicates++;
+        packet.write((const uint8_t*)cached, sizeof(*cached));
+        return;
+      }
+      run = false;
+      status = UDP_STATUS_STALE;
+    } else {
+      session->seen |= 1UL << -distance;
+    }
+  }
+
+  uint32_t requestId = 0;
+  if (run) {
+    commands++;
+    status = sync ? UDP_STATUS_OK : execute(request, requestId);
+  }
+
+  UdpReply reply = {};
+  reply.version = UDP_CONTROL_VERSION;
+  reply.opcode = status == UDP_STATUS_OK ? UDP_OP_ACK : UDP_OP_NACK;
+  reply.status = status;
+  reply.session = session != nullptr ? session->id : request.session;
+  reply.sequence = request.sequence;
+  reply.requestId = requestId;
+  reply.receivedUs = receivedAt;
+  reply.handledUs = (uint32_t)(esp_timer_get_time() - receivedAt);
+  sign((const uint8_t*)&reply, offsetof(UdpReply, tag), reply.tag);
+  if (run && cached != nullptr) {
+    if (status == UDP_STATUS_BUSY || status == UDP_STATUS_QUEUE_FULL) {
+      // Nothing was queued, a retransmit of the sequence runs the command again
+      session->seen &= ~(1UL << (session->highest - request.sequence));
+    } else {
+      *cached = reply;   // Other NACKs too, a retransmit gets the same answer
+    }
+  }
+  packet.write((const uint8_t*)&reply, sizeof(reply));
+}
+
+UdpStatus UdpControl::execute(const UdpRequest& request, uint32_t& requestId) {
+  uint8_t target = request.target;
+  uint32_t holdMs = request.holdMs == UDP_HOLD_AUTO ? KEY_HOLD_AUTO : request.holdMs;
+  KeyId key((KeyId::Kind)request.kind, request.code);
+
+  switch (request.opcode) {
+    case UDP_OP_TAP:
+    case UDP_OP_PRESS:
+    case UDP_OP_RELEASE:
+      if (request.kind != KeyId::KIND_KEYBOARD && request.kind != KeyId::KIND_MEDIA) {
+        return UDP_STATUS_BAD_KEY;
+      }
+      break;
+    case UDP_OP_RAW_TAP:
+      if (request.code == 0) {
+        return UDP_STATUS_BAD_KEY;
+      }
+      break;
+    case UDP_OP_RELEASE_ALL:
+      break;
+    default:
+      return UDP_STATUS_BAD_OPCODE;
+  }
+
+  bool tap = request.opcode == UDP_OP_TAP || request.opcode == UDP_OP_RAW_TAP;
+  if (tap && holdMs != KEY_HOLD_AUTO && holdMs > KEY_HOLD_MAX_MS) {
+    return UDP_STATUS_BAD_HOLD;
+  }
+
+  if (!bleRemoteControl.isConnected(target)) {
+    return UDP_STATUS_NOT_CONNECTED;
+  }
+  // Releases always have room in the TX queue
+  bool pressing = request.opcode == UDP_OP_TAP || request.opcode == UDP_OP_PRESS || request.opcode == UDP_OP_RAW_TAP;
+  if (pressing && bleRemoteControl.isTxQueueFull(target)) {
+    return UDP_STATUS_BUSY;
+  }
+
+  switch (request.opcode) {
+    case UDP_OP_TAP:         requestId = keyScheduler.tap(key, holdMs, target); break;
+    case UDP_OP_PRESS:       requestId = keyScheduler.press(key, target); break;
+    case UDP_OP_RELEASE:     requestId = keyScheduler.release(key, target); break;
+    case UDP_OP_RAW_TAP:     requestId = keyScheduler.tapMedia(request.code, 0, holdMs, target); break;
+    case UDP_OP_RELEASE_ALL: requestId = keyScheduler.releaseAll(target); break;
+  }
+  return requestId != 0 ? UDP_STATUS_OK : UDP_STATUS_QUEUE_FULL;
+}
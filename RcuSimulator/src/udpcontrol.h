@@ -0,0 +1,122 @@
+#ifndef UDP_CONTROL_H
+#define UDP_CONTROL_H
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <atomic>
+
+#define UDP_CONTROL_PORT 4210
+#define UDP_CONTROL_VERSION 2
+#define UDP_CONTROL_TAG_LENGTH 8           // Truncated HMAC-SHA256 keyed with the auth token
+#define UDP_CONTROL_MAX_SESSIONS 4         // Sessions with their own sequence window
+#define UDP_CONTROL_WINDOW 32              // Sequence numbers remembered per session
+#define UDP_CONTROL_SESSION_IDLE_MS 30000  // A session quiet for less is never replaced by a sync
+#define UDP_HOLD_AUTO 0xFFFF               // holdMs value for the adaptive hold
+
+enum UdpOpcode : uint8_t {
+  UDP_OP_TAP = 1,        // Key (kind, code), held for holdMs
+  UDP_OP_PRESS,
+  UDP_OP_RELEASE,
+  UDP_OP_RAW_TAP,        // Consumer usage in code, held for holdMs
+  UDP_OP_RELEASE_ALL,
+  UDP_OP_SYNC,           // Opens a session for the nonce in session, its window starts at this sequence
+  UDP_OP_ACK = 0x80,
+  UDP_OP_NACK = 0x81
+};
+
+enum UdpStatus : uint8_t {
+  UDP_STATUS_OK = 0,
+  UDP_STATUS_STALE,      // Sequence older than the window, not executed
+  UDP_STATUS_BAD_OPCODE,
+  UDP_STATUS_BAD_KEY,
+  UDP_STATUS_NOT_CONNECTED,
+  UDP_STATUS_BUSY,       // BLE TX queue full
+  UDP_STATUS_QUEUE_FULL, // Key scheduler queue full
+  UDP_STATUS_BAD_HOLD,   // holdMs above KEY_HOLD_MAX_MS
+  UDP_STATUS_NO_SESSION, // Session unknown (evicted or device restarted), sync again
+  UDP_STATUS_NO_ROOM     // Sync refused, all sessions were active within UDP_CONTROL_SESSION_IDLE_MS
+};
+
+// Both frames are little-endian, the tag covers all bytes before it
+struct UdpRequest {
+  uint8_t version;
+  uint8_t opcode;
+  uint8_t target;        // conn_id or BLE_TARGET_ALL
+  uint8_t kind;          // KeyId::Kind for TAP/PRESS/RELEASE
+  uint32_t session;      // From the ACK of UDP_OP_SYNC; in the sync a random nonce of the sender
+  uint32_t sequence;
+  uint16_t code;
+  uint16_t holdMs;       // UDP_HOLD_AUTO for the adaptive hold
+  uint8_t tag[UDP_CONTROL_TAG_LENGTH];
+} __attribute__((packed));
+
+struct UdpReply {
+  uint8_t version;
+  uint8_t opcode;        // UDP_OP_ACK or UDP_OP_NACK
+  uint8_t status;
+  uint8_t reserved;
+  uint32_t session;      // Of the request; the ACK of a sync carries the new one
+  uint32_t sequence;
+  uint32_t requestId;    // Key scheduler request, 0 for a NACK
+  uint64_t receivedUs;   // esp_timer time the request arrived
+  uint32_t handledUs;    // Time from arrival until the command was queued
+  uint8_t tag[UDP_CONTROL_TAG_LENGTH];
+} __attribute__((packed));
+
+static_assert(sizeof(UdpRequest) == 24, "UdpRequest layout changed");
+static_assert(sizeof(UdpReply) == 36, "UdpReply layout changed");
+
+// Sequence window of one session, with the replies sent for it
+struct UdpSession {
+  uint32_t id;                             // Random, 0 = slot free
+  uint32_t nonce;                          // Of the sync that opened it
+  uint32_t lastSeenMs;
+  uint32_t highest;                        // Highest sequence seen
+  uint32_t seen;                           // Bit i: highest - i was handled
+  UdpReply replies[UDP_CONTROL_WINDOW];    // Indexed by sequence % UDP_CONTROL_WINDOW
+};
+
+/**
+ * @brief Connectionless binary fast path for key commands.
+ *
+ * A request is one 24 byte datagram and is answered by one ACK or NACK with
+ * the device timestamps, so a test runner can retransmit on loss instead of
+ * waiting for TCP. A retransmitted sequence is not executed again, the
+ * original reply is sent once more. Datagrams with a wrong tag or layout are
+ * dropped without reply.
+ *
+ * Commands belong to a session opened by UDP_OP_SYNC. The device picks the
+ * session ID at random and it is covered by the tag, so a recorded datagram
+ * only runs in its own session: a replayed sync never resets a window, and
+ * an evicted session or one from before a restart is not accepted again. A
+ * sync with the nonce of an open session gets that session back, and a sync
+ * only replaces a session that was idle for UDP_CONTROL_SESSION_IDLE_MS, so
+ * replayed syncs cannot push active senders out.
+ */
+class UdpControl {
+public:
+  bool begin(uint16_t port = UDP_CONTROL_PORT);
+
+  uint32_t getCommands() const { return commands.load(); }
+  uint32_t getDuplicates() const { return duplicates.load(); }
+  uint32_t getDropped() const { return dropped.load(); }
+
+private:
+  AsyncUDP udp;
+  bool listening = false;
+  UdpSession sessions[UDP_CONTROL_MAX_SESSIONS] = {};
+  std::atomic<uint32_t> commands{0};
+  std::atomic<uint32_t> duplicates{0};
+  std::atomic<uint32_t> dropped{0};
+
+  void onPacket(AsyncUDPPacket& packet);
+  UdpSession* findSession(uint32_t id);
+  UdpSession* openSession(uint32_t nonce, uint32_t sequence);
+  UdpStatus execute(const UdpRequest& request, uint32_t& requestId);
+  static void sign(const uint8_t* data, size_t length, uint8_t tag[UDP_CONTROL_TAG_LENGTH]);
+  static bool verify(const UdpRequest& request);
+};
+
+extern UdpControl udpControl;
+
+#endif // UDP_CONTROL_H
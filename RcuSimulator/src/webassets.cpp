@@ -0,0 +1,186 @@
+// Generated by tools/build_webassets.py from web/, do not edit
+#include "webpages.h"
+
+// web/console.css, 381 bytes gzipped
+static const uint8_t WEB_ASSET_0[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x6d, 0x92, 0xdd, 0x6e, 0x83, 0x30,
+  0x0c, 0x85, 0xef, 0xfb, 0x14, 0x48, 0xbd, 0xd9, 0xa4, 0xa5, 0x0a, 0x74, 0x63, 0x5b, 0xb8, 0xda,
+  0xa3, 0x18, 0x12, 0xa8, 0xb5, 0x24, 0x8e, 0x92, 0xd0, 0x9f, 0xa1, 0xbe, 0xfb, 0x02, 0x0d, 0x55,
+  0x27, 0x4d, 0x48, 0x5c, 0x18, 0x7c, 0x3e, 0x9f, 0x63, 0xb7, 0x24, 0x2f, 0x53, 0x4f, 0x36, 0xb2,
+  0x1e, 0x0c, 0xea, 0x8b, 0xf8, 0xf2, 0x08, 0xfa, 0x25, 0x80, 0x0d, 0x2c, 0x28, 0x8f, 0x7d, 0x63,
+  0xc0, 0x0f, 0x68, 0x45, 0xc5, 0xdd, 0xb9, 0xd1, 0x68, 0x15, 0x3b, 0x28, 0x1c, 0x0e, 0x51, 0x94,
+  0xbb, 0xfa, 0xba, 0x39, 0x94, 0x53, 0x47, 0x9a, 0xbc, 0xd8, 0x72, 0x5e, 0xd7, 0x5d, 0x97, 0x2a,
+  0xd5, 0xdf, 0x4a, 0xee, 0x67, 0x91, 0xdc, 0xa2, 0x71, 0xdd, 0xec, 0xba, 0x84, 0x83, 0xa4, 0xe4,
+  0x27, 0x03, 0x67, 0x76, 0x42, 0x19, 0x0f, 0xe2, 0x83, 0xcf, 0xfa, 0x99, 0xc5, 0x0b, 0x18, 0x23,
+  0x35, 0x0e, 0xa4, 0x44, 0x3b, 0xdc, 0xd0, 0x2d, 0x79, 0xa9, 0xbc, 0x28, 0xdd, 0xb9, 0x08, 0xa4,
+  0x51, 0x16, 0x5b, 0x29, 0x65, 0xae, 0x32, 0x0f, 0x12, 0xc7, 0x20, 0xde, 0x16, 0x79, 0xb4, 0x3d,
+  0x4d, 0x99, 0xda, 0x52, 0x8c, 0x64, 0x44, 0x79, 0x03, 0x83, 0xc3, 0x64, 0xaa, 0x8b, 0x48, 0x76,
+  0x7a, 0x18, 0xab, 0x4c, 0x7d, 0x77, 0x58, 0xb9, 0xc0, 0xa0, 0xfb, 0x1e, 0x3c, 0x8d, 0x56, 0x8a,
+  0x6d, 0xff, 0x3e, 0x3f, 0xff, 0x92, 0x1c, 0x78, 0x30, 0xe1, 0x16, 0x5f, 0xc0, 0x1f, 0x25, 0xf8,
+  0xee, 0x53, 0x99, 0x26, 0xfb, 0xaf, 0xeb, 0x7a, 0x35, 0xaf, 0x55, 0x1f, 0xb3, 0xfb, 0x76, 0x4c,
+  0x13, 0xad, 0x78, 0x51, 0x3d, 0x90, 0xeb, 0x64, 0xad, 0xac, 0xb2, 0xb0, 0x9c, 0x24, 0x06, 0xa7,
+  0xe1, 0x22, 0x06, 0x8f, 0xb2, 0x99, 0x5f, 0x2c, 0x2a, 0x93, 0x2a, 0x51, 0xb1, 0x04, 0x18, 0x8d,
+  0x0d, 0xc2, 0x2b, 0xa7, 0x20, 0x3e, 0xed, 0x5f, 0xca, 0xde, 0x3f, 0x37, 0x03, 0x38, 0xf1, 0xba,
+  0x84, 0xb8, 0x86, 0xba, 0xaf, 0xf9, 0x2a, 0x57, 0x64, 0xee, 0xdd, 0x66, 0xfa, 0xb3, 0xe0, 0xe9,
+  0x5b, 0x88, 0x49, 0x71, 0x7a, 0x9c, 0x73, 0x49, 0x60, 0xf1, 0x74, 0xba, 0x6d, 0xba, 0x25, 0x2d,
+  0x57, 0x53, 0x1d, 0xbf, 0x37, 0xed, 0x34, 0x1e, 0xd5, 0x7d, 0xd9, 0x9f, 0x73, 0x5d, 0xd3, 0xf0,
+  0xe7, 0x98, 0x0c, 0x59, 0x0a, 0x0e, 0x3a, 0xd5, 0x3c, 0x66, 0xf4, 0xf1, 0x96, 0x42, 0x9a, 0xa7,
+  0xcc, 0x97, 0x54, 0xbd, 0xce, 0x44, 0x3a, 0x2a, 0xdf, 0x6b, 0x3a, 0xb1, 0x8b, 0x58, 0xb6, 0xbf,
+  0xde, 0xc2, 0x75, 0xf3, 0x0b, 0xea, 0x8f, 0xb4, 0x33, 0xa4, 0x02, 0x00, 0x00,
+};
+
+// web/console.js, 1387 bytes gzipped
+static const uint8_t WEB_ASSET_1[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xb5, 0x57, 0x4b, 0x6f, 0xdc, 0x36,
+  0x10, 0xbe, 0xfb, 0x57, 0xb0, 0x41, 0x00, 0x69, 0xd1, 0x8d, 0xec, 0xa2, 0xe9, 0x25, 0x82, 0x6b,
+  0x24, 0xb6, 0x81, 0xba, 0x70, 0xd3, 0x20, 0x4e, 0x4e, 0x41, 0x0e, 0xb4, 0x34, 0xda, 0x65, 0xcd,
+  0x25, 0xb7, 0x24, 0xb5, 0x9b, 0x85, 0xe3, 0xff, 0xde, 0x19, 0x92, 0xd2, 0x52, 0x2b, 0x39, 0x71,
+  0x0e, 0xbd, 0xd8, 0x2b, 0x6a, 0x1e, 0xdf, 0xbc, 0x3e, 0x8e, 0xb2, 0xd6, 0x02, 0xb3, 0xce, 0x88,
+  0xca, 0x65, 0xe5, 0xd1, 0xf1, 0x31, 0xbb, 0x16, 0x1b, 0x60, 0x35, 0x77, 0x9c, 0x55, 0x7a, 0x05,
+  0x96, 0x35, 0x46, 0xaf, 0x98, 0x5b, 0x02, 0xfb, 0xf3, 0xe6, 0xef, 0xb7, 0xec, 0xf5, 0xbb, 0x2b,
+  0xcb, 0xb8, 0xaa, 0xd9, 0x31, 0x5f, 0x8b, 0x63, 0xd8, 0x80, 0x72, 0x76, 0xee, 0x5f, 0xaf, 0xf9,
+  0x02, 0x98, 0x70, 0x16, 0x64, 0xc3, 0x84, 0x45, 0x93, 0xdc, 0x89, 0xaa, 0x38, 0xca, 0x9b, 0x56,
+  0x55, 0x4e, 0x68, 0xc5, 0xf2, 0x19, 0xbb, 0x3f, 0x62, 0x6c, 0xc3, 0x0d, 0x73, 0xfa, 0x0e, 0x14,
+  0x3b, 0x65, 0x52, 0x57, 0x5c, 0xde, 0x38, 0x6d, 0x50, 0xb7, 0x58, 0x80, 0xbb, 0x72, 0xb0, 0xca,
+  0x33, 0x53, 0xb5, 0x1f, 0x48, 0x20, 0x9b, 0xb1, 0xaf, 0x5f, 0x59, 0x86, 0xb0, 0x82, 0x56, 0xf0,
+  0x86, 0x6a, 0xaa, 0x95, 0xb2, 0x3c, 0xc2, 0xd3, 0xde, 0xf6, 0xf3, 0x5c, 0xd4, 0x68, 0x9e, 0x19,
+  0x70, 0xad, 0x51, 0xac, 0xd6, 0x55, 0xbb, 0x42, 0x61, 0xb2, 0x79, 0x29, 0x81, 0x7e, 0xbe, 0xd9,
+  0x5d, 0xd5, 0x24, 0x54, 0xb2, 0x87, 0x81, 0x26, 0x86, 0x91, 0xaf, 0xb9, 0x5b, 0xce, 0x31, 0x00,
+  0xc3, 0x57, 0x36, 0x80, 0x0c, 0x0e, 0xff, 0x6d, 0xc1, 0xec, 0xc8, 0x1f, 0x6c, 0xd9, 0xc7, 0xf7,
+  0xd7, 0x37, 0xc0, 0x4d, 0xb5, 0x7c, 0xe7, 0xc5, 0xf2, 0x20, 0x4d, 0x00, 0xef, 0x1f, 0x66, 0xa5,
+  0x57, 0xf1, 0xe2, 0x85, 0x05, 0x97, 0x67, 0x3e, 0xc0, 0x6c, 0x1e, 0x02, 0x8d, 0xaf, 0x23, 0xb6,
+  0x06, 0x5c, 0xb5, 0xf4, 0x2e, 0xd9, 0xcf, 0x2c, 0x3b, 0xcb, 0xf0, 0x6f, 0x50, 0x74, 0xfa, 0x06,
+  0xcb, 0xa0, 0x16, 0xf9, 0xcc, 0x2b, 0x0c, 0x61, 0x4a, 0xbd, 0xc8, 0x1d, 0x7c, 0x71, 0x29, 0x3c,
+  0x81, 0xd9, 0x42, 0x74, 0x7d, 0xb0, 0x95, 0x01, 0xee, 0x20, 0xc6, 0x9b, 0x67, 0x52, 0x64, 0xd1,
+  0x33, 0x09, 0x16, 0xa4, 0x7d, 0xae, 0x95, 0xc3, 0x77, 0x31, 0xa4, 0x0b, 0x94, 0xce, 0x67, 0xe8,
+  0xf7, 0x9a, 0xca, 0x00, 0x1f, 0xc4, 0x0a, 0x3a, 0x04, 0x04, 0x8d, 0x11, 0x34, 0xd2, 0x2a, 0x7b,
+  0x8f, 0x52, 0x58, 0x52, 0x7e, 0x8e, 0xc6, 0xf5, 0xa2, 0xb3, 0x4e, 0x87, 0x85, 0x50, 0x16, 0x8c,
+  0x7b, 0x03, 0x8d, 0x36, 0x90, 0x93, 0xbf, 0x79, 0x38, 0x6f, 0x84, 0xb1, 0xee, 0x7c, 0x29, 0x64,
+  0x1d, 0xa5, 0xb7, 0xf8, 0x1b, 0x58, 0xee, 0x5f, 0x56, 0x74, 0x6e, 0x40, 0x15, 0x12, 0xd4, 0x02,
+  0xf3, 0xf1, 0x3b, 0xfb, 0xed, 0xa4, 0x0b, 0x30, 0xda, 0x35, 0xb0, 0xd2, 0x1b, 0xf0, 0x06, 0x82,
+  0x8e, 0xe4, 0x43, 0x7b, 0x0f, 0xa3, 0x54, 0xd9, 0xa5, 0xde, 0x62, 0xa0, 0x8d, 0x58, 0xe4, 0x95,
+  0xff, 0xd7, 0x99, 0xec, 0x13, 0xe5, 0xf3, 0x7d, 0x03, 0x12, 0x2a, 0x6c, 0xbd, 0xd7, 0x52, 0xe6,
+  0xd9, 0x27, 0x6a, 0xf8, 0x17, 0x41, 0xfc, 0x73, 0x36, 0x2b, 0x30, 0x8c, 0x4b, 0x8e, 0x65, 0xda,
+  0x37, 0x2f, 0xc8, 0x3d, 0x32, 0x4a, 0xc5, 0x86, 0xcb, 0x16, 0x30, 0x17, 0x41, 0xe7, 0x13, 0xc8,
+  0x82, 0x4c, 0x60, 0xf1, 0x8b, 0x68, 0xa5, 0x8c, 0xc2, 0xa2, 0x61, 0x79, 0x10, 0xfe, 0xe9, 0xf4,
+  0x94, 0xb5, 0xaa, 0x86, 0x46, 0x28, 0xa8, 0xf7, 0xd6, 0x18, 0x43, 0xe5, 0x61, 0x75, 0x62, 0x19,
+  0xbc, 0xda, 0xac, 0x33, 0xf4, 0x10, 0xe2, 0x9d, 0x68, 0x0e, 0xf4, 0x1a, 0x03, 0x56, 0x7c, 0x05,
+  0xf3, 0x80, 0x2d, 0xed, 0x14, 0x90, 0x69, 0x9f, 0x0c, 0xc2, 0x1f, 0xc6, 0x7e, 0xfa, 0x8c, 0x8a,
+  0x4e, 0x56, 0xa8, 0x03, 0x9e, 0x7d, 0xee, 0x3b, 0xa8, 0x19, 0x66, 0xe0, 0x29, 0x88, 0xfb, 0xca,
+  0x20, 0xa9, 0x7c, 0x40, 0x82, 0xb8, 0x35, 0x7a, 0x8b, 0x4d, 0x82, 0x73, 0x80, 0x52, 0x02, 0x9d,
+  0x22, 0xb9, 0x6c, 0x05, 0x96, 0xfd, 0xaa, 0x79, 0xf1, 0x56, 0x2b, 0x78, 0xf1, 0x17, 0xc7, 0xc9,
+  0x98, 0x23, 0xbb, 0x60, 0x96, 0xaa, 0x25, 0x57, 0x0b, 0xa8, 0x63, 0x7a, 0x89, 0x50, 0x38, 0xfb,
+  0xf5, 0xe4, 0xe5, 0x70, 0x24, 0x78, 0x1d, 0xc3, 0xee, 0x80, 0xc5, 0x11, 0xa3, 0x99, 0xce, 0x3c,
+  0x41, 0xdd, 0x4a, 0x38, 0x0e, 0x26, 0xb0, 0xa8, 0xc8, 0x52, 0x2a, 0xa9, 0xa8, 0xd9, 0x87, 0x43,
+  0xe1, 0x99, 0x82, 0x28, 0xab, 0x45, 0x7e, 0xc1, 0x32, 0xbd, 0x3c, 0xf9, 0x25, 0x2d, 0x90, 0x5b,
+  0x22, 0x76, 0x3f, 0x33, 0x97, 0xc6, 0x50, 0xce, 0x84, 0xf2, 0x31, 0x84, 0xf9, 0xce, 0x0e, 0x4a,
+  0xd4, 0xe3, 0x30, 0xc5, 0x3f, 0x56, 0xab, 0xbc, 0xcb, 0x47, 0x44, 0xb0, 0xef, 0xcf, 0xc9, 0x39,
+  0xe7, 0xf5, 0x85, 0xe0, 0x0b, 0xa5, 0x2d, 0xd2, 0xa7, 0x7d, 0x3c, 0x32, 0xbb, 0xb3, 0x38, 0x65,
+  0xc7, 0xf5, 0x5e, 0x76, 0x3a, 0xc2, 0x11, 0x96, 0x1e, 0xc7, 0x5e, 0x2e, 0x69, 0x46, 0x1c, 0x6d,
+  0x63, 0xad, 0x20, 0x5b, 0x83, 0xfa, 0xd6, 0xc5, 0x56, 0x34, 0xa2, 0xa0, 0x77, 0xe5, 0x5e, 0x74,
+  0x09, 0x7c, 0x3d, 0x21, 0x1a, 0xb0, 0x15, 0x8d, 0x01, 0xf8, 0x03, 0x25, 0x12, 0x85, 0x76, 0xed,
+  0x90, 0x65, 0x1e, 0x57, 0x09, 0xef, 0xcb, 0x47, 0x3b, 0x5d, 0xaf, 0x41, 0x61, 0xab, 0x01, 0x5f,
+  0xf5, 0x99, 0xf1, 0xad, 0xe9, 0x6f, 0x86, 0xa4, 0x3d, 0xfd, 0x73, 0x51, 0x49, 0x6d, 0x21, 0x4f,
+  0xda, 0x91, 0x25, 0x77, 0x08, 0x15, 0x93, 0x1e, 0x6e, 0x74, 0x6b, 0x2a, 0x88, 0x59, 0x0d, 0xaf,
+  0xcf, 0x7c, 0x59, 0x4f, 0x69, 0x14, 0x40, 0x55, 0xba, 0x86, 0x8f, 0xef, 0xaf, 0xce, 0xf5, 0x6a,
+  0x8d, 0x4d, 0x8a, 0xc4, 0x1a, 0x38, 0x3d, 0x5a, 0x8d, 0x9e, 0xb4, 0x22, 0x64, 0x68, 0xf6, 0xf0,
+  0xb6, 0x8b, 0x71, 0x5b, 0x8f, 0x79, 0x14, 0x37, 0x72, 0xf4, 0x06, 0xb2, 0x72, 0x42, 0xae, 0x42,
+  0x9e, 0xb3, 0x6f, 0x69, 0x0e, 0x51, 0x8a, 0x1a, 0x13, 0x58, 0x22, 0xfb, 0x70, 0xe0, 0x1c, 0xa8,
+  0x2b, 0x7f, 0xdc, 0xbb, 0x01, 0x9c, 0x0d, 0x85, 0x34, 0x80, 0xa3, 0xfb, 0x44, 0x14, 0x93, 0x00,
+  0x78, 0x5d, 0xfb, 0x54, 0x5e, 0x23, 0x41, 0x03, 0x82, 0xa1, 0xc6, 0x90, 0x52, 0xe3, 0xfd, 0x97,
+  0xf0, 0x27, 0xf5, 0x62, 0x42, 0xcd, 0xb4, 0x4d, 0x14, 0x78, 0x89, 0x62, 0x81, 0xc0, 0x53, 0xe7,
+  0xcc, 0xb7, 0xe6, 0x77, 0xec, 0xc6, 0x59, 0x9e, 0x0f, 0x23, 0x1d, 0x50, 0x41, 0xe9, 0xef, 0xca,
+  0x28, 0xc9, 0x22, 0x8f, 0x64, 0x4f, 0x31, 0x7e, 0xcb, 0x9d, 0x43, 0x66, 0x9c, 0x80, 0xdd, 0xf3,
+  0x6b, 0x56, 0xb5, 0xc6, 0xd0, 0x36, 0x11, 0x44, 0xaf, 0xd1, 0x96, 0x44, 0xf9, 0x71, 0x30, 0x78,
+  0xa5, 0xe1, 0xab, 0xa7, 0x78, 0xe5, 0xf5, 0x06, 0x6f, 0x4e, 0x61, 0xa9, 0x06, 0x87, 0x9e, 0x93,
+  0xfb, 0x26, 0x11, 0xc3, 0x62, 0x4c, 0x38, 0x4c, 0x04, 0xba, 0x52, 0x26, 0xb8, 0x87, 0x5e, 0x92,
+  0xa7, 0x9e, 0xbb, 0x28, 0x6b, 0xa9, 0x93, 0x33, 0x96, 0x2a, 0xd1, 0x3e, 0x67, 0x1c, 0x26, 0x92,
+  0xbd, 0x3a, 0x3c, 0xd7, 0xeb, 0xb5, 0x4f, 0x70, 0x32, 0xb4, 0xdf, 0x08, 0xd7, 0xb3, 0xcb, 0x28,
+  0xc3, 0x8f, 0xd1, 0xce, 0x44, 0x9c, 0x9e, 0x82, 0x7a, 0x3f, 0x9f, 0xb2, 0xd8, 0xc2, 0x68, 0x33,
+  0xab, 0x85, 0xed, 0x9e, 0x3e, 0x4f, 0x5c, 0xe1, 0x6e, 0xb7, 0x86, 0x11, 0x47, 0x8c, 0x10, 0x92,
+  0xd4, 0x23, 0x75, 0x08, 0x95, 0xf0, 0xbb, 0xf1, 0x14, 0xb4, 0xb2, 0x17, 0x4b, 0x1b, 0x26, 0x00,
+  0xc2, 0x0c, 0xcd, 0xbd, 0x66, 0xd1, 0x1f, 0x24, 0xf2, 0xbe, 0x63, 0x97, 0x48, 0xe3, 0x7e, 0xe7,
+  0xea, 0xc5, 0xae, 0xea, 0xfd, 0x1e, 0x86, 0xa8, 0xe8, 0x61, 0x9f, 0xe9, 0x7d, 0xae, 0xa7, 0x88,
+  0x32, 0x7a, 0xe9, 0x79, 0x20, 0x9d, 0x90, 0x43, 0xfa, 0x4f, 0x56, 0xae, 0x74, 0x1f, 0xb7, 0xa3,
+  0x7d, 0x7c, 0xb8, 0xcf, 0xb2, 0x01, 0x1b, 0x97, 0xc3, 0xab, 0x6f, 0x74, 0x8f, 0xf5, 0x77, 0x60,
+  0x45, 0xb7, 0x7c, 0xba, 0x58, 0x19, 0xf3, 0x14, 0xb2, 0x42, 0xb1, 0x02, 0x3f, 0x47, 0x2c, 0x22,
+  0xfb, 0x31, 0xa6, 0x9a, 0xdc, 0x97, 0x54, 0x3d, 0xb9, 0xf4, 0x8f, 0x3e, 0x06, 0xbe, 0xb1, 0x33,
+  0xf4, 0xf7, 0x2a, 0xe1, 0x1c, 0x27, 0xf5, 0x56, 0xd7, 0xbb, 0xb4, 0x73, 0xa8, 0xc3, 0xc1, 0xb6,
+  0xd2, 0x8d, 0x22, 0xeb, 0x17, 0x8f, 0xae, 0xd6, 0xa4, 0x3a, 0xae, 0xf1, 0x77, 0x13, 0xf7, 0x88,
+  0xf9, 0x51, 0xe2, 0x92, 0x8c, 0x84, 0x45, 0x5e, 0xe0, 0x06, 0x33, 0x31, 0xa9, 0xb6, 0xbd, 0x5d,
+  0x09, 0x37, 0xcd, 0x49, 0x50, 0xac, 0x8d, 0x1f, 0xa0, 0x0b, 0x68, 0x38, 0x7a, 0xed, 0xea, 0xdb,
+  0x7d, 0xd8, 0x3d, 0xef, 0x3e, 0x81, 0x66, 0x85, 0x5f, 0x09, 0x0b, 0x5c, 0x0f, 0xfb, 0x26, 0xe9,
+  0x7b, 0xd3, 0xe3, 0xf0, 0x7f, 0x3d, 0x7c, 0xdc, 0x17, 0xec, 0x72, 0x12, 0x4a, 0x25, 0x45, 0x75,
+  0x77, 0xc8, 0xfa, 0xa3, 0xbe, 0x2e, 0xfb, 0x93, 0x51, 0xe7, 0x05, 0x2f, 0xdf, 0xfd, 0x00, 0xb8,
+  0x83, 0xdd, 0xf4, 0xf6, 0x7f, 0xdb, 0x3a, 0xa7, 0x55, 0xe7, 0x34, 0x3c, 0xfd, 0x10, 0x4e, 0x16,
+  0x9a, 0x2e, 0x6c, 0x19, 0xe8, 0x06, 0x85, 0xee, 0x19, 0xfe, 0x7f, 0xd5, 0x19, 0xeb, 0xbe, 0x1e,
+  0xf0, 0x0c, 0x89, 0x02, 0x24, 0xdf, 0x11, 0xd1, 0xb6, 0x4e, 0x67, 0x87, 0x73, 0xfe, 0xb4, 0x50,
+  0xd0, 0xcf, 0xff, 0x1b, 0xca, 0x01, 0x6e, 0xf4, 0x37, 0x82, 0x19, 0x0a, 0x3b, 0x68, 0x04, 0xec,
+  0x0d, 0xff, 0x4c, 0x22, 0xb4, 0xb9, 0x05, 0x42, 0x89, 0x96, 0x87, 0x8d, 0x71, 0xf4, 0x30, 0xa3,
+  0x5f, 0xff, 0x01, 0x58, 0x8c, 0x25, 0x5f, 0xa1, 0x10, 0x00, 0x00,
+};
+
+// web/index.html, 857 bytes gzipped
+static const uint8_t WEB_ASSET_2[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x8d, 0x56, 0xdb, 0x6e, 0xdb, 0x38,
+  0x10, 0x7d, 0xcf, 0x57, 0x70, 0x09, 0xec, 0x53, 0xeb, 0x0a, 0x76, 0xb6, 0x4d, 0x5b, 0x48, 0x2a,
+  0x72, 0x2b, 0x5a, 0x34, 0x69, 0x8d, 0xa4, 0xdd, 0xc5, 0x3e, 0xd2, 0xd4, 0xc8, 0x62, 0x43, 0x89,
+  0x02, 0x39, 0x92, 0xe1, 0x7e, 0x7d, 0x87, 0xa2, 0x6c, 0xa7, 0x89, 0x43, 0xe7, 0x85, 0xa4, 0xc4,
+  0x33, 0x67, 0x2e, 0x1c, 0xce, 0x30, 0xfd, 0xeb, 0xe2, 0xdb, 0xf9, 0xf7, 0xff, 0xe7, 0x97, 0xac,
+  0xc2, 0x5a, 0xe7, 0x47, 0xe9, 0x66, 0x02, 0x51, 0xd0, 0x84, 0x0a, 0x35, 0xe4, 0x97, 0xb7, 0xf3,
+  0xe3, 0x19, 0x3b, 0xbb, 0xba, 0x64, 0x37, 0x50, 0x1b, 0x04, 0x76, 0x6e, 0x1a, 0xb4, 0x46, 0xb3,
+  0x89, 0x5f, 0x39, 0xa3, 0x21, 0x4d, 0x02, 0xf2, 0x28, 0xad, 0x01, 0x05, 0x6b, 0x44, 0x0d, 0x19,
+  0xef, 0x15, 0xac, 0x5a, 0x63, 0x91, 0x33, 0x49, 0x78, 0x68, 0x30, 0xe3, 0x2b, 0x55, 0x60, 0x95,
+  0x15, 0xd0, 0x2b, 0x09, 0x93, 0xe1, 0xe3, 0x25, 0x53, 0x8d, 0x42, 0x25, 0xf4, 0xc4, 0x49, 0xa1,
+  0x21, 0x9b, 0x72, 0x22, 0xd1, 0xaa, 0xb9, 0x63, 0x16, 0x74, 0xc6, 0x1d, 0xae, 0x35, 0xb8, 0x0a,
+  0x80, 0x58, 0x2a, 0x0b, 0x65, 0xc6, 0x13, 0x19, 0x54, 0x6e, 0xe6, 0x57, 0xd2, 0xb9, 0x0f, 0x7d,
+  0x56, 0xce, 0xc4, 0x1b, 0xf9, 0x7a, 0x71, 0x52, 0xc0, 0xc9, 0xf1, 0x5b, 0x79, 0x22, 0x3c, 0x4d,
+  0x32, 0x7a, 0xb1, 0x30, 0xc5, 0x9a, 0xa6, 0x42, 0xf5, 0x4c, 0x6a, 0xe1, 0x5c, 0xc6, 0xbd, 0x41,
+  0x42, 0x35, 0x60, 0x3d, 0xac, 0x9a, 0x3e, 0xe9, 0x21, 0x51, 0x4c, 0xf3, 0xa3, 0xa3, 0xb4, 0x34,
+  0xb6, 0x66, 0xaa, 0xc8, 0xb8, 0x36, 0x4b, 0xd5, 0xf0, 0x0d, 0x8d, 0x68, 0xd5, 0xc4, 0x81, 0x44,
+  0x65, 0x9a, 0xc1, 0x6c, 0xb1, 0x00, 0x9d, 0x7f, 0x37, 0x77, 0xd0, 0xb0, 0x54, 0x35, 0x6d, 0x87,
+  0x83, 0x0c, 0xfa, 0x1f, 0x9c, 0xe1, 0xba, 0xa5, 0xa0, 0xb4, 0x24, 0xb8, 0x32, 0xb6, 0xe0, 0x4c,
+  0x74, 0x68, 0xa4, 0xa9, 0x5b, 0x0d, 0x48, 0xff, 0x65, 0x67, 0x2d, 0x85, 0x68, 0xb2, 0xdb, 0x77,
+  0xea, 0x17, 0xfd, 0x3f, 0x9e, 0xf1, 0x3c, 0x4d, 0x02, 0x33, 0x79, 0xd2, 0x21, 0x9a, 0x66, 0xa4,
+  0x72, 0xdd, 0xa2, 0x56, 0xc8, 0x73, 0xb2, 0xb5, 0x21, 0x23, 0xd2, 0x24, 0xec, 0x12, 0xcc, 0xb5,
+  0xa2, 0x19, 0x54, 0x3b, 0xb4, 0x20, 0xea, 0xad, 0xbd, 0x0e, 0x05, 0x02, 0xcf, 0x4d, 0x59, 0x52,
+  0x84, 0xe9, 0xd0, 0x3c, 0xce, 0xc7, 0xc9, 0xbb, 0xe7, 0xdd, 0xac, 0x66, 0xf9, 0xc5, 0x70, 0x36,
+  0xe4, 0xf7, 0xec, 0xcf, 0x88, 0x3d, 0x70, 0xf5, 0xde, 0x8e, 0x6a, 0x4a, 0x43, 0x36, 0x92, 0x2a,
+  0xd3, 0x2c, 0xf3, 0xaf, 0x74, 0xf4, 0xef, 0x89, 0x39, 0x7c, 0xb1, 0x60, 0x4a, 0x21, 0x50, 0x4c,
+  0x28, 0xe6, 0xa5, 0x5a, 0x66, 0x3c, 0x9c, 0xbe, 0xc7, 0x79, 0xcf, 0x06, 0x13, 0xd2, 0x84, 0xf8,
+  0x62, 0xac, 0xd7, 0xa7, 0xe7, 0x4c, 0x14, 0x85, 0x05, 0xe7, 0xe2, 0xe4, 0xb5, 0x90, 0xa7, 0x01,
+  0xf7, 0x7c, 0xf2, 0xb9, 0x35, 0xa5, 0xd2, 0x07, 0xac, 0x16, 0xe4, 0x7a, 0x0f, 0x23, 0xf4, 0xf9,
+  0xdc, 0x9f, 0x8c, 0x43, 0x9f, 0xfe, 0xfe, 0x80, 0xa0, 0x88, 0xab, 0xd8, 0xc2, 0x9e, 0x4f, 0x7f,
+  0x5a, 0xf4, 0x60, 0x51, 0x39, 0xd5, 0x2c, 0x0f, 0x98, 0xbf, 0x03, 0x3e, 0x9f, 0xfd, 0x4c, 0x20,
+  0x82, 0x5d, 0x1f, 0xb0, 0x3a, 0x24, 0xee, 0x88, 0xbd, 0x82, 0x1e, 0xf4, 0x56, 0x03, 0xfb, 0xfb,
+  0xa0, 0x8e, 0xff, 0xd4, 0x47, 0xc5, 0x6e, 0x6e, 0x6f, 0x3f, 0x3f, 0xd2, 0xe2, 0xf3, 0xd7, 0x3a,
+  0xa7, 0x76, 0x6c, 0xc5, 0x59, 0x7d, 0x90, 0xef, 0xa3, 0x05, 0x60, 0x74, 0xef, 0xdb, 0xbd, 0x7c,
+  0x7e, 0x63, 0xc7, 0xb7, 0x58, 0x23, 0xb8, 0x97, 0x6c, 0x23, 0xda, 0xb5, 0xa8, 0xf6, 0x24, 0xaf,
+  0x97, 0x0b, 0x5b, 0x8f, 0x22, 0x37, 0x5e, 0x47, 0x8f, 0x68, 0x85, 0xb2, 0x3c, 0x44, 0x86, 0xae,
+  0x0a, 0x95, 0x29, 0x1a, 0x93, 0xe1, 0x67, 0x7e, 0x8b, 0xc2, 0x22, 0xf3, 0x6b, 0x8a, 0xfe, 0xbd,
+  0x5b, 0x3a, 0x4a, 0x3f, 0x90, 0x71, 0x68, 0xda, 0x8d, 0x9c, 0x69, 0x9f, 0x16, 0x1b, 0xc2, 0x03,
+  0x25, 0xa5, 0x7a, 0xc5, 0xf3, 0x9b, 0xb0, 0xb8, 0x87, 0x0a, 0x16, 0x0e, 0x57, 0x3a, 0x94, 0xb4,
+  0xe8, 0x95, 0x26, 0x35, 0x05, 0x7f, 0x60, 0xd2, 0x1d, 0xac, 0xc9, 0x2d, 0xb3, 0xf2, 0x45, 0x72,
+  0xee, 0xa7, 0x2d, 0xfb, 0x63, 0x58, 0x47, 0x51, 0xfd, 0xd1, 0x46, 0x00, 0x35, 0x34, 0x1d, 0xcf,
+  0xaf, 0x69, 0x7c, 0x22, 0x00, 0x03, 0x4a, 0x43, 0x49, 0xf5, 0xec, 0x8a, 0xc6, 0x08, 0x95, 0xb9,
+  0xe3, 0xf9, 0xb7, 0x2f, 0x11, 0x80, 0x55, 0xcb, 0x8a, 0x68, 0x6e, 0xfc, 0x14, 0xd3, 0xb6, 0x10,
+  0x92, 0xa8, 0xce, 0x68, 0x8c, 0x90, 0x15, 0x66, 0x45, 0x05, 0xef, 0x82, 0xc6, 0x08, 0xa8, 0x32,
+  0x3e, 0x39, 0x3e, 0xd1, 0x18, 0xd3, 0xd7, 0x1b, 0x1d, 0xd8, 0xfe, 0xf5, 0xad, 0x33, 0x16, 0xac,
+  0xce, 0x57, 0xe9, 0xeb, 0x0e, 0x21, 0x02, 0x22, 0x36, 0x1f, 0x75, 0xcf, 0xf5, 0x22, 0xa6, 0x55,
+  0x56, 0x41, 0xe9, 0x79, 0x15, 0xd5, 0xd9, 0x6a, 0xb1, 0x6e, 0x45, 0xe7, 0x48, 0xf1, 0x9c, 0x96,
+  0xc9, 0xdc, 0xaf, 0x23, 0x78, 0x59, 0x79, 0xed, 0x44, 0xfa, 0xe2, 0x51, 0xd2, 0x45, 0xda, 0xc6,
+  0xfe, 0x94, 0xa7, 0x4e, 0x0f, 0xc2, 0x81, 0xd0, 0xda, 0x67, 0xf2, 0xb0, 0x66, 0xf4, 0xc1, 0x48,
+  0x91, 0xdb, 0xd7, 0xd5, 0x28, 0xd5, 0x3b, 0x8d, 0xdb, 0xae, 0xd6, 0x0a, 0x2b, 0xea, 0x5d, 0xbd,
+  0xff, 0x23, 0xf7, 0x2f, 0x7b, 0xaa, 0x4d, 0xee, 0x40, 0x3b, 0x4b, 0x29, 0x86, 0x63, 0x73, 0xdf,
+  0x92, 0xfa, 0x35, 0x31, 0x1a, 0xbd, 0xbd, 0xec, 0xe3, 0xe4, 0xa4, 0x55, 0x2d, 0x32, 0x67, 0xe5,
+  0x9e, 0xb7, 0xc8, 0x4f, 0xff, 0x14, 0xf9, 0x67, 0x06, 0x8b, 0x62, 0x3a, 0x7d, 0xb3, 0x98, 0xca,
+  0xd7, 0x27, 0xef, 0xde, 0x0d, 0x0d, 0x3c, 0x48, 0x79, 0x96, 0xf1, 0x31, 0x92, 0x84, 0x87, 0xd6,
+  0x6f, 0x61, 0xc7, 0x8b, 0x9b, 0x80, 0x09, 0x00, 0x00,
+};
+
+const WebAsset WEB_ASSETS[] = {
+  {"/console/console.css", "text/css", WEB_ASSET_0, sizeof(WEB_ASSET_0), "\"f2a6c5b7de738c7a\"", true},
+  {"/console/console.js", "application/javascript", WEB_ASSET_1, sizeof(WEB_ASSET_1), "\"42ebd116b1c57992\"", true},
+  {"/console", "text/html", WEB_ASSET_2, sizeof(WEB_ASSET_2), "\"a842d2d5537a0e38\"", false},
+};
+const size_t NUM_WEB_ASSETS = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);
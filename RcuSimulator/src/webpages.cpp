@@ -0,0 +1,154 @@
+#include "webpages.h"
+#include "globals.h"
+#include "keymap.h"
+#include "keyrecorder.h"
+
+#define PAGE_HEAD(title) "<!DOCTYPE html><html><head><title>" title "</title>" \
+  "<meta name='viewport' content='width=device-width, initial-scale=1'>" \
+  "<style>" \
+  "body{font-family:Arial,sans-serif;margin:20px;line-height:1.6}" \
+  "h1{color:#0066cc}" \
+  "h2{color:#0066cc;margin-top:20px}" \
+  ".container{max-width:800px;margin:0 auto;padding:20px;border:1px solid #ddd;border-radius:5px}" \
+  ".info{margin-bottom:10px}" \
+  ".api-section{margin-top:15px;padding:10px;background:#f7f7f7;border-radius:5px}" \
+  ".endpoint{margin-bottom:8px}" \
+  "a{color:#0066cc;text-decoration:none}" \
+  "a:hover{text-decoration:underline}" \
+  ".params{font-size:0.9em;color:#666;margin-left:20px}" \
+  "</style></head><body><div class='container'><h1>" title "</h1>"
+
+#define PAGE_END "</div></body></html>"
+
+// Root page (unprotected), without token or MAC address
+const char INDEX_PAGE_TEMPLATE[] PROGMEM = PAGE_HEAD("ESP32 BLE Remote Control") R"html(
+<div class='info'><strong>Device name:</strong> )html" BLE_DEVICE_NAME R"html(</div>
+<div class='info'><strong>IP address:</strong> %IP%</div>
+<div class='info'><strong>WiFi:</strong> %SSID%</div>
+<h2>Getting Started</h2>
+<div class='api-section'><h3>Configuration</h3>
+<div class='endpoint'><strong>Step 1:</strong> Connect to the device via serial console to get your authentication token</div>
+<div class='endpoint'><strong>Step 2:</strong> Use the CLI command <code>config</code> to view your current token</div>
+<div class='endpoint'><strong>Step 3:</strong> Access the full documentation at <code>/doc?token=YOUR_TOKEN</code></div>
+<div class='endpoint'><strong>Step 4:</strong> Use the token as a parameter in all API calls</div>
+</div>
+<h2>Authentication</h2>
+<div class='api-section'><h3>Authentication</h3>
+<div class='endpoint'><strong>Token Required:</strong> All API endpoints require authentication</div>
+<div class='endpoint'><strong>Token Location:</strong> Available via serial console using the <code>config</code> command</div>
+<div class='endpoint'><strong>Generate New Token:</strong> Use the <code>createtoken</code> command in the CLI</div>
+<div class='endpoint'>Example API call: <code>/api/key?key=up&token=YOUR_TOKEN_HERE</code></div>
+</div>
+<h2>Available API Endpoints</h2>
+<div class='api-section'><h3>API Overview</h3>
+<div class='endpoint'><strong>BLE Control:</strong> /api/pair, /api/stoppair, /api/unpair</div>
+<div class='endpoint'><strong>Remote Control:</strong> /api/key, /api/press, /api/release, /api/releaseall, /api/hold, /api/rawmediakey, /api/sequence (POST), /api/type, /ws (WebSocket), UDP port %UDP_PORT% (binary)</div>
+<div class='endpoint'><strong>Recording:</strong> /api/record, /api/record/start, /api/record/stop, /api/record/export, /api/record/import (POST), /api/replay</div>
+<div class='endpoint'><strong>System:</strong> /api/events (SSE), /api/system/diagnostics, /api/system/latency, /api/system/heap, /api/system/tasks, /api/system/battery, /api/system/reboot, /metrics</div>
+<div class='endpoint'><strong>Configuration:</strong> /api/ble/config (GET/POST), /api/ble/reset (POST), /api/ble/connections, /api/ble/connparams, /api/ble/disconnect, /api/ble/profiles, /api/ble/descriptor (GET/POST)</div>
+<div class='endpoint'><strong>Documentation:</strong> /doc (requires token for full interactive documentation)</div>
+<div class='endpoint'><strong>Console:</strong> <a href='/console'>/console</a> (remote control and live device state, asks for the token)</div>
+</div>
+<h2>Serial Console Access</h2>
+<div class='api-section'><h3>Serial Console</h3>
+<div class='endpoint'><strong>Baud Rate:</strong> 115200,8,N,1</div>
+<div class='endpoint'><strong>Commands:</strong> Type <code>help</code> to see all available CLI commands</div>
+<div class='endpoint'><strong>Configuration:</strong> Use <code>config</code> to view current settings including your token</div>
+<div class='endpoint'><strong>WiFi Setup:</strong> Use <code>setssid</code>, <code>setpwd</code>, and <code>connect</code> commands</div>
+</div>
+)html" PAGE_END;
+
+// Full documentation with working links, requires the token
+const char DOC_PAGE_TEMPLATE[] PROGMEM = PAGE_HEAD("ESP32 BLE Remote Control - Documentation") R"html(
+<div class='info'><strong>Device name:</strong> )html" BLE_DEVICE_NAME R"html(</div>
+<div class='info'><strong>IP address:</strong> %IP%</div>
+<div class='info'><strong>MAC address:</strong> %MAC%</div>
+<div class='info'><strong>WiFi:</strong> %SSID%</div>
+<div class='info'><strong>RSSI:</strong> %RSSI% dBm</div>
+<h2>Authentication</h2>
+<div class='api-section'><h3>Authentication</h3>
+<div class='endpoint'><strong>Token Required:</strong> All API endpoints require a 'token' parameter</div>
+<div class='endpoint'>Current Token: <code>%TOKEN%</code></div>
+</div>
+<h2>API Endpoints</h2>
+<div class='api-section'><h3>BLE Control</h3>
+<div class='endpoint'><a href='%BASE_URL%/api/pair?token=%TOKEN%'>Start Pairing</a> - Starts BLE advertising for pairing</div>
+<div class='endpoint'><a href='%BASE_URL%/api/stoppair?token=%TOKEN%'>Stop Pairing</a> - Stops BLE advertising</div>
+<div class='endpoint'><a href='%BASE_URL%/api/unpair?token=%TOKEN%'>Unpair</a> - Removes all stored BLE pairings</div>
+</div>
+<div class='api-section'><h3>Remote Control</h3>
+<div class='endpoint'><a href='%BASE_URL%/api/releaseall?token=%TOKEN%'>Release All Keys</a> - Release all currently pressed keys</div>
+<div class='endpoint'><strong>GET /api/key</strong> - Press and release a key
+<div class='params'>Parameters: key (required), delay in ms (max. 60000) or auto (optional, default=100), token (required)</div></div>
+<div class='endpoint'><strong>GET /api/hold</strong> - Hold a key, optionally with auto-repeat
+<div class='params'>Parameters: key (required), duration in ms (optional, default=1000), repeat_interval in ms (optional, 0=no repeat), repeat_delay in ms (optional, default=500), token (required)</div></div>
+<div class='endpoint'><strong>GET /api/rawmediakey</strong> - Send raw hex media key values
+<div class='params'>Parameters: value (hex, required), delay in ms (max. 60000) or auto (optional, default=100), token (required)</div></div>
+<div class='endpoint'><strong>GET/POST /api/type</strong> - Type ASCII text, up to 6 characters per report
+<div class='params'>Parameters: text (required), delay in ms (max. 60000) or auto (optional, default=auto), rollover 1-6 (optional, default=6), token (required)</div></div>
+<div class='endpoint'><strong>WebSocket /ws</strong> - Persistent channel for key commands, several per message
+<div class='params'>Parameters: token (required, in the connect URL). Commands separated by newline or ';': k &lt;key&gt; [ms|auto], p &lt;key&gt;, r &lt;key&gt;, x &lt;hex&gt; [ms|auto], a, t &lt;connId|all&gt;</div></div>
+</div>
+<div class='api-section'><h3>Recording</h3>
+<div class='endpoint'><a href='%BASE_URL%/api/record/start?token=%TOKEN%'>Start Recording</a> - Records every key sent to the hosts</div>
+<div class='endpoint'><a href='%BASE_URL%/api/record/stop?token=%TOKEN%'>Stop Recording</a> - Stops and saves the recording to flash</div>
+<div class='endpoint'><a href='%BASE_URL%/api/record/export?token=%TOKEN%'>Export</a> - Download the recording as binary file</div>
+<div class='endpoint'><strong>POST /api/record/import</strong> - Upload a recording exported before
+<div class='params'>Body: the binary file (max. %RECORDER_CAPACITY% bytes), token (required)</div></div>
+<div class='endpoint'><strong>GET /api/replay</strong> - Replay the recording with its original timing
+<div class='params'>Parameters: scale in percent of the recorded timing (optional, default=100, 200=half speed), target (optional), token (required)</div></div>
+</div>
+<div class='api-section'><h3>Key Examples</h3>
+<div class='endpoint'><a href='%BASE_URL%/api/key?key=up&token=%TOKEN%'>Up Arrow</a></div>
+<div class='endpoint'><a href='%BASE_URL%/api/key?key=down&token=%TOKEN%'>Down Arrow</a></div>
+<div class='endpoint'><a href='%BASE_URL%/api/key?key=enter&token=%TOKEN%'>Enter</a></div>
+<div class='endpoint'><a href='%BASE_URL%/api/key?key=playpause&token=%TOKEN%'>Play/Pause</a></div>
+</div>
+<h2>Available Keys</h2>
+<div class='api-section'><h3>Keys Reference</h3>
+<div class='endpoint'><strong>Media Keys:</strong> %MEDIA_KEYS%</div>
+<div class='endpoint'><strong>Numbers:</strong> 0, 1, 2, 3, 4, 5, 6, 7, 8, 9</div>
+<div class='endpoint'><strong>Tip:</strong> Use the /api/rawmediakey endpoint for hexadecimal values (format: 0xXX or 0xXXXX)</div>
+</div>
+)html" PAGE_END;
+
+// Called by the response for every placeholder, only the returned value is
+// on the heap while the page is sent
+String expandPagePlaceholder(const String& name, const String& token) {
+  if (name == "IP") {
+    return wifiManager.localIp().toString();
+  }
+  if (name == "BASE_URL") {
+    return "http://" + wifiManager.localIp().toString();
+  }
+  if (name == "MAC") {
+    return wifiManager.macAddress();
+  }
+  if (name == "SSID") {
+    return wifiManager.ssid();
+  }
+  if (name == "RSSI") {
+    return String(wifiManager.RSSI());
+  }
+  if (name == "TOKEN") {
+    return token;
+  }
+  if (name == "UDP_PORT") {
+    return String(UDP_CONTROL_PORT);
+  }
+  if (name == "RECORDER_CAPACITY") {
+    return String(KEY_RECORDER_CAPACITY);
+  }
+  if (name == "MEDIA_KEYS") {
+    String keys;
+    keys.reserve(NUM_MEDIA_KEY_MAPPINGS * 12);
+    for (int i = 0; i < NUM_MEDIA_KEY_MAPPINGS; i++) {
+      if (i > 0) {
+        keys += ", ";
+      }
+      keys += mediaKeyMappings[i].name;
+    }
+    return keys;
+  }
+  return String();
+}
@@ -0,0 +1,28 @@
+#ifndef WEB_PAGES_H
+#define WEB_PAGES_H
+
+#include <Arduino.h>
+
+// HTML pages, stored in flash and expanded while they are sent.
+// Placeholders are %NAME% (see expandPagePlaceholder), a literal percent sign
+// is written as %%.
+extern const char INDEX_PAGE_TEMPLATE[] PROGMEM;
+extern const char DOC_PAGE_TEMPLATE[] PROGMEM;
+
+// Value of one placeholder; the token is only known to the /doc request
+String expandPagePlaceholder(const String& name, const String& token);
+
+// Web console file, gzipped at build time from web/ (tools/build_webassets.py)
+struct WebAsset {
+  const char* path;
+  const char* contentType;
+  const uint8_t* data;
+  size_t length;
+  const char* etag;        // Hash of the gzipped data, quoted
+  bool immutable;          // Referenced with its hash in the URL, cached forever
+};
+
+extern const WebAsset WEB_ASSETS[];
+extern const size_t NUM_WEB_ASSETS;
+
+#endif // WEB_PAGES_H
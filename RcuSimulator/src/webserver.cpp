@@ -2,16 +2,21 @@
 #include "webserver.h"
 #include "utils.h"
 #include "BleRemoteControl.h"
+#include "deferredlog.h"
+#include "metrics.h"
+#include "configstore.h"
+#include "keyrecorder.h"
+#include "webpages.h"
+#include "jsonwriter.h"
+#include "heapmonitor.h"
+#include "taskprofiler.h"
 
 AsyncWebServer server(80);
 String authToken = "";
 
 // Token management functions
 void loadAuthToken() {
-  Preferences preferences;
-  preferences.begin("webserver", true);
-  authToken = preferences.getString("auth_token", "");
-  preferences.end();
+  authToken = configStore.getString(CONFIG_WEB_AUTH_TOKEN);
   
   if (authToken.isEmpty()) {
     authToken = generateRandomToken();
@@ -23,10 +28,8 @@ void loadAuthToken() {
 }
 
 void saveAuthToken(const String& token) {
-  Preferences preferences;
-  preferences.begin("webserver", false);
-  preferences.putString("auth_token", token);
-  preferences.end();
+  configStore.setString(CONFIG_WEB_AUTH_TOKEN, token);
+  configStore.commit();
   authToken = token;
 }
 
@@ -61,63 +64,326 @@ bool getKeyParameter(AsyncWebServerRequest *request, String &keyParam) {
   return false;
 }
 
-// Helper function to generate HTML sections
-String generateHtmlHeader() {
-  return String(HTML_HEAD_START) + HTML_VIEWPORT + HTML_CSS_STYLES + 
-         HTML_HEAD_END + HTML_BODY_START + HTML_TITLE;
+// Reads the optional target parameter ("all" or a conn_id from /api/ble/connections).
+// Sends the error response itself and returns false if the target is not connected.
+bool getTargetParameter(AsyncWebServerRequest *request, uint8_t &target) {
+  target = BLE_TARGET_ALL;
+  if (request->hasParam("target")) {
+    String value = request->getParam("target")->value();
+    if (!value.equalsIgnoreCase("all")) {
+      long connId = value.toInt();
+      if ((connId == 0 && value != "0") || connId < 0 || connId >= BLE_TARGET_ALL) {
+        sendJsonResponse(request, 400, "Invalid target, use a connection ID or 'all'");
+        return false;
+      }
+      target = (uint8_t)connId;
+    }
+  }
+  if (!bleRemoteControl.isConnected(target)) {
+    sendJsonResponse(request, 400, target == BLE_TARGET_ALL ? "Not connected to a host" : "Target connection not found");
+    return false;
+  }
+  return true;
 }
 
-String generateDeviceInfoSection() {
-  String html = "<div class='info'><strong>Device name:</strong> " BLE_DEVICE_NAME "</div>";
-  html += "<div class='info'><strong>IP address:</strong> " + wifiManager.localIp().toString() + "</div>";
-  html += "<div class='info'><strong>MAC address:</strong> " + wifiManager.macAddress() + "</div>";
-  html += "<div class='info'><strong>WiFi:</strong> " + wifiManager.ssid() + "</div>";
-  html += "<div class='info'><strong>RSSI:</strong> " + String(wifiManager.RSSI()) + " dBm</div>";
-  return html;
+// Reads the optional hold time of a tap in milliseconds. "auto" selects the
+// shortest hold the connection interval allows. Sends the error response
+// itself and returns false unless the value is "auto" or 0-KEY_HOLD_MAX_MS.
+// Digits only, toInt() would turn "-1" into a huge and "abc" into 0 ms
+bool parseMilliseconds(const String& value, uint32_t &ms) {
+  bool digits = value.length() > 0 && value.length() <= 5;
+  for (size_t i = 0; digits && i < value.length(); i++) {
+    digits = isdigit((unsigned char)value[i]);
+  }
+  if (!digits || value.toInt() > KEY_HOLD_MAX_MS) {
+    return false;
+  }
+  ms = value.toInt();
+  return true;
 }
 
-String generateApiSection(String title, String content) {
-  return String(HTML_SECTION_START) + "<h3>" + title + "</h3>" + content + HTML_SECTION_END;
+bool getHoldParameter(AsyncWebServerRequest *request, uint32_t &holdMs, uint32_t defaultMs = 100) {
+  holdMs = defaultMs;
+  if (!request->hasParam("delay")) {
+    return true;
+  }
+  String value = request->getParam("delay")->value();
+  if (value.equalsIgnoreCase("auto")) {
+    holdMs = KEY_HOLD_AUTO;
+    return true;
+  }
+  if (!parseMilliseconds(value, holdMs)) {
+    sendJsonResponse(request, 400, "delay must be 0-" + String(KEY_HOLD_MAX_MS) + " ms or auto");
+    return false;
+  }
+  return true;
 }
 
-String generateMediaKeysFromMapping() {
-  String mediaKeys = "<div class='endpoint'><strong>Media Keys:</strong> ";
-  
-  // Get media keys from the actual mapping array
-  for (int i = 0; i < NUM_MEDIA_KEY_MAPPINGS; i++) {
-    mediaKeys += mediaKeyMappings[i].name;
-    if (i < NUM_MEDIA_KEY_MAPPINGS - 1) {
-      mediaKeys += ", ";
-    }
+// A time parameter of 0-KEY_HOLD_MAX_MS ms, answers 400 itself if it is malformed
+bool getMillisecondsParameter(AsyncWebServerRequest *request, const char* name, uint32_t &ms, uint32_t defaultMs) {
+  ms = defaultMs;
+  if (!request->hasParam(name)) {
+    return true;
+  }
+  if (!parseMilliseconds(request->getParam(name)->value(), ms)) {
+    sendJsonResponse(request, 400, String(name) + " must be 0-" + String(KEY_HOLD_MAX_MS) + " ms");
+    return false;
+  }
+  return true;
+}
+
+// Rejects new key commands while the BLE TX queue cannot take another press
+bool rejectOnTxBackpressure(AsyncWebServerRequest *request, uint8_t target) {
+  if (!bleRemoteControl.isTxQueueFull(target)) {
+    return false;
+  }
+  sendJsonResponse(request, 503, "BLE TX queue full, host is not accepting notifications");
+  return true;
+}
+
+void addTxQueueStats(JsonWriter& json, const char* key, const ReportQueueStats& stats) {
+  json.beginObject(key)
+      .add("depth", stats.depth)
+      .add("queued", stats.queued)
+      .add("coalesced", stats.coalesced)
+      .add("rejected", stats.rejected)
+      .add("notified", stats.notified)
+      .add("notifyFailures", stats.notifyFailures)
+      .add("congestionEvents", stats.congestionEvents)
+      .add("congested", stats.congested)
+      .endObject();
+}
+
+void addConnections(JsonWriter& json, const char* key) {
+  HostConnectionInfo infos[BLE_MAX_CONNECTIONS];
+  size_t count = bleRemoteControl.getConnections(infos, BLE_MAX_CONNECTIONS);
+  json.beginArray(key);
+  for (size_t i = 0; i < count; i++) {
+    // Adaptive hold and the key rate it allows (press and release each take one event)
+    uint32_t minHoldUs = BleRemoteControl::minHoldForInterval(infos[i].interval);
+    json.beginObject()
+        .add("connId", infos[i].connId)
+        .add("address", infos[i].address)
+        .add("keyboardSubscribed", infos[i].keyboardSubscribed)
+        .add("mediaSubscribed", infos[i].mediaSubscribed)
+        .add("congested", infos[i].keyTx.congested)
+        .add("pendingReports", infos[i].keyTx.depth + infos[i].mediaTx.depth)
+        .add("intervalMs", infos[i].interval * 1.25f)
+        .add("latency", infos[i].latency)
+        .add("timeoutMs", infos[i].timeout * 10)
+        .add("paramUpdates", infos[i].paramUpdates)
+        .add("minHoldMs", minHoldUs / 1000.0f)
+        .add("maxKeysPerSecond", 1000000.0f / (2 * minHoldUs))
+        .endObject();
+  }
+  json.endArray();
+}
+
+// Hold time as requested, "auto" or milliseconds
+void addHoldTime(JsonWriter& json, const char* key, uint32_t holdMs) {
+  if (holdMs == KEY_HOLD_AUTO) {
+    json.add(key, "auto");
+  } else {
+    json.add(key, holdMs);
   }
+}
+
+// Web console file, gzipped at build time. Every browser accepts gzip, so
+// there is no uncompressed copy; a reload with the ETag costs one small 304
+void sendWebAsset(AsyncWebServerRequest *request, const WebAsset& asset) {
+  const AsyncWebHeader* ifNoneMatch = request->getHeader("If-None-Match");
+  bool unchanged = ifNoneMatch != nullptr && ifNoneMatch->value() == asset.etag;
   
-  mediaKeys += "</div>";
-  return mediaKeys;
+  AsyncWebServerResponse *response = unchanged ? request->beginResponse(304)
+                                               : request->beginResponse(200, asset.contentType, asset.data, asset.length);
+  if (!unchanged) {
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", asset.etag);
+  response->addHeader("Cache-Control", asset.immutable ? "public, max-age=31536000, immutable" : "no-cache");
+  request->send(response);
 }
 
-String generateKeysSection() {
-  return generateMediaKeysFromMapping() + String(HTML_NUMBER_KEYS) + HTML_KEY_TIPS;
+// Collects a (possibly chunked) POST body into request->_tempObject as a
+// null-terminated string. The buffer is freed together with the request.
+void collectRequestBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total, size_t maxSize) {
+  if (total > maxSize) {
+    return;
+  }
+  if (index == 0) {
+    request->_tempObject = malloc(total + 1);
+  }
+  char* body = (char*)request->_tempObject;
+  if (body == nullptr) {
+    return;
+  }
+  memcpy(body + index, data, len);
+  if (index + len == total) {
+    body[total] = '\0';
+  }
+}
+
+// Hex dump to bytes: pairs of hex digits, separated by whitespace, commas or
+// nothing, each byte optionally prefixed with 0x
+bool parseHexBytes(const char* text, uint8_t* out, size_t maxLength, size_t& length) {
+  length = 0;
+  const char* p = text;
+  while (*p != '\0') {
+    if (isspace((unsigned char)*p) || *p == ',') {
+      p++;
+      continue;
+    }
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+      p += 2;
+    }
+    if (!isxdigit((unsigned char)p[0]) || !isxdigit((unsigned char)p[1]) || length >= maxLength) {
+      return false;
+    }
+    char pair[3] = {p[0], p[1], '\0'};
+    out[length++] = (uint8_t)strtoul(pair, nullptr, 16);
+    p += 2;
+  }
+  return length > 0;
 }
 
-void sendJsonResponse(AsyncWebServerRequest *request, int httpCode, String message) {
-  StaticJsonDocument<256> doc;
-  doc["status"] = httpCode;
-  doc["message"] = message;
+// Validates all steps of a key sequence before anything is sent
+bool parseKeySequence(JsonArray steps, KeySequence& sequence, String& errorMsg) {
+  if (steps.size() == 0 || steps.size() > KEY_SEQUENCE_MAX_STEPS) {
+    errorMsg = "Sequence must contain 1-" + String(KEY_SEQUENCE_MAX_STEPS) + " steps";
+    return false;
+  }
   
-  String jsonResponse;
-  serializeJson(doc, jsonResponse);
+  sequence.count = 0;
+  for (JsonVariant item : steps) {
+    KeySequenceStep& step = sequence.steps[sequence.count];
+    String prefix = "Step " + String(sequence.count) + ": ";
+    step = KeySequenceStep();
+    
+    if (item.containsKey("key") == item.containsKey("raw")) {
+      errorMsg = prefix + "exactly one of 'key' or 'raw' is required";
+      return false;
+    }
+    if (item.containsKey("key")) {
+      const char* keyName = item["key"] | "";
+      step.key = resolveKeyName(keyName);
+      if (!step.key.isValid()) {
+        errorMsg = prefix + "unknown key '" + keyName + "'";
+        return false;
+      }
+    } else if (!parseHexValue16(item["raw"] | "", step.raw)) {
+      errorMsg = prefix + "invalid raw value (use 0xXX or 0xXXXX)";
+      return false;
+    }
+    
+    // A default only replaces a missing value, never one of the wrong type
+    JsonVariant holdValue = item["hold_ms"];
+    JsonVariant gapValue = item["gap_ms"];
+    const char* holdText = holdValue.as<const char*>();
+    bool autoHold = holdText != nullptr && strcmp(holdText, "auto") == 0;
+    if ((!holdValue.isNull() && !autoHold && !holdValue.is<long>()) || (!gapValue.isNull() && !gapValue.is<long>())) {
+      errorMsg = prefix + "hold_ms and gap_ms must be integers (hold_ms may be 'auto')";
+      return false;
+    }
+    long holdMs = autoHold ? 0L : (holdValue | 100L);
+    long gapMs = gapValue | 0L;
+    if (holdMs < 0 || holdMs > KEY_SEQUENCE_MAX_DELAY_MS || gapMs < 0 || gapMs > KEY_SEQUENCE_MAX_DELAY_MS) {
+      errorMsg = prefix + "hold_ms and gap_ms must be 0-" + String(KEY_SEQUENCE_MAX_DELAY_MS) + " (hold_ms may be 'auto')";
+      return false;
+    }
+    step.holdMs = autoHold ? KEY_HOLD_AUTO : holdMs;
+    step.gapMs = gapMs;
+    sequence.count++;
+  }
+  return true;
+}
+
+// Streams the per-step timestamps once the scheduler has finished the sequence.
+// Until then the filler asks the web server to try again later.
+AsyncWebServerResponse* beginSequenceResponse(AsyncWebServerRequest *request, std::shared_ptr<KeySequence> sequence) {
+  std::shared_ptr<int> nextPart = std::make_shared<int>(-1); // -1 = header, count = footer
   
-  AsyncWebServerResponse *response = request->beginResponse(httpCode, "application/json", jsonResponse);
+  return request->beginChunkedResponse("application/json", [sequence, nextPart](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+    if (!sequence->done.load()) {
+      return RESPONSE_TRY_AGAIN;
+    }
+    HeapTagScope heapTag(HEAP_TAG_WEB);   // Later chunks are filled outside the request middleware
+    
+    size_t written = 0;
+    char part[160];
+    while (*nextPart <= sequence->count) {
+      int len;
+      if (*nextPart < 0) {
+        len = snprintf(part, sizeof(part), "{\"status\":\"success\",\"requestId\":%u,\"startedAt\":%lld,\"steps\":[",
+                       sequence->requestId, (long long)sequence->startedAt);
+      } else if (*nextPart < sequence->count) {
+        const KeySequenceStep& step = sequence->steps[*nextPart];
+        len = snprintf(part, sizeof(part), "%s{\"index\":%d,\"pressedUs\":%lld,\"releasedUs\":%lld,\"holdUs\":%lld}",
+                       *nextPart > 0 ? "," : "", *nextPart,
+                       (long long)(step.pressedAt - sequence->startedAt),
+                       (long long)(step.releasedAt - sequence->startedAt),
+                       (long long)(step.releasedAt - step.pressedAt));
+      } else {
+        len = snprintf(part, sizeof(part), "]}");
+      }
+      if (written + len > maxLen) {
+        break;
+      }
+      memcpy(buffer + written, part, len);
+      written += len;
+      (*nextPart)++;
+    }
+    return written;
+  });
+}
+
+// JSON is written by a JsonWriter straight into the response buffer
+AsyncResponseStream* beginJsonResponse(AsyncWebServerRequest *request, int httpCode) {
+  AsyncResponseStream *response = request->beginResponseStream("application/json", JSON_RESPONSE_BUFFER);
+  response->setCode(httpCode);
   response->addHeader("Access-Control-Allow-Origin", "*");
+  return response;
+}
+
+// Every response carries "status" ("success" or "error"), the HTTP code tells the error
+void sendJsonResponse(AsyncWebServerRequest *request, int httpCode, const char* message) {
+  AsyncResponseStream *response = beginJsonResponse(request, httpCode);
+  JsonWriter json(*response);
+  json.beginObject()
+      .add("status", httpCode < 400 ? "success" : "error")
+      .add("message", message)
+      .endObject();
   request->send(response);
 }
 
+void sendJsonResponse(AsyncWebServerRequest *request, int httpCode, const String& message) {
+  sendJsonResponse(request, httpCode, message.c_str());
+}
+
 void setupWebServer() {
     Serial.println("Initializing web server and REST API...");
     
     // Load authentication token
     loadAuthToken();
     
+    // Counts every request for /metrics (route, status, handler run time)
+    server.addMiddleware([](AsyncWebServerRequest *request, ArMiddlewareNext next) {
+      int64_t startedAt = esp_timer_get_time();
+      HeapTagScope heapTag(HEAP_TAG_WEB);
+      next();
+      AsyncWebServerResponse *response = request->getResponse();
+      metrics.recordHttpRequest(request, response != nullptr ? response->code() : 0,
+                                (uint32_t)(esp_timer_get_time() - startedAt));
+    });
+
+    // Prometheus text format, streamed in chunks
+    server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      request->send(metrics.beginResponse(request));
+    });
+
     // API endpoint for pair command
     server.on("/api/pair", HTTP_GET, [](AsyncWebServerRequest *request) {
       if (!validateToken(request)) {
@@ -128,10 +394,10 @@ void setupWebServer() {
       // Direct call to the extended BleRemoteControl method
       if (bleRemoteControl.startAdvertising())
       {
-        Serial.println("BLE advertising started for pairing...");
+        DLOG(WEB_PAIR_STARTED);
         sendJsonResponse(request, 200, "BLE advertising started for pairing");
       } else {
-        Serial.println("Failed to start BLE advertising for pairing");
+        DLOG(WEB_PAIR_FAILED);
         sendJsonResponse(request, 400, "Failed to start BLE advertising for pairing");
       }
     });
@@ -169,48 +435,89 @@ void setupWebServer() {
 
     // API endpoint for press command
     server.on("/api/press", HTTP_GET, [](AsyncWebServerRequest *request) {
+      LatencyTrace trace = {};
+      trace.mark(trace.parsedAt);
       if (!validateToken(request)) {
         sendUnauthorizedResponse(request);
         return;
       }
+      trace.mark(trace.validatedAt);
       
       String keyParam = "";
-      if(!bleRemoteControl.isConnected()) {
-        sendJsonResponse(request, 400, "{\"status\":\"error\",\"message\":\"Not connected to a host\"}");
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
         return;
-      } 
+      }
       if (!getKeyParameter(request, keyParam)) {
-        sendJsonResponse(request, 400, "{\"status\":\"error\",\"message\":\"Missing key parameter\"}");
+        sendJsonResponse(request, 400, "Missing key parameter");
         return;
       } 
-      if (bleRemoteControl.sendPress(keyParam)) {
-        sendJsonResponse(request, 200, "{\"status\":\"success\",\"message\":\"Key pressed: " + keyParam + "\"}");
-      } else {
-        sendJsonResponse(request, 400, "{\"status\":\"success\",\"message\":\"Failed to press key: " + keyParam + "\"}");
+      KeyId keyId = resolveKeyName(keyParam.c_str(), keyParam.length());
+      trace.mark(trace.resolvedAt);
+      if (!keyId.isValid()) {
+        sendJsonResponse(request, 400, "Unknown key: " + keyParam);
+        return;
       }
+      if (rejectOnTxBackpressure(request, target)) {
+        return;
+      }
+      uint32_t requestId = keyScheduler.press(keyId, target, &trace);
+      if (requestId == 0) {
+        sendJsonResponse(request, 503, "Key queue full, failed to press key: " + keyParam);
+        return;
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("message", "Key press queued")
+          .add("key", keyParam)
+          .add("requestId", requestId)
+          .endObject();
+      request->send(response);
     });
 
     // API endpoint for release command
     server.on("/api/release", HTTP_GET, [](AsyncWebServerRequest *request) {
+      LatencyTrace trace = {};
+      trace.mark(trace.parsedAt);
       if (!validateToken(request)) {
         sendUnauthorizedResponse(request);
         return;
       }
+      trace.mark(trace.validatedAt);
       
       String keyParam = "";
-      if(!bleRemoteControl.isConnected()) {
-        sendJsonResponse(request, 400, "{\"status\":\"error\",\"message\":\"Not connected to a host\"}");
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
         return;
-      } 
+      }
       if (!getKeyParameter(request, keyParam)) {
-        sendJsonResponse(request, 400, "{\"status\":\"error\",\"message\":\"Missing key parameter\"}");
+        sendJsonResponse(request, 400, "Missing key parameter");
         return;
       } 
-      if (bleRemoteControl.sendRelease(keyParam)) {
-        sendJsonResponse(request, 200, "{\"status\":\"success\",\"message\":\"Key released: " + keyParam + "\"}");
-      } else {
-        sendJsonResponse(request, 400, "{\"status\":\"success\",\"message\":\"Failed to release key: " + keyParam + "\"}");
+      KeyId keyId = resolveKeyName(keyParam.c_str(), keyParam.length());
+      trace.mark(trace.resolvedAt);
+      if (!keyId.isValid()) {
+        sendJsonResponse(request, 400, "Unknown key: " + keyParam);
+        return;
+      }
+      uint32_t requestId = keyScheduler.release(keyId, target, &trace);
+      if (requestId == 0) {
+        sendJsonResponse(request, 503, "Key queue full, failed to release key: " + keyParam);
+        return;
       }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("message", "Key release queued")
+          .add("key", keyParam)
+          .add("requestId", requestId)
+          .endObject();
+      request->send(response);
     });
 
     // API endpoint for releaseAll command
@@ -220,54 +527,82 @@ void setupWebServer() {
         return;
       }
       
-      if(!bleRemoteControl.isConnected()) {
-        sendJsonResponse(request, 400, "Not connected to a host");
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
         return;
       }
       
-      bleRemoteControl.releaseAll();
+      if (keyScheduler.releaseAll(target) == 0) {
+        sendJsonResponse(request, 503, "Key queue full");
+        return;
+      }
       sendJsonResponse(request, 200, "All keys released successfully");
     });
 
     // API endpoint for key command (press + optional delay + release)
     server.on("/api/key", HTTP_GET, [](AsyncWebServerRequest *request) {
+      LatencyTrace trace = {};
+      trace.mark(trace.parsedAt);
       if (!validateToken(request)) {
         sendUnauthorizedResponse(request);
         return;
       }
+      trace.mark(trace.validatedAt);
       
-      String keyParam = "";
-      int delayParam = 100; // Default delay value
-      int responseCode = 400;
-      String response = "{\"status\":\"error\",\"message\":\"Missing key parameter\"}";
-      
-      if (getKeyParameter(request, keyParam)) {
-        // Check if delay parameter exists
-        if (request->hasParam("delay")) {
-          delayParam = request->getParam("delay")->value().toInt();
-        }
-        
-        if(bleRemoteControl.sendKey(keyParam, delayParam))
-        {
-          response = "{\"status\":\"success\",\"message\":\"Key pressed and released: " + keyParam + 
-                     "\", \"delay\":" + String(delayParam) + "}";
-          responseCode = 200;
-        } else {
-          response = "{\"status\":\"error\",\"message\":\"Failed to process key: " + keyParam + "\"}";
-        }
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
+        return;
       }
-      sendJsonResponse(request, responseCode, response);
+      
+      String keyParam;
+      if (!getKeyParameter(request, keyParam)) {
+        sendJsonResponse(request, 400, "Missing key parameter");
+        return;
+      }
+      uint32_t delayParam;
+      if (!getHoldParameter(request, delayParam)) {
+        return;
+      }
+      KeyId keyId = resolveKeyName(keyParam.c_str(), keyParam.length());
+      trace.mark(trace.resolvedAt);
+      if (!keyId.isValid()) {
+        sendJsonResponse(request, 400, "Unknown key: " + keyParam);
+        return;
+      }
+      if (rejectOnTxBackpressure(request, target)) {
+        return;
+      }
+      
+      uint32_t requestId = keyScheduler.tap(keyId, delayParam, target, &trace);
+      if (requestId == 0) {
+        sendJsonResponse(request, 503, "Key queue full, failed to process key: " + keyParam);
+        return;
+      }
+      DLOG(WEB_KEY_QUEUED, requestId, keyId.kind, keyId.code, delayParam);
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("message", "Key press and release queued")
+          .add("key", keyParam);
+      addHoldTime(json, "delay", delayParam);
+      json.add("requestId", requestId).endObject();
+      request->send(response);
     });
 
     // API endpoint for raw media key command (hex values)
     server.on("/api/rawmediakey", HTTP_GET, [](AsyncWebServerRequest *request) {
+      LatencyTrace trace = {};
+      trace.mark(trace.parsedAt);
       if (!validateToken(request)) {
         sendUnauthorizedResponse(request);
         return;
       }
+      trace.mark(trace.validatedAt);
       
-      if (!bleRemoteControl.isConnected()) {
-        sendJsonResponse(request, 400, "Not connected to a host");
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
         return;
       }
       
@@ -277,11 +612,9 @@ void setupWebServer() {
       }
       
       String valueParam = request->getParam("value")->value();
-      int delayParam = 100; // Default delay value
-      
-      // Check if delay parameter exists
-      if (request->hasParam("delay")) {
-        delayParam = request->getParam("delay")->value().toInt();
+      uint32_t delayParam;
+      if (!getHoldParameter(request, delayParam)) {
+        return;
       }
       
       // Parse hex value
@@ -290,32 +623,393 @@ void setupWebServer() {
         sendJsonResponse(request, 400, "Invalid hex value format (use 0xXX or 0xXXXX)");
         return;
       }
+      trace.mark(trace.resolvedAt);
       
-      if (bleRemoteControl.sendMediaKey(hexValue, 0, delayParam)) {
-        StaticJsonDocument<256> doc;
-        doc["status"] = "success";
-        doc["message"] = "Raw media key sent";
-        doc["value"] = "0x" + String(hexValue, HEX);
-        doc["delay"] = delayParam;
-        
-        String jsonResponse;
-        serializeJson(doc, jsonResponse);
-        sendJsonResponse(request, 200, jsonResponse);
-      } else {
-        sendJsonResponse(request, 400, "Failed to send raw media key");
+      if (rejectOnTxBackpressure(request, target)) {
+        return;
+      }
+      
+      uint32_t requestId = keyScheduler.tapMedia(hexValue, 0, delayParam, target, &trace);
+      if (requestId == 0) {
+        sendJsonResponse(request, 503, "Key queue full, failed to send raw media key");
+        return;
       }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("message", "Raw media key queued")
+          .addHex("value", hexValue);
+      addHoldTime(json, "delay", delayParam);
+      json.add("requestId", requestId).endObject();
+      request->send(response);
     });
 
-    server.on("/api/system/diagnostics", HTTP_GET, [](AsyncWebServerRequest *request) {
+    // API endpoint for long presses, optionally with auto-repeat while the key is held
+    server.on("/api/hold", HTTP_GET, [](AsyncWebServerRequest *request) {
+      LatencyTrace trace = {};
+      trace.mark(trace.parsedAt);
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      trace.mark(trace.validatedAt);
+      
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
+        return;
+      }
+      
+      String keyParam;
+      if (!getKeyParameter(request, keyParam)) {
+        sendJsonResponse(request, 400, "Missing key parameter");
+        return;
+      }
+      KeyId keyId = resolveKeyName(keyParam.c_str(), keyParam.length());
+      trace.mark(trace.resolvedAt);
+      if (!keyId.isValid()) {
+        sendJsonResponse(request, 400, "Unknown key: " + keyParam);
+        return;
+      }
+      
+      uint32_t duration;
+      KeyRepeat repeat = {};
+      if (!getMillisecondsParameter(request, "duration", duration, 1000) ||
+          !getMillisecondsParameter(request, "repeat_delay", repeat.delayMs, 500) ||
+          !getMillisecondsParameter(request, "repeat_interval", repeat.intervalMs, 0)) {
+        return;
+      }
+      if (duration == 0) {
+        sendJsonResponse(request, 400, "duration must be 1-" + String(KEY_HOLD_MAX_MS) + " ms");
+        return;
+      }
+      if (repeat.intervalMs > 0 && (repeat.intervalMs < KEY_REPEAT_MIN_INTERVAL_MS || repeat.delayMs < KEY_REPEAT_MIN_INTERVAL_MS)) {
+        sendJsonResponse(request, 400, "repeat_interval and repeat_delay must be at least " + String(KEY_REPEAT_MIN_INTERVAL_MS) + " ms");
+        return;
+      }
+      
+      if (rejectOnTxBackpressure(request, target)) {
+        return;
+      }
+      
+      uint32_t requestId = keyScheduler.hold(keyId, duration, repeat, target, &trace);
+      if (requestId == 0) {
+        sendJsonResponse(request, 503, "Key queue full, failed to process key: " + keyParam);
+        return;
+      }
+      DLOG(WEB_KEY_QUEUED, requestId, keyId.kind, keyId.code, (uint32_t)duration);
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("message", "Key hold queued")
+          .add("key", keyParam)
+          .add("duration", duration);
+      if (repeat.intervalMs > 0) {
+        json.add("repeatDelay", repeat.delayMs)
+            .add("repeatInterval", repeat.intervalMs);
+      }
+      json.add("repeats", KeyScheduler::countRepeats(duration, repeat))
+          .add("requestId", requestId)
+          .endObject();
+      request->send(response);
+    });
+
+    // API endpoint for batched key sequences (JSON array of {key|raw, hold_ms, gap_ms})
+    server.on("/api/sequence", HTTP_POST, [](AsyncWebServerRequest *request) {
       if (!validateToken(request)) {
         sendUnauthorizedResponse(request);
         return;
       }
       
-      String jsonResponse = getDeviceInfo();
-      AsyncWebServerResponse *response = request->beginResponse(200, "application/json", jsonResponse);
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
+        return;
+      }
+      
+      char* body = (char*)request->_tempObject;
+      if (body == nullptr) {
+        sendJsonResponse(request, 400, "Missing or too large request body");
+        return;
+      }
+      
+      DynamicJsonDocument doc(KEY_SEQUENCE_JSON_CAPACITY);
+      DeserializationError error = deserializeJson(doc, body);
+      if (error || !doc.is<JsonArray>()) {
+        sendJsonResponse(request, 400, "Body must be a JSON array of steps");
+        return;
+      }
+      
+      std::shared_ptr<KeySequence> sequence = std::make_shared<KeySequence>();
+      String errorMsg;
+      if (!parseKeySequence(doc.as<JsonArray>(), *sequence, errorMsg)) {
+        sendJsonResponse(request, 400, errorMsg);
+        return;
+      }
+      sequence->target = target;
+      
+      if (rejectOnTxBackpressure(request, target)) {
+        return;
+      }
+      
+      if (keyScheduler.runSequence(sequence) == 0) {
+        sendJsonResponse(request, 503, "Key queue full, sequence rejected");
+        return;
+      }
+      
+      AsyncWebServerResponse *response = beginSequenceResponse(request, sequence);
       response->addHeader("Access-Control-Allow-Origin", "*");
       request->send(response);
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+      collectRequestBody(request, data, len, index, total, KEY_SEQUENCE_MAX_BODY);
+    });
+
+    // API endpoint for typing text. POST the text as form field to keep it out of URLs.
+    server.on("/api/type", HTTP_GET | HTTP_POST, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
+        return;
+      }
+      
+      bool isPost = request->hasParam("text", true);
+      if (!isPost && !request->hasParam("text")) {
+        sendJsonResponse(request, 400, "Missing text parameter");
+        return;
+      }
+      const String& text = request->getParam("text", isPost)->value();
+      if (text.length() == 0 || text.length() > KEY_TYPE_MAX_LENGTH) {
+        sendJsonResponse(request, 400, "Text must be 1-" + String(KEY_TYPE_MAX_LENGTH) + " characters");
+        return;
+      }
+      int untypable = TextPacker::findUntypable(text.c_str(), text.length());
+      if (untypable >= 0) {
+        sendJsonResponse(request, 400, "Character at position " + String(untypable) + " cannot be typed");
+        return;
+      }
+      
+      long rollover = TEXT_PACKER_MAX_ROLLOVER;
+      if (request->hasParam("rollover")) {
+        rollover = request->getParam("rollover")->value().toInt();
+        if (rollover < 1 || rollover > TEXT_PACKER_MAX_ROLLOVER) {
+          sendJsonResponse(request, 400, "rollover must be 1-" + String(TEXT_PACKER_MAX_ROLLOVER));
+          return;
+        }
+      }
+      uint32_t holdMs;
+      if (!getHoldParameter(request, holdMs, KEY_HOLD_AUTO)) {
+        return;
+      }
+      
+      if (rejectOnTxBackpressure(request, target)) {
+        return;
+      }
+      
+      uint32_t requestId = keyScheduler.type(text.c_str(), text.length(), holdMs, rollover, target);
+      if (requestId == 0) {
+        sendJsonResponse(request, 503, "Key queue full, text rejected");
+        return;
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("message", "Text queued")
+          .add("requestId", requestId)
+          .add("characters", text.length())
+          .add("reports", TextPacker::countReports(text.c_str(), text.length(), rollover));
+      addHoldTime(json, "delay", holdMs);
+      json.endObject();
+      request->send(response);
+    });
+
+    // API endpoint for key scheduler progress (request IDs are returned by the key endpoints)
+    server.on("/api/queue", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("pending", keyScheduler.pending())
+          .add("lastCompleted", keyScheduler.lastCompletedId())
+          .add("keysSent", keyScheduler.getKeysSent())
+          .add("peakKeysPerSecond", keyScheduler.getPeakKeysPerSecond())
+          .endObject();
+      if (request->hasParam("reset") && request->getParam("reset")->value() == "1") {
+        keyScheduler.resetPeakKeysPerSecond();
+      }
+      request->send(response);
+    });
+
+    // Session recording. Sub-routes first, /api/record would also match them.
+    server.on("/api/record/start", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      if (!keyRecorder.start()) {
+        sendJsonResponse(request, 500, "Recorder not available");
+        return;
+      }
+      sendJsonResponse(request, 200, "Recording started");
+    });
+
+    server.on("/api/record/stop", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      if (!keyRecorder.isRecording()) {
+        sendJsonResponse(request, 409, "Not recording");
+        return;
+      }
+      bool saved = keyRecorder.stop();
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("message", saved ? "Recording stopped and saved" : "Recording stopped, saving to flash failed")
+          .add("events", keyRecorder.getEventCount())
+          .add("bytes", keyRecorder.getLength())
+          .add("durationMs", (uint32_t)(keyRecorder.getDurationUs() / 1000))
+          .endObject();
+      request->send(response);
+    });
+
+    server.on("/api/record/export", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      // The stream response keeps its own copy, the snapshot buffer can go right away
+      std::unique_ptr<uint8_t[]> data(new uint8_t[KEY_RECORDER_CAPACITY]);
+      size_t length = keyRecorder.snapshot(data.get(), KEY_RECORDER_CAPACITY);
+      
+      AsyncResponseStream *response = request->beginResponseStream("application/octet-stream", length);
+      response->write(data.get(), length);
+      response->addHeader("Content-Disposition", "attachment; filename=\"recording.bin\"");
+      response->addHeader("Access-Control-Allow-Origin", "*");
+      request->send(response);
+    });
+
+    server.on("/api/record/import", HTTP_POST, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      uint8_t* body = (uint8_t*)request->_tempObject;
+      if (body == nullptr) {
+        sendJsonResponse(request, 400, "Missing or too large request body (max. " + String(KEY_RECORDER_CAPACITY) + " bytes)");
+        return;
+      }
+      if (keyRecorder.isRecording()) {
+        sendJsonResponse(request, 409, "Recording in progress");
+        return;
+      }
+      
+      String error;
+      if (!keyRecorder.import(body, request->contentLength(), error)) {
+        sendJsonResponse(request, 400, "Invalid recording: " + error);
+        return;
+      }
+      sendJsonResponse(request, 200, error.isEmpty() ? "Imported " + String(keyRecorder.getEventCount()) + " events" : error);
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+      collectRequestBody(request, data, len, index, total, KEY_RECORDER_CAPACITY);
+    });
+
+    server.on("/api/record", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("recording", keyRecorder.isRecording())
+          .add("events", keyRecorder.getEventCount())
+          .add("bytes", keyRecorder.getLength())
+          .add("capacity", KEY_RECORDER_CAPACITY)
+          .add("durationMs", (uint32_t)(keyRecorder.getDurationUs() / 1000))
+          .add("truncated", keyRecorder.isTruncated())
+          .add("replaying", keyScheduler.isReplaying())
+          .endObject();
+      request->send(response);
+    });
+
+    // Replays the recording on the device, timed by the key scheduler
+    server.on("/api/replay", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
+        return;
+      }
+      
+      long scale = request->hasParam("scale") ? request->getParam("scale")->value().toInt() : 100;
+      if (scale < KEY_REPLAY_MIN_SCALE || scale > KEY_REPLAY_MAX_SCALE) {
+        sendJsonResponse(request, 400, "scale must be " + String(KEY_REPLAY_MIN_SCALE) + "-" + String(KEY_REPLAY_MAX_SCALE) + " percent");
+        return;
+      }
+      if (keyRecorder.isRecording()) {
+        sendJsonResponse(request, 409, "Recording in progress");
+        return;
+      }
+      if (keyRecorder.getEventCount() == 0) {
+        sendJsonResponse(request, 404, "No recording");
+        return;
+      }
+      
+      if (rejectOnTxBackpressure(request, target)) {
+        return;
+      }
+      
+      uint32_t requestId = keyScheduler.replay(scale, target);
+      if (requestId == 0) {
+        sendJsonResponse(request, 503, "Key queue full, replay rejected");
+        return;
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("message", "Replay queued")
+          .add("events", keyRecorder.getEventCount())
+          .add("durationMs", (uint32_t)(keyRecorder.getDurationUs() / 1000 * scale / 100))
+          .add("requestId", requestId)
+          .endObject();
+      request->send(response);
+    });
+
+    server.on("/api/system/diagnostics", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      writeDeviceInfo(json);
+      request->send(response);
     });
 
     server.on("/api/system/battery", HTTP_GET, [](AsyncWebServerRequest *request) {
@@ -324,22 +1018,139 @@ void setupWebServer() {
         return;
       }
       
-      int levelParam = 100;
-      String response = "{\"status\":\"error\",\"message\":\"Missing level parameter\"}";
-      int responseCode = 400;
+      if (!request->hasParam("level")) {
+        sendJsonResponse(request, 400, "Missing level parameter");
+        return;
+      }
+      int levelParam = request->getParam("level")->value().toInt();
+      if (levelParam < 0 || levelParam > 100) {
+        sendJsonResponse(request, 400, "Invalid battery level value '" + String(levelParam) + "'");
+        return;
+      }
+      bleRemoteControl.setBatteryLevel(levelParam);
+      sendJsonResponse(request, 200, "Battery level set to " + String(levelParam));
+    });
+
+    // Per-stage latency of key commands (p50/p95/p99/max in microseconds)
+    server.on("/api/system/latency", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject().beginObject("stages");
+      for (uint8_t i = 0; i < LAT_STAGE_COUNT; i++) {
+        LatencyStats stats = latencyTracker.getStats((LatencyStage)i);
+        json.beginObject(LatencyTracker::stageName((LatencyStage)i))
+            .add("count", stats.count)
+            .add("p50", stats.p50)
+            .add("p95", stats.p95)
+            .add("p99", stats.p99)
+            .add("max", stats.max)
+            .endObject();
+      }
+      json.endObject().add("unit", "us");
       
-      // Check if key parameter exists
-      if (request->hasParam("level")) {
-        levelParam = request->getParam("level")->value().toInt();
-        if(levelParam >= 0 && levelParam <= 100) {
-          bleRemoteControl.setBatteryLevel(levelParam);
-          response = "{\"status\":\"success\",\"message\":\"Battery level set to " + String(levelParam) + "\"}";
-          responseCode = 200;
+      if (request->hasParam("reset") && request->getParam("reset")->value() == "1") {
+        latencyTracker.reset();
+        json.add("reset", true);
+      }
+      json.endObject();
+      request->send(response);
+    });
+
+    // Last heap snapshot with the allocations per subsystem
+    server.on("/api/system/heap", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      HeapSnapshot snapshot = heapMonitor.getSnapshot();
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("ageMs", millis() - snapshot.takenAt)
+          .add("freeHeap", snapshot.freeBytes)
+          .add("minFreeHeap", snapshot.minFreeBytes)
+          .add("largestFreeBlock", snapshot.largestBlock)
+          .add("fragmentation", snapshot.fragmentation)
+          .add("freeDelta", snapshot.freeDelta)
+          .beginObject("alarm")
+          .add("active", snapshot.alarm)
+          .add("count", heapMonitor.getAlarmCount())
+          .add("freeThreshold", heapMonitor.getFreeThreshold())
+          .add("blockThreshold", heapMonitor.getBlockThreshold())
+          .endObject()
+          .add("accounting", HeapMonitor::isAccounting())
+          .beginObject("subsystems");
+      for (uint8_t i = 0; i < HEAP_TAG_COUNT; i++) {
+        const HeapTagStats& stats = snapshot.tags[i];
+        json.beginObject(HeapMonitor::tagName((HeapTag)i))
+            .add("allocations", stats.allocations)
+            .add("frees", stats.frees)
+            .add("allocatedBytes", stats.allocatedBytes)
+            .add("freedBytes", stats.freedBytes)
+            .endObject();
+      }
+      json.endObject().endObject();
+      request->send(response);
+    });
+
+    // CPU share per task over sliding windows and stack high-water marks
+    server.on("/api/system/tasks", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      if (!TaskProfiler::isAvailable()) {
+        sendJsonResponse(request, 501, "FreeRTOS run time statistics are not enabled");
+        return;
+      }
+      
+      // Copied before the response, the mutex is not held while writing
+      std::unique_ptr<TaskProfile[]> tasks(new TaskProfile[TASK_PROFILER_MAX_TASKS]);
+      size_t count = taskProfiler.getTasks(tasks.get(), TASK_PROFILER_MAX_TASKS);
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("intervalMs", TASK_PROFILER_INTERVAL_MS)
+          .add("samples", taskProfiler.getSamples())
+          .add("untracked", taskProfiler.getUntracked())
+          .beginArray("windows");
+      for (uint8_t w = 0; w < TASK_PROFILER_WINDOW_COUNT; w++) {
+        json.add(nullptr, TaskProfiler::windowSeconds(w));
+      }
+      json.endArray().beginArray("cores");
+      for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+        json.beginObject().add("core", core).beginArray("load");
+        for (uint8_t w = 0; w < TASK_PROFILER_WINDOW_COUNT; w++) {
+          json.add(nullptr, taskProfiler.getCoreLoad(core, w));
+        }
+        json.endArray().endObject();
+      }
+      json.endArray().beginArray("tasks");
+      for (size_t i = 0; i < count; i++) {
+        const TaskProfile& task = tasks[i];
+        json.beginObject()
+            .add("name", task.name)
+            .add("number", task.taskNumber)
+            .add("priority", task.priority);
+        if (task.core < 0) {
+          json.addNull("core");
         } else {
-          response = "{\"status\":\"error\",\"message\":\"Invalid battery level value'"+ String(levelParam) + "'\"}";
+          json.add("core", task.core);
+        }
+        json.beginArray("cpu");
+        for (uint8_t w = 0; w < TASK_PROFILER_WINDOW_COUNT; w++) {
+          json.add(nullptr, task.cpu[w]);
         }
+        json.endArray().add("stackFree", task.stackHighWater).endObject();
       }
-      sendJsonResponse(request, responseCode, response);
+      json.endArray().endObject();
+      request->send(response);
     });
 
     server.on("/api/system/reboot", HTTP_GET, [](AsyncWebServerRequest *request) {
@@ -348,10 +1159,7 @@ void setupWebServer() {
         return;
       }
       
-      String response = "{\"status\":\"success\",\"message\":\"Rebooting device...\"}";
-      AsyncWebServerResponse *serverResponse = request->beginResponse(200, "application/json", response);
-      serverResponse->addHeader("Access-Control-Allow-Origin", "*");
-      request->send(serverResponse);
+      sendJsonResponse(request, 200, "Rebooting device...");
       delay(1000); // Delay to allow the response to be sent before rebooting
       ESP.restart(); // Reboot the device
     });
@@ -553,17 +1361,29 @@ void setupWebServer() {
       // Save configuration if changes were made
       if (configChanged) {
         if (bleRemoteControl.saveConfiguration()) {
-          StaticJsonDocument<256> responseDoc;
-          responseDoc["status"] = "success";
-          responseDoc["message"] = "BLE configuration updated successfully";
-          responseDoc["details"] = successMsg.isEmpty() ? "Configuration saved" : successMsg;
-          responseDoc["note"] = "Restart required for changes to take effect";
-          
-          String jsonResponse;
-          serializeJson(responseDoc, jsonResponse);
-          
-          AsyncWebServerResponse *response = request->beginResponse(200, "application/json", jsonResponse);
-          response->addHeader("Access-Control-Allow-Origin", "*");
+          // Identity values are re-provisioned in place by the main loop, the
+          // request is answered with 202 before the hosts are disconnected.
+          // The MAC address needs a restart.
+          bool identityChanged = doc.containsKey("vendorId") || doc.containsKey("productId") ||
+                                 doc.containsKey("versionId") || doc.containsKey("countryCode") ||
+                                 doc.containsKey("hidFlags") || doc.containsKey("deviceName") ||
+                                 doc.containsKey("manufacturerName");
+          if (identityChanged) {
+            bleRemoteControl.requestReprovision();
+          }
+          AsyncResponseStream *response = beginJsonResponse(request, identityChanged ? 202 : 200);
+          JsonWriter json(*response);
+          json.beginObject()
+              .add("status", "success")
+              .add("message", "BLE configuration updated successfully")
+              .add("details", successMsg.isEmpty() ? "Configuration saved" : successMsg.c_str())
+              .add("switching", identityChanged);
+          if (doc.containsKey("macAddress") || doc.containsKey("initialBatteryLevel")) {
+            json.add("note", "Restart required for MAC address and initial battery level changes");
+          } else {
+            json.add("note", "Applied without restart, connected hosts were disconnected");
+          }
+          json.endObject();
           request->send(response);
         } else {
           sendJsonResponse(request, 500, "Failed to save configuration");
@@ -573,6 +1393,284 @@ void setupWebServer() {
       }
     });
 
+    // Identity profiles: save the current identity, delete, activate, list. The
+    // list route is registered last, a handler also matches URLs below its own.
+    server.on("/api/ble/profiles/save", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      if (!request->hasParam("name")) {
+        sendJsonResponse(request, 400, "Missing name parameter");
+        return;
+      }
+      String name = request->getParam("name")->value();
+      if (bleRemoteControl.saveProfile(name)) {
+        sendJsonResponse(request, 200, "Current identity saved as profile " + name);
+      } else {
+        sendJsonResponse(request, 400, "Name must be 1-" + String(BLE_PROFILE_NAME_LENGTH - 1) +
+                                       " characters and at most " + String(BLE_MAX_PROFILES) + " profiles can be stored");
+      }
+    });
+
+    server.on("/api/ble/profiles/delete", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      if (!request->hasParam("name")) {
+        sendJsonResponse(request, 400, "Missing name parameter");
+        return;
+      }
+      String name = request->getParam("name")->value();
+      if (bleRemoteControl.deleteProfile(name)) {
+        sendJsonResponse(request, 200, "Profile " + name + " deleted");
+      } else {
+        sendJsonResponse(request, 404, "Profile not found");
+      }
+    });
+
+    // Switches the identity without restart; the hosts are disconnected and
+    // reconnect to the device advertising as the new remote. Answered with 202
+    // at once, the "profile" event and the profile list report the result.
+    server.on("/api/ble/profiles/activate", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      if (!request->hasParam("name")) {
+        sendJsonResponse(request, 400, "Missing name parameter");
+        return;
+      }
+      String name = request->getParam("name")->value();
+      bool unpair = request->hasParam("unpair") && request->getParam("unpair")->value() == "1";
+      if (!bleRemoteControl.activateProfile(name, unpair)) {
+        sendJsonResponse(request, 404, "Profile not found");
+        return;
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 202);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("active", bleRemoteControl.getActiveProfile())
+          .add("switching", true)
+          .add("unpair", unpair)
+          .endObject();
+      request->send(response);
+    });
+
+    server.on("/api/ble/profiles", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      IdentityProfile profiles[BLE_MAX_PROFILES];
+      size_t count = bleRemoteControl.getProfiles(profiles, BLE_MAX_PROFILES);
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("active", bleRemoteControl.getActiveProfile())
+          .add("maxProfiles", BLE_MAX_PROFILES)
+          .add("switching", bleRemoteControl.isSwitching())
+          .add("switches", bleRemoteControl.getProfileSwitches())
+          .add("lastSwitchTimeUs", bleRemoteControl.getLastSwitchUs())
+          .beginArray("profiles");
+      for (size_t i = 0; i < count; i++) {
+        json.beginObject()
+            .add("name", profiles[i].name)
+            .addHex("vendorId", profiles[i].vendorId)
+            .addHex("productId", profiles[i].productId)
+            .addHex("versionId", profiles[i].versionId)
+            .addHex("countryCode", profiles[i].countryCode)
+            .addHex("hidFlags", profiles[i].hidFlags)
+            .add("deviceName", profiles[i].deviceName)
+            .add("manufacturerName", profiles[i].manufacturer)
+            .endObject();
+      }
+      json.endArray().endObject();
+      request->send(response);
+    });
+
+    // API endpoint listing the connected hosts (connId is the target for key commands)
+    server.on("/api/ble/connections", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject().add("maxConnections", BLE_MAX_CONNECTIONS);
+      addConnections(json, "connections");
+      json.endObject();
+      request->send(response);
+    });
+
+    // API endpoint for connection parameters: without parameters it lists the negotiated
+    // values, with min_interval (ms) it asks the target host(s) for new ones
+    server.on("/api/ble/connparams", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
+        return;
+      }
+      
+      bool requested = request->hasParam("min_interval");
+      uint16_t minInterval = 0;
+      uint16_t maxInterval = 0;
+      uint16_t timeout = 0;
+      long latency = 0;
+      if (requested) {
+        float minMs = request->getParam("min_interval")->value().toFloat();
+        float maxMs = request->hasParam("max_interval") ? request->getParam("max_interval")->value().toFloat() : minMs;
+        latency = request->hasParam("latency") ? request->getParam("latency")->value().toInt() : 0;
+        long timeoutMs = request->hasParam("timeout") ? request->getParam("timeout")->value().toInt() : 4000;
+        
+        minInterval = (uint16_t)lroundf(minMs / 1.25f);
+        maxInterval = (uint16_t)lroundf(maxMs / 1.25f);
+        timeout = (uint16_t)(timeoutMs / 10);
+        if (latency < 0 || timeoutMs < 0 || maxMs > 4000 ||
+            !BleRemoteControl::isValidConnParams(minInterval, maxInterval, (uint16_t)latency, timeout)) {
+          sendJsonResponse(request, 400, "Invalid connection parameters (interval 7.5-4000 ms, latency 0-499, "
+                                         "timeout 100-32000 ms and > 2 * (1 + latency) * max_interval)");
+          return;
+        }
+        esp_err_t err = bleRemoteControl.requestConnParams(target, minInterval, maxInterval, (uint16_t)latency, timeout);
+        if (err != ESP_OK) {
+          sendJsonResponse(request, 500, String("Connection parameter update failed: ") + esp_err_to_name(err));
+          return;
+        }
+      }
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject();
+      if (requested) {
+        json.beginObject("requested")
+            .add("minIntervalMs", minInterval * 1.25f)
+            .add("maxIntervalMs", maxInterval * 1.25f)
+            .add("latency", latency)
+            .add("timeoutMs", timeout * 10)
+            .endObject();
+      }
+      addConnections(json, "connections");
+      json.endObject();
+      request->send(response);
+    });
+
+    // API endpoint to disconnect one host (target=connId) or all of them
+    server.on("/api/ble/disconnect", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      uint8_t target;
+      if (!getTargetParameter(request, target)) {
+        return;
+      }
+      if (bleRemoteControl.disconnect(target)) {
+        sendJsonResponse(request, 200, "Disconnect requested");
+      } else {
+        sendJsonResponse(request, 400, "No matching connection");
+      }
+    });
+
+    // HID report descriptor: reset, the active one with its derived layout and
+    // upload (raw bytes as application/octet-stream or a hex dump)
+    server.on("/api/ble/descriptor/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      bleRemoteControl.clearReportDescriptor();
+      sendJsonResponse(request, 200, "Built-in descriptor restored, restart to apply");
+    });
+
+    server.on("/api/ble/descriptor", HTTP_GET, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      size_t length;
+      const uint8_t* descriptor = bleRemoteControl.getReportDescriptor(length);
+      const HidReportLayout& layout = bleRemoteControl.getReportLayout();
+      
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("source", bleRemoteControl.isCustomDescriptor() ? "uploaded" : "builtin")
+          .add("pending", bleRemoteControl.isDescriptorPending())
+          .add("length", length)
+          .addHexBytes("descriptor", descriptor, length);
+      if (layout.hasKeyboard) {
+        json.beginObject("keyboard")
+            .add("reportId", layout.keyboardId)
+            .add("length", layout.keyboardLength)
+            .add("modifiersBitOffset", layout.modifiers.bitSize > 0 ? (int)layout.modifiers.bitOffset : -1)
+            .add("keysBitOffset", layout.keys.bitOffset)
+            .add("keyCount", layout.keys.count)
+            .add("ledReportId", layout.hasOutput ? (int)layout.outputId : -1)
+            .endObject();
+      }
+      if (layout.hasConsumer) {
+        json.beginObject("consumer")
+            .add("reportId", layout.consumerId)
+            .add("length", layout.consumerLength)
+            .add("usageBits", layout.consumer.bitSize)
+            .add("usageCount", layout.consumer.count)
+            .endObject();
+      }
+      json.endObject();
+      request->send(response);
+    });
+
+    server.on("/api/ble/descriptor", HTTP_POST, [](AsyncWebServerRequest *request) {
+      if (!validateToken(request)) {
+        sendUnauthorizedResponse(request);
+        return;
+      }
+      
+      char* body = (char*)request->_tempObject;
+      if (body == nullptr) {
+        sendJsonResponse(request, 400, "Missing or too large request body");
+        return;
+      }
+      
+      uint8_t descriptor[HID_DESCRIPTOR_MAX_LENGTH];
+      size_t length = request->contentLength();
+      if (request->contentType().startsWith("application/octet-stream")) {
+        if (length > sizeof(descriptor)) {
+          sendJsonResponse(request, 400, "Descriptor longer than " + String(HID_DESCRIPTOR_MAX_LENGTH) + " bytes");
+          return;
+        }
+        memcpy(descriptor, body, length);
+      } else if (!parseHexBytes(body, descriptor, sizeof(descriptor), length)) {
+        sendJsonResponse(request, 400, "Body must be the descriptor as hex bytes (max. " + String(HID_DESCRIPTOR_MAX_LENGTH) + ")");
+        return;
+      }
+      
+      String error;
+      if (!bleRemoteControl.setReportDescriptor(descriptor, length, error)) {
+        sendJsonResponse(request, 400, "Invalid descriptor: " + error);
+        return;
+      }
+      sendJsonResponse(request, 200, "Descriptor stored (" + String(length) + " bytes), restart to apply");
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+      collectRequestBody(request, data, len, index, total, HID_DESCRIPTOR_MAX_BODY);
+    });
+
     // API endpoint to get current BLE configuration
     server.on("/api/ble/config", HTTP_GET, [](AsyncWebServerRequest *request) {
       if (!validateToken(request)) {
@@ -580,25 +1678,16 @@ void setupWebServer() {
         return;
       }
       
-      StaticJsonDocument<512> doc;
-      doc["vendorId"] = "0x" + String(bleRemoteControl.getVendorId(), HEX);
-      doc["productId"] = "0x" + String(bleRemoteControl.getProductId(), HEX);
-      doc["versionId"] = "0x" + String(bleRemoteControl.getVersionId(), HEX);
-      doc["countryCode"] = "0x" + String(bleRemoteControl.getCountryCode(), HEX);
-      doc["hidFlags"] = "0x" + String(bleRemoteControl.getHidFlags(), HEX);
-      doc["deviceName"] = bleRemoteControl.getDeviceName();
-      doc["manufacturerName"] = bleRemoteControl.getManufacturerName();
-      doc["initialBatteryLevel"] = bleRemoteControl.getInitialBatteryLevel();
-      doc["currentBatteryLevel"] = bleRemoteControl.getBatteryLevel();
-      doc["macAddress"] = bleRemoteControl.getCurrentMacAddressString();
-      doc["usingCustomMac"] = bleRemoteControl.isUsingCustomMac();
-      doc["connected"] = bleRemoteControl.isConnected();
-      doc["advertising"] = bleRemoteControl.isAdvertising();
-      
-      String jsonResponse;
-      serializeJson(doc, jsonResponse);
-      
-      AsyncWebServerResponse *response = request->beginResponse(200, "application/json", jsonResponse);
+      // Cached snapshot, a client that has the current version gets a 304
+      String etag;
+      String jsonResponse = stateStream.getConfig(etag);
+      const AsyncWebHeader* ifNoneMatch = request->getHeader("If-None-Match");
+      bool unchanged = ifNoneMatch != nullptr && !etag.isEmpty() && ifNoneMatch->value() == etag;
+      
+      AsyncWebServerResponse *response = unchanged ? request->beginResponse(304)
+                                                   : request->beginResponse(200, "application/json", jsonResponse);
+      response->addHeader("ETag", etag);
+      response->addHeader("Cache-Control", "no-cache");
       response->addHeader("Access-Control-Allow-Origin", "*");
       request->send(response);
     });
@@ -612,16 +1701,13 @@ void setupWebServer() {
       
       bleRemoteControl.resetConfiguration();
       
-      StaticJsonDocument<256> doc;
-      doc["status"] = "success";
-      doc["message"] = "BLE configuration reset to defaults";
-      doc["note"] = "Restart required for changes to take effect";
-      
-      String jsonResponse;
-      serializeJson(doc, jsonResponse);
-      
-      AsyncWebServerResponse *response = request->beginResponse(200, "application/json", jsonResponse);
-      response->addHeader("Access-Control-Allow-Origin", "*");
+      AsyncResponseStream *response = beginJsonResponse(request, 200);
+      JsonWriter json(*response);
+      json.beginObject()
+          .add("status", "success")
+          .add("message", "BLE configuration reset to defaults")
+          .add("note", "Restart required for changes to take effect")
+          .endObject();
       request->send(response);
     });
 
@@ -632,207 +1718,37 @@ void setupWebServer() {
         return;
       }
 
-      // Generate complete HTML response step by step
-      String htmlResponse = "";
-      htmlResponse.reserve(8192); // Reserve memory to avoid fragmentation
-      
-      htmlResponse += "<!DOCTYPE html>";
-      htmlResponse += "<html><head>";
-      htmlResponse += "<title>ESP32 BLE Remote Control - Documentation</title>";
-      htmlResponse += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-      htmlResponse += "<style>";
-      htmlResponse += "body{font-family:Arial,sans-serif;margin:20px;line-height:1.6}";
-      htmlResponse += "h1{color:#0066cc}";
-      htmlResponse += "h2{color:#0066cc;margin-top:20px}";
-      htmlResponse += ".container{max-width:800px;margin:0 auto;padding:20px;border:1px solid #ddd;border-radius:5px}";
-      htmlResponse += ".info{margin-bottom:10px}";
-      htmlResponse += ".api-section{margin-top:15px;padding:10px;background:#f7f7f7;border-radius:5px}";
-      htmlResponse += ".endpoint{margin-bottom:8px}";
-      htmlResponse += "a{color:#0066cc;text-decoration:none}";
-      htmlResponse += "a:hover{text-decoration:underline}";
-      htmlResponse += ".params{font-size:0.9em;color:#666;margin-left:20px}";
-      htmlResponse += "</style>";
-      htmlResponse += "</head>";
-      htmlResponse += "<body><div class='container'>";
-      htmlResponse += "<h1>ESP32 BLE Remote Control - Documentation</h1>";
-      
-      // Device information section
-      htmlResponse += "<div class='info'><strong>Device name:</strong> ";
-      htmlResponse += BLE_DEVICE_NAME;
-      htmlResponse += "</div>";
-      htmlResponse += "<div class='info'><strong>IP address:</strong> ";
-      htmlResponse += wifiManager.localIp().toString();
-      htmlResponse += "</div>";
-      htmlResponse += "<div class='info'><strong>MAC address:</strong> ";
-      htmlResponse += wifiManager.macAddress();
-      htmlResponse += "</div>";
-      htmlResponse += "<div class='info'><strong>WiFi:</strong> ";
-      htmlResponse += wifiManager.ssid();
-      htmlResponse += "</div>";
-      htmlResponse += "<div class='info'><strong>RSSI:</strong> ";
-      htmlResponse += String(wifiManager.RSSI());
-      htmlResponse += " dBm</div>";
-      
-      // Get the current token from the request
+      // Expanded chunk by chunk from flash, the page is never on the heap as a whole
       String currentToken = request->getParam("token")->value();
-      String baseUrl = "http://" + wifiManager.localIp().toString();
-      
-      // Authentication info section
-      htmlResponse += "<h2>Authentication</h2>";
-      htmlResponse += "<div class='api-section'><h3>Authentication</h3>";
-      htmlResponse += "<div class='endpoint'><strong>Token Required:</strong> All API endpoints require a 'token' parameter</div>";
-      htmlResponse += "<div class='endpoint'>Current Token: <code>";
-      htmlResponse += currentToken;
-      htmlResponse += "</code></div>";
-      htmlResponse += "</div>";
-      
-      // API endpoints section
-      htmlResponse += "<h2>API Endpoints</h2>";
-      
-      // BLE control endpoints
-      htmlResponse += "<div class='api-section'><h3>BLE Control</h3>";
-      htmlResponse += "<div class='endpoint'><a href='";
-      htmlResponse += baseUrl + "/api/pair?token=" + currentToken;
-      htmlResponse += "'>Start Pairing</a> - Starts BLE advertising for pairing</div>";
-      htmlResponse += "<div class='endpoint'><a href='";
-      htmlResponse += baseUrl + "/api/stoppair?token=" + currentToken;
-      htmlResponse += "'>Stop Pairing</a> - Stops BLE advertising</div>";
-      htmlResponse += "<div class='endpoint'><a href='";
-      htmlResponse += baseUrl + "/api/unpair?token=" + currentToken;
-      htmlResponse += "'>Unpair</a> - Removes all stored BLE pairings</div>";
-      htmlResponse += "</div>";
-      
-      // Key control endpoints
-      htmlResponse += "<div class='api-section'><h3>Remote Control</h3>";
-      htmlResponse += "<div class='endpoint'><a href='";
-      htmlResponse += baseUrl + "/api/releaseall?token=" + currentToken;
-      htmlResponse += "'>Release All Keys</a> - Release all currently pressed keys</div>";
-      htmlResponse += "<div class='endpoint'><strong>GET /api/key</strong> - Press and release a key";
-      htmlResponse += "<div class='params'>Parameters: key (required), delay in ms (optional, default=100), token (required)</div></div>";
-      htmlResponse += "<div class='endpoint'><strong>GET /api/rawmediakey</strong> - Send raw hex media key values";
-      htmlResponse += "<div class='params'>Parameters: value (hex, required), delay in ms (optional, default=100), token (required)</div></div>";
-      htmlResponse += "</div>";
-      
-      // Key examples section with working links
-      htmlResponse += "<div class='api-section'><h3>Key Examples</h3>";
-      htmlResponse += "<div class='endpoint'><a href='";
-      htmlResponse += baseUrl + "/api/key?key=up&token=" + currentToken;
-      htmlResponse += "'>Up Arrow</a></div>";
-      htmlResponse += "<div class='endpoint'><a href='";
-      htmlResponse += baseUrl + "/api/key?key=down&token=" + currentToken;
-      htmlResponse += "'>Down Arrow</a></div>";
-      htmlResponse += "<div class='endpoint'><a href='";
-      htmlResponse += baseUrl + "/api/key?key=enter&token=" + currentToken;
-      htmlResponse += "'>Enter</a></div>";
-      htmlResponse += "<div class='endpoint'><a href='";
-      htmlResponse += baseUrl + "/api/key?key=playpause&token=" + currentToken;
-      htmlResponse += "'>Play/Pause</a></div>";
-      htmlResponse += "</div>";
-      
-      // Available keys section
-      htmlResponse += "<h2>Available Keys</h2>";
-      htmlResponse += "<div class='api-section'><h3>Keys Reference</h3>";
-      htmlResponse += "<div class='endpoint'><strong>Media Keys:</strong> ";
-      
-      // Add media keys safely
-      for (int i = 0; i < NUM_MEDIA_KEY_MAPPINGS; i++) {
-        htmlResponse += mediaKeyMappings[i].name;
-        if (i < NUM_MEDIA_KEY_MAPPINGS - 1) {
-          htmlResponse += ", ";
-        }
-      }
-      htmlResponse += "</div>";
-      htmlResponse += "<div class='endpoint'><strong>Numbers:</strong> 0, 1, 2, 3, 4, 5, 6, 7, 8, 9</div>";
-      htmlResponse += "<div class='endpoint'><strong>Tip:</strong> Use the /api/rawmediakey endpoint for hexadecimal values (format: 0xXX or 0xXXXX)</div>";
-      htmlResponse += "</div>";
-      
-      htmlResponse += "</div></body></html>";
-      
-      request->send(200, "text/html", htmlResponse);
+      request->send(200, "text/html", (const uint8_t*)DOC_PAGE_TEMPLATE, strlen_P(DOC_PAGE_TEMPLATE),
+                    [currentToken](const String& name) {
+                      return expandPagePlaceholder(name, currentToken);
+                    });
     });
     
+    // Web console (unprotected, static), the page asks for the token and
+    // gets its data from the JSON API and /api/events
+    for (size_t i = 0; i < NUM_WEB_ASSETS; i++) {
+      const WebAsset& asset = WEB_ASSETS[i];
+      server.on(asset.path, HTTP_GET, [&asset](AsyncWebServerRequest *request) {
+        sendWebAsset(request, asset);
+      });
+    }
+    
     // Root endpoint (unprotected) - Configuration information
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-      String htmlResponse = generateHtmlHeader();
-      
-      // Device information section (without sensitive data)
-      String html = "<div class='info'><strong>Device name:</strong> " BLE_DEVICE_NAME "</div>";
-      html += "<div class='info'><strong>IP address:</strong> " + wifiManager.localIp().toString() + "</div>";
-      html += "<div class='info'><strong>WiFi:</strong> " + wifiManager.ssid() + "</div>";
-      htmlResponse += html;
-      
-      // Configuration instructions
-      htmlResponse += "<h2>Getting Started</h2>";
-      String configContent = HTML_ENDPOINT_START;
-      configContent += "<strong>Step 1:</strong> Connect to the device via serial console to get your authentication token";
-      configContent += HTML_ENDPOINT_END;
-      configContent += HTML_ENDPOINT_START;
-      configContent += "<strong>Step 2:</strong> Use the CLI command <code>config</code> to view your current token";
-      configContent += HTML_ENDPOINT_END;
-      configContent += HTML_ENDPOINT_START;
-      configContent += "<strong>Step 3:</strong> Access the full documentation at <code>/doc?token=YOUR_TOKEN</code>";
-      configContent += HTML_ENDPOINT_END;
-      configContent += HTML_ENDPOINT_START;
-      configContent += "<strong>Step 4:</strong> Use the token as a parameter in all API calls";
-      configContent += HTML_ENDPOINT_END;
-      htmlResponse += generateApiSection("Configuration", configContent);
-      
-      // Token information
-      htmlResponse += "<h2>Authentication</h2>";
-      String authContent = HTML_ENDPOINT_START;
-      authContent += "<strong>Token Required:</strong> All API endpoints require authentication";
-      authContent += HTML_ENDPOINT_END;
-      authContent += HTML_ENDPOINT_START;
-      authContent += "<strong>Token Location:</strong> Available via serial console using the <code>config</code> command";
-      authContent += HTML_ENDPOINT_END;
-      authContent += HTML_ENDPOINT_START;
-      authContent += "<strong>Generate New Token:</strong> Use the <code>createtoken</code> command in the CLI";
-      authContent += HTML_ENDPOINT_END;
-      authContent += HTML_ENDPOINT_START;
-      authContent += "Example API call: <code>/api/key?key=up&token=YOUR_TOKEN_HERE</code>";
-      authContent += HTML_ENDPOINT_END;
-      htmlResponse += generateApiSection("Authentication", authContent);
-      
-      // Available endpoints overview (without links)
-      htmlResponse += "<h2>Available API Endpoints</h2>";
-      String endpointsContent = HTML_ENDPOINT_START;
-      endpointsContent += "<strong>BLE Control:</strong> /api/pair, /api/stoppair, /api/unpair";
-      endpointsContent += HTML_ENDPOINT_END;
-      endpointsContent += HTML_ENDPOINT_START;
-      endpointsContent += "<strong>Remote Control:</strong> /api/key, /api/press, /api/release, /api/releaseall, /api/rawmediakey";
-      endpointsContent += HTML_ENDPOINT_END;
-      endpointsContent += HTML_ENDPOINT_START;
-      endpointsContent += "<strong>System:</strong> /api/system/diagnostics, /api/system/battery, /api/system/reboot";
-      endpointsContent += HTML_ENDPOINT_END;
-      endpointsContent += HTML_ENDPOINT_START;
-      endpointsContent += "<strong>Configuration:</strong> /api/ble/config (GET/POST), /api/ble/reset (POST)";
-      endpointsContent += HTML_ENDPOINT_END;
-      endpointsContent += HTML_ENDPOINT_START;
-      endpointsContent += "<strong>Documentation:</strong> /doc (requires token for full interactive documentation)";
-      endpointsContent += HTML_ENDPOINT_END;
-      htmlResponse += generateApiSection("API Overview", endpointsContent);
-      
-      // Serial console instructions
-      htmlResponse += "<h2>Serial Console Access</h2>";
-      String serialContent = HTML_ENDPOINT_START;
-      serialContent += "<strong>Baud Rate:</strong> 115200,8,N,1";
-      serialContent += HTML_ENDPOINT_END;
-      serialContent += HTML_ENDPOINT_START;
-      serialContent += "<strong>Commands:</strong> Type <code>help</code> to see all available CLI commands";
-      serialContent += HTML_ENDPOINT_END;
-      serialContent += HTML_ENDPOINT_START;
-      serialContent += "<strong>Configuration:</strong> Use <code>config</code> to view current settings including your token";
-      serialContent += HTML_ENDPOINT_END;
-      serialContent += HTML_ENDPOINT_START;
-      serialContent += "<strong>WiFi Setup:</strong> Use <code>setssid</code>, <code>setpwd</code>, and <code>connect</code> commands";
-      serialContent += HTML_ENDPOINT_END;
-      htmlResponse += generateApiSection("Serial Console", serialContent);
-      
-      htmlResponse += HTML_BODY_END;
-      
-      request->send(200, "text/html", htmlResponse);
+      request->send(200, "text/html", (const uint8_t*)INDEX_PAGE_TEMPLATE, strlen_P(INDEX_PAGE_TEMPLATE),
+                    [](const String& name) {
+                      return expandPagePlaceholder(name, String());
+                    });
     });
 
+    // Persistent key command channel, authenticated in the upgrade request
+    controlSocket.begin(server);
+    
+    // Server-Sent Events of state changes
+    stateStream.begin(server);
+    
     // 404 handler for not found endpoints
     server.onNotFound([](AsyncWebServerRequest *request){
       request->send(404, "text/plain", "404: Not Found");
@@ -841,7 +1757,8 @@ void setupWebServer() {
     // CORS headers for API access
     DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
     DefaultHeaders::Instance().addHeader("Access-Control-Allow-Methods", "GET, POST, PUT");
-    DefaultHeaders::Instance().addHeader("Access-Control-Allow-Headers", "Content-Type");
+    DefaultHeaders::Instance().addHeader("Access-Control-Allow-Headers", "Content-Type, If-None-Match");
+    DefaultHeaders::Instance().addHeader("Access-Control-Expose-Headers", "ETag");
     
     // Start the web server
     server.begin();
@@ -849,55 +1766,57 @@ void setupWebServer() {
     Serial.println("http://" + wifiManager.localIp().toString() + "/");
   }
   
-  // Generate diagnostic information as JSON
-  String getDeviceInfo() {
+  // Diagnostic information as JSON
+  void writeDeviceInfo(JsonWriter& json) {
     // Calculate uptime in seconds
     unsigned long uptime = (millis() - startTime) / 1000;
-    unsigned long uptimeDays = uptime / 86400;
-    unsigned long uptimeHours = (uptime % 86400) / 3600;
-    unsigned long uptimeMinutes = (uptime % 3600) / 60;
-    unsigned long uptimeSeconds = uptime % 60;
-    
-    String uptimeStr = String(uptimeDays) + "d " + String(uptimeHours) + "h " +
-                       String(uptimeMinutes) + "m " + String(uptimeSeconds) + "s";
-    
-    // Create JSON object for diagnostic information
-    StaticJsonDocument<1024> doc;
+    char uptimeStr[32];
+    snprintf(uptimeStr, sizeof(uptimeStr), "%lud %luh %lum %lus",
+             uptime / 86400, (uptime % 86400) / 3600, (uptime % 3600) / 60, uptime % 60);
     
     // System information
-    JsonObject system = doc.createNestedObject("system");
-    system["deviceName"] = BLE_DEVICE_NAME;
-    system["manufacturer"] = BLE_MANUFACTURER_NAME;
-    system["chipModel"] = ESP.getChipModel();
-    system["chipRevision"] = ESP.getChipRevision();
-    system["chipCores"] = ESP.getChipCores();
-    system["sdkVersion"] = ESP.getSdkVersion();
-    system["freeHeap"] = ESP.getFreeHeap();
-    system["uptime"] = uptimeStr;
-    system["uptimeSeconds"] = uptime;
-    system["bootCount"] = bootCount;
+    json.beginObject().beginObject("system")
+        .add("deviceName", BLE_DEVICE_NAME)
+        .add("manufacturer", BLE_MANUFACTURER_NAME)
+        .add("chipModel", ESP.getChipModel())
+        .add("chipRevision", ESP.getChipRevision())
+        .add("chipCores", ESP.getChipCores())
+        .add("sdkVersion", ESP.getSdkVersion())
+        .add("freeHeap", ESP.getFreeHeap())
+        .add("minFreeHeap", ESP.getMinFreeHeap())
+        .add("largestFreeBlock", ESP.getMaxAllocHeap())
+        .add("heapAlarm", heapMonitor.getSnapshot().alarm)
+        .add("uptime", uptimeStr)
+        .add("uptimeSeconds", uptime)
+        .add("bootCount", bootCount)
+        .endObject();
     
     // WiFi information
-    JsonObject wifi = doc.createNestedObject("wifi");
-    wifi["connected"] = (wifiManager.isConnected());;
-    wifi["ssid"] = wifiManager.ssid();
-    wifi["ipAddress"] = wifiManager.localIp().toString();
-    wifi["macAddress"] = wifiManager.macAddress();
-    wifi["rssi"] = wifiManager.RSSI();
-    wifi["channel"] = wifiManager.channel();
+    json.beginObject("wifi")
+        .add("connected", wifiManager.isConnected())
+        .add("ssid", wifiManager.ssid())
+        .add("ipAddress", wifiManager.localIp().toString())
+        .add("macAddress", wifiManager.macAddress())
+        .add("rssi", wifiManager.RSSI())
+        .add("channel", wifiManager.channel())
+        .endObject();
     
     // BLE information
-    JsonObject ble = doc.createNestedObject("ble");
-    ble["deviceName"] = BLE_DEVICE_NAME;
-    ble["manufacturer"] = BLE_MANUFACTURER_NAME;
-    ble["initialized"] = true; // If the code reaches here, BLE is initialized
-    ble["connected"] = deviceConnected;
-    ble["serviceUUID"] = SERVICE_UUID;
-    ble["library"] = "ESP32 BLE Arduino";
-    
-    // Serialize the JSON object
-    String jsonOutput;
-    serializeJson(doc, jsonOutput);
+    json.beginObject("ble")
+        .add("deviceName", BLE_DEVICE_NAME)
+        .add("manufacturer", BLE_MANUFACTURER_NAME)
+        .add("initialized", true) // If the code reaches here, BLE is initialized
+        .add("connected", bleRemoteControl.isConnected());
+    addConnections(json, "connections");
+    json.add("activeProfile", bleRemoteControl.getActiveProfile())
+        .add("profileSwitches", bleRemoteControl.getProfileSwitches())
+        .add("lastSwitchTimeUs", bleRemoteControl.getLastSwitchUs())
+        .add("serviceUUID", SERVICE_UUID)
+        .add("library", "ESP32 BLE Arduino");
     
-    return jsonOutput;
+    // Report TX queues (simulator-side drops vs. notify failures)
+    json.beginObject("txQueue");
+    addTxQueueStats(json, "keyboard", bleRemoteControl.getKeyTxStats());
+    addTxQueueStats(json, "media", bleRemoteControl.getMediaTxStats());
+    json.endObject().endObject().endObject();
   }
\ No newline at end of file
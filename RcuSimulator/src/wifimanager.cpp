@@ -1,5 +1,6 @@
 #include "globals.h"
 #include "WiFiManager.h"
+#include "configstore.h"
 
 WiFiManager::WiFiManager() {
     // Standardwerte für Netzwerkkonfiguration
@@ -9,8 +10,6 @@ WiFiManager::WiFiManager() {
 }
 
 WiFiManager::~WiFiManager() {
-    // Sicherstellen, dass Preferences geschlossen wird
-    preferences.end();
 }
 
 bool WiFiManager::setup() {
@@ -115,9 +114,14 @@ bool WiFiManager::loadConfig() {
 }
 
 void WiFiManager::resetConfig() {
-    preferences.begin(preferencesNamespace, false);
-    preferences.clear();
-    preferences.end();
+    const ConfigKey keys[] = {
+        CONFIG_WIFI_SSID, CONFIG_WIFI_PASSWORD, CONFIG_WIFI_STATIC_IP,
+        CONFIG_WIFI_GATEWAY, CONFIG_WIFI_SUBNET, CONFIG_WIFI_USE_STATIC
+    };
+    for (ConfigKey key : keys) {
+        configStore.reset(key);
+    }
+    configStore.commit();
     
     // Zurücksetzen der Werte
     _ssid = "";
@@ -160,20 +164,21 @@ void WiFiManager::printConfig() {
 }
 
 bool WiFiManager::saveConfigToPreferences() {
-    preferences.begin(preferencesNamespace, false);
-    
-    preferences.putString("ssid", _ssid);
-    preferences.putString("password", _password);
+    configStore.setString(CONFIG_WIFI_SSID, _ssid);
+    configStore.setString(CONFIG_WIFI_PASSWORD, _password);
     
     // IP-Adressen als Strings speichern
-    preferences.putString("static_ip", _staticIp.toString());
-    preferences.putString("gateway", _gateway.toString());
-    preferences.putString("subnet", _subnet.toString());
+    configStore.setString(CONFIG_WIFI_STATIC_IP, _staticIp.toString());
+    configStore.setString(CONFIG_WIFI_GATEWAY, _gateway.toString());
+    configStore.setString(CONFIG_WIFI_SUBNET, _subnet.toString());
     
     // Konfigurationsflags
-    preferences.putBool("use_static", _useStaticIp);
+    configStore.setBool(CONFIG_WIFI_USE_STATIC, _useStaticIp);
     
-    preferences.end();
+    // Schreibt nur geänderte Felder
+    if (!configStore.commit()) {
+        return false;
+    }
     _unsavedChanges = false; 
     return true;
 }
@@ -181,25 +186,22 @@ bool WiFiManager::saveConfigToPreferences() {
 bool WiFiManager::loadConfigFromPreferences() {
     bool configExists = false;
     
-    preferences.begin(preferencesNamespace, true); // Nur-Lesen-Modus
-    
-    if (preferences.isKey("ssid")) {
-        _ssid = preferences.getString("ssid", "");
-        _password = preferences.getString("password", "");
+    if (configStore.isStored(CONFIG_WIFI_SSID)) {
+        _ssid = configStore.getString(CONFIG_WIFI_SSID);
+        _password = configStore.getString(CONFIG_WIFI_PASSWORD);
         
         // IP-Adressen aus Strings laden
-        _staticIp.fromString(preferences.getString("static_ip", "0.0.0.0"));
-        _gateway.fromString(preferences.getString("gateway", "0.0.0.0"));
-        _subnet.fromString(preferences.getString("subnet", "255.255.255.0"));
+        _staticIp.fromString(configStore.getString(CONFIG_WIFI_STATIC_IP));
+        _gateway.fromString(configStore.getString(CONFIG_WIFI_GATEWAY));
+        _subnet.fromString(configStore.getString(CONFIG_WIFI_SUBNET));
         
         // Konfigurationsflags
-        _useStaticIp = preferences.getBool("use_static", false);
+        _useStaticIp = configStore.getBool(CONFIG_WIFI_USE_STATIC);
         
         configExists = true;
         _unsavedChanges = false;
     }
     
-    preferences.end();
     return configExists;
 }
 
@@ -8,9 +8,6 @@
 
 class WiFiManager {
 private:
-    // Preferences Namespace für Speicherung
-    const char* preferencesNamespace = "wificonfig";
-    
     // WLAN-Konfiguration
     String _ssid;
     String _password;
@@ -22,9 +19,6 @@ private:
     bool _useStaticIp = false;
     bool _isConnected = false;
     
-    // Preferences-Instance
-    Preferences preferences;
-    
     // Private Hilfsmethoden
     bool loadConfigFromPreferences();
     bool saveConfigToPreferences();
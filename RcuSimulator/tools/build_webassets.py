@@ -0,0 +1,109 @@
+"""Gzips the web console in web/ into src/webassets.cpp.
+
+Runs before every PlatformIO build (extra_scripts in platformio.ini) and can
+be run by hand: python tools/build_webassets.py
+
+web/index.html is served at /console, every other file at /console/<name>.
+{{name}} in an HTML file is replaced by the URL of that asset with its hash
+as version, so CSS and JS can be cached forever and the page still picks up
+a new build. The file is only rewritten when its content changes.
+"""
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO (SCons)
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+WEB_DIR = os.path.join(PROJECT_DIR, "web")
+OUTPUT = os.path.join(PROJECT_DIR, "src", "webassets.cpp")
+URL_ROOT = "/console"
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+}
+
+
+def url_for(name):
+    return URL_ROOT if name == "index.html" else URL_ROOT + "/" + name
+
+
+def compress(data):
+    # mtime=0 keeps the output, and so the ETag, identical between builds
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def load_assets():
+    names = sorted(n for n in os.listdir(WEB_DIR) if os.path.isfile(os.path.join(WEB_DIR, n)))
+    sources = {}
+    for name in names:
+        if os.path.splitext(name)[1] not in CONTENT_TYPES:
+            raise SystemExit("build_webassets: no content type for web/" + name)
+        with open(os.path.join(WEB_DIR, name), "rb") as f:
+            sources[name] = f.read()
+
+    # Static files first, pages reference them by hash
+    assets = []
+    versions = {}
+    for name in names:
+        if not name.endswith(".html"):
+            data = compress(sources[name])
+            versions[name] = hashlib.sha256(data).hexdigest()[:16]
+            assets.append((name, data, versions[name], True))
+    for name in names:
+        if name.endswith(".html"):
+            text = sources[name].decode("utf-8")
+            for ref, version in versions.items():
+                text = text.replace("{{" + ref + "}}", url_for(ref) + "?v=" + version)
+            if "{{" in text:
+                raise SystemExit("build_webassets: unknown asset reference in web/" + name)
+            data = compress(text.encode("utf-8"))
+            assets.append((name, data, hashlib.sha256(data).hexdigest()[:16], False))
+    # A route also matches the URLs below it, so /console must come last
+    assets.sort(key=lambda a: len(url_for(a[0])), reverse=True)
+    return assets
+
+
+def render(assets):
+    lines = [
+        "// Generated by tools/build_webassets.py from web/, do not edit",
+        '#include "webpages.h"',
+        "",
+    ]
+    for index, (name, data, _, _) in enumerate(assets):
+        lines.append("// web/%s, %d bytes gzipped" % (name, len(data)))
+        lines.append("static const uint8_t WEB_ASSET_%d[] PROGMEM = {" % index)
+        for offset in range(0, len(data), 16):
+            lines.append("  " + ", ".join("0x%02x" % b for b in data[offset:offset + 16]) + ",")
+        lines.append("};")
+        lines.append("")
+    lines.append("const WebAsset WEB_ASSETS[] = {")
+    for index, (name, data, etag, immutable) in enumerate(assets):
+        content_type = CONTENT_TYPES[os.path.splitext(name)[1]]
+        lines.append('  {"%s", "%s", WEB_ASSET_%d, sizeof(WEB_ASSET_%d), "\\"%s\\"", %s},'
+                     % (url_for(name), content_type, index, index, etag, "true" if immutable else "false"))
+    lines.append("};")
+    lines.append("const size_t NUM_WEB_ASSETS = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    content = render(load_assets())
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT, "r", encoding="utf-8") as f:
+            if f.read() == content:
+                return
+    with open(OUTPUT, "w", encoding="utf-8") as f:
+        f.write(content)
+    print("build_webassets: wrote " + os.path.relpath(OUTPUT, PROJECT_DIR))
+
+
+main()
@@ -0,0 +1,135 @@
+'use strict';
+// Live data comes from the JSON APIs and /api/events, the page itself is static.
+(function () {
+  var token = localStorage.getItem('rcuToken') || '';
+  var events = null;
+
+  function $(id) { return document.getElementById(id); }
+
+  function api(path, params) {
+    var query = new URLSearchParams(params || {});
+    query.set('token', token);
+    return fetch(path + '?' + query.toString());
+  }
+
+  function log(text) {
+    var item = document.createElement('li');
+    item.textContent = new Date().toLocaleTimeString() + ' ' + text;
+    var list = $('log');
+    list.insertBefore(item, list.firstChild);
+    while (list.children.length > 50) {
+      list.removeChild(list.lastChild);
+    }
+  }
+
+  function showConfig(config) {
+    document.querySelectorAll('[data-config]').forEach(function (el) {
+      var value = config[el.dataset.config];
+      if (value !== undefined) {
+        el.textContent = String(value);
+      }
+    });
+  }
+
+  function setConfig(name, value) {
+    var el = document.querySelector('[data-config="' + name + '"]');
+    if (el) {
+      el.textContent = String(value);
+    }
+  }
+
+  // The browser revalidates with If-None-Match, an unchanged config is a 304
+  function loadConfig() {
+    return api('/api/ble/config').then(function (r) {
+      if (r.status === 401) {
+        throw new Error('invalid token');
+      }
+      return r.json();
+    }).then(showConfig);
+  }
+
+  function loadDiagnostics() {
+    return api('/api/system/diagnostics').then(function (r) { return r.json(); }).then(function (d) {
+      $('rssi').textContent = d.wifi.rssi;
+      $('heap').textContent = d.system.freeHeap;
+      $('uptime').textContent = d.system.uptime;
+    });
+  }
+
+  function openStream() {
+    if (events) {
+      events.close();
+    }
+    events = new EventSource('/api/events?token=' + encodeURIComponent(token));
+    events.onopen = function () {
+      $('stream').textContent = 'live';
+      $('stream').className = 'state live';
+    };
+    events.onerror = function () {
+      $('stream').textContent = 'reconnecting';
+      $('stream').className = 'state';
+    };
+    events.addEventListener('hello', function (e) { showConfig(JSON.parse(e.data)); });
+    events.addEventListener('config', function () { loadConfig(); log('config changed'); });
+    events.addEventListener('battery', function (e) { setConfig('currentBatteryLevel', JSON.parse(e.data).level); });
+    events.addEventListener('advertising', function (e) {
+      var advertising = JSON.parse(e.data).advertising;
+      setConfig('advertising', advertising);
+      log(advertising ? 'advertising started' : 'advertising stopped');
+    });
+    events.addEventListener('rssi', function (e) { $('rssi').textContent = JSON.parse(e.data).rssi; });
+    ['connect', 'disconnect'].forEach(function (type) {
+      events.addEventListener(type, function (e) {
+        var data = JSON.parse(e.data);
+        setConfig('connected', data.connected);
+        log('host ' + data.connId + ' ' + type + 'ed');
+      });
+    });
+  }
+
+  function connect() {
+    loadConfig().then(function () {
+      localStorage.setItem('rcuToken', token);
+      openStream();
+      return loadDiagnostics();
+    }).catch(function (err) {
+      $('stream').textContent = err.message;
+      $('stream').className = 'state';
+    });
+  }
+
+  function send(path, params) {
+    api(path, params).then(function (r) {
+      return r.text().then(function (body) {
+        $('result').textContent = r.status + ' ' + body;
+      });
+    }).catch(function (err) {
+      $('result').textContent = err.message;
+    });
+  }
+
+  $('login').addEventListener('submit', function (e) {
+    e.preventDefault();
+    token = $('token').value.trim();
+    connect();
+  });
+  $('refresh').addEventListener('click', function () {
+    loadConfig();
+    loadDiagnostics();
+  });
+  document.querySelectorAll('[data-key]').forEach(function (button) {
+    button.addEventListener('click', function () {
+      send('/api/key', { key: button.dataset.key, delay: 'auto' });
+    });
+  });
+  document.querySelectorAll('[data-api]').forEach(function (button) {
+    button.addEventListener('click', function () {
+      send(button.dataset.api);
+    });
+  });
+
+  $('token').value = token;
+  if (token) {
+    connect();
+  }
+})();